@@ -0,0 +1,67 @@
+#version 450
+
+// input locations
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+// set by the render systems, normals arrive octahedral encoded in xy with PackedVertex
+layout(constant_id = 4) const bool PACKED_VERTICES = false;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+layout(location = 4) flat out uint fragTextureIndex;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 invView;
+    vec4 ambientLightColor; // w is intensity
+    vec2 screenExtent;
+    float zNear;
+    float zFar;
+} ubo;
+
+// ObjectData in vge_render_system.hpp
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint textureIndex;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffers[];
+
+layout(push_constant) uniform Push {
+    uint objectBufferIndex;
+} push;
+
+// the depth pre-pass in bindless_depth_prepass.vert must produce the exact same depth
+invariant gl_Position;
+
+// inverse of encodeOctahedral in vge_model.cpp
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return n;
+}
+
+void main() {
+    // firstInstance of each draw selects its object
+    ObjectData object = objectBuffers[push.objectBufferIndex].objects[gl_InstanceIndex];
+
+    vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+
+    vec3 normalModel = PACKED_VERTICES ? decodeOctahedral(normal.xy) : normal;
+    fragNormalWorld = normalize(mat3(object.normalMatrix) * normalModel);
+    fragPosWorld = positionWorld.xyz;
+    fragColor = color;
+    fragUv = uv;
+    fragTextureIndex = object.textureIndex;
+}
@@ -0,0 +1,39 @@
+#version 450
+
+// input locations, position only
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 invView;
+    vec4 ambientLightColor; // w is intensity
+    vec2 screenExtent;
+    float zNear;
+    float zFar;
+} ubo;
+
+// ObjectData in vge_render_system.hpp
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint textureIndex;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffers[];
+
+layout(push_constant) uniform Push {
+    uint objectBufferIndex;
+} push;
+
+// must match bindless.vert bit for bit, the shaded pass tests depth with EQUAL
+invariant gl_Position;
+
+void main() {
+    ObjectData object = objectBuffers[push.objectBufferIndex].objects[gl_InstanceIndex];
+
+    vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+}
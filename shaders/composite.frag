@@ -0,0 +1,19 @@
+#version 450
+
+// output locations
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 2) uniform sampler2D gDepth;
+layout(set = 1, binding = 3, rgba16f) uniform readonly image2D litImage;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth >= 1.0) {
+        discard; // nothing was drawn here, keep the clear color
+    }
+
+    outColor = imageLoad(litImage, pixel);
+    // forward passes drawn afterwards are depth tested against the deferred geometry
+    gl_FragDepth = depth;
+}
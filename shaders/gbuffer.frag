@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormalWorld;
+// output locations, VgeGBuffer attachment order
+layout(location = 0) out vec4 outNormal;
+layout(location = 1) out vec4 outAlbedo;
+
+void main() {
+    // world space position is rebuilt from depth by deferred_lighting.comp
+    outNormal = vec4(normalize(fragNormalWorld), 0.0);
+    outAlbedo = vec4(fragColor, 1.0);
+}
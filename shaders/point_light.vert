@@ -10,9 +10,10 @@ const vec2 OFFSETS[6] = vec2[](
     );
 
 layout(location = 0) out vec2 fragOffset;
+layout(location = 1) flat out vec3 fragColor;
 
 struct PointLight {
-    vec4 position; // ignore w
+    vec4 position; // w is billboard radius
     vec4 color; // w is intensity
 };
 
@@ -21,19 +22,24 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 view;
     mat4 invView;
     vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[10];
-    int numLights;
+    vec2 screenExtent;
+    float zNear;
+    float zFar;
 } ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-} push;
+layout(std430, set = 0, binding = 1) readonly buffer PointLightBuffer {
+    int numLights;
+    PointLight pointLights[];
+} lights;
 
 void main()
 {
+    // one instance per light, one billboard quad per instance
+    PointLight light = lights.pointLights[gl_InstanceIndex];
+    float radius = light.position.w;
+
     fragOffset = OFFSETS[gl_VertexIndex];
+    fragColor = light.color.xyz;
     vec3 cameraRightWorld = {
             ubo.view[0][0],
             ubo.view[1][0],
@@ -45,9 +51,9 @@ void main()
             ubo.view[2][1]
         };
 
-    vec3 positionWorld = push.position.xyz
-            + push.radius * fragOffset.x * cameraRightWorld
-            + push.radius * fragOffset.y * cameraUpWorld;
+    vec3 positionWorld = light.position.xyz
+            + radius * fragOffset.x * cameraRightWorld
+            + radius * fragOffset.y * cameraUpWorld;
 
     gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
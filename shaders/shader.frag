@@ -6,8 +6,22 @@ layout(location = 2) in vec3 fragNormalWorld;
 // output locations
 layout(location = 0) out vec4 outColor;
 
+// specialization constants, set per pipeline variant by VgeRenderSystem
+layout(constant_id = 0) const bool ENABLE_SPECULAR = true;
+layout(constant_id = 1) const float SPECULAR_EXPONENT = 512.0; // higher values -> sharper highlights
+layout(constant_id = 2) const int LIGHT_COUNT = -1; // < 0 reads lights.numLights
+layout(constant_id = 3) const bool CLUSTERED_SHADING = true; // only shade the fragment's cluster lights
+// VgeLightClusterSystem::MAX_LIGHTS_PER_CLUSTER, also specialized into light_cluster.comp
+layout(constant_id = 5) const uint MAX_LIGHTS_PER_CLUSTER = 128u;
+
+// froxel grid, VgeLightClusterSystem::CLUSTER_X/Y/Z
+const uint CLUSTER_X = 16u;
+const uint CLUSTER_Y = 9u;
+const uint CLUSTER_Z = 24u;
+const float LIGHT_CUTOFF = 0.01; // matches light_cluster.comp
+
 struct PointLight {
-    vec4 position; // ignore w
+    vec4 position; // w is billboard radius
     vec4 color; // w is intensity
 };
 
@@ -16,15 +30,56 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 view;
     mat4 invView;
     vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[10];
-    int numLights;
+    vec2 screenExtent;
+    float zNear;
+    float zFar;
 } ubo;
 
+layout(std430, set = 0, binding = 1) readonly buffer PointLightBuffer {
+    int numLights;
+    PointLight pointLights[];
+} lights;
+
+layout(std430, set = 0, binding = 2) readonly buffer LightClusterBuffer {
+    uint droppedLights;
+    uint lightCounts[CLUSTER_X * CLUSTER_Y * CLUSTER_Z];
+    uint lightIndices[]; // MAX_LIGHTS_PER_CLUSTER per cluster
+} clusters;
+
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
     mat4 normalMatrix;
 } push;
 
+// Accumulates one light's diffuse and Blinn-Phong specular terms. Clustered
+// shading fades lights out towards their cutoff range, where culling drops them
+void addPointLight(PointLight light, vec3 surfaceNormal, vec3 viewDirection, bool windowed,
+        inout vec3 diffuseLight, inout vec3 specularLight) {
+    vec3 directionToLight = light.position.xyz - fragPosWorld;
+    float distanceSquared = dot(directionToLight, directionToLight); // dot(vecN, vecN) = distance squared
+    float attenuation = 1.0 / distanceSquared;
+    if (windowed) {
+        float rangeSquared = light.color.w / LIGHT_CUTOFF;
+        float falloff = clamp(1.0 - distanceSquared * distanceSquared / (rangeSquared * rangeSquared), 0.0, 1.0);
+        attenuation *= falloff * falloff;
+    }
+    directionToLight = normalize(directionToLight);
+
+    float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
+    vec3 intensity = light.color.xyz * light.color.w * attenuation;
+
+    diffuseLight += intensity * cosAngIncidence;
+
+    // specular lighting
+    if (ENABLE_SPECULAR) {
+        vec3 halfAngle = normalize(directionToLight + viewDirection);
+        float blinnTerm = dot(surfaceNormal, halfAngle);
+        blinnTerm = clamp(blinnTerm, 0, 1);
+        blinnTerm = pow(blinnTerm, SPECULAR_EXPONENT);
+        specularLight += intensity * blinnTerm;
+    }
+}
+
 void main() {
     vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
     vec3 specularLight = vec3(0.0);
@@ -33,23 +88,26 @@ void main() {
     vec3 cameraPosWorld = ubo.invView[3].xyz;
     vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-    for (int i = 0; i < ubo.numLights; i++) {
-        PointLight light = ubo.pointLights[i];
-        vec3 directionToLight = light.position.xyz - fragPosWorld;
-        float attenuation = 1.0 / dot(directionToLight, directionToLight); // dot(vecN, vecN) = distance squared
-        directionToLight = normalize(directionToLight);
-
-        float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
-        vec3 intensity = light.color.xyz * light.color.w * attenuation;
+    if (CLUSTERED_SHADING) {
+        // same exponential slicing as light_cluster.comp
+        float depthView = (ubo.view * vec4(fragPosWorld, 1.0)).z;
+        float slice = log(depthView / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z);
+        uvec3 cluster = uvec3(
+            min(uvec2(gl_FragCoord.xy / ubo.screenExtent * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1)),
+            uint(clamp(slice, 0.0, float(CLUSTER_Z - 1))));
+        uint clusterIndex = cluster.x + cluster.y * CLUSTER_X + cluster.z * CLUSTER_X * CLUSTER_Y;
 
-        diffuseLight += intensity * cosAngIncidence;
-
-        // specular lighting
-        vec3 halfAngle = normalize(directionToLight + viewDirection);
-        float blinnTerm = dot(surfaceNormal, halfAngle);
-        blinnTerm = clamp(blinnTerm, 0, 1);
-        blinnTerm = pow(blinnTerm, 512.0); // higher values -> sharper highlights
-        specularLight += intensity * blinnTerm;
+        uint clusterLightCount = clusters.lightCounts[clusterIndex];
+        for (uint i = 0; i < clusterLightCount; i++) {
+            PointLight light = lights.pointLights[clusters.lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]];
+            addPointLight(light, surfaceNormal, viewDirection, true, diffuseLight, specularLight);
+        }
+    }
+    else {
+        int lightCount = LIGHT_COUNT < 0 ? lights.numLights : LIGHT_COUNT;
+        for (int i = 0; i < lightCount; i++) {
+            addPointLight(lights.pointLights[i], surfaceNormal, viewDirection, false, diffuseLight, specularLight);
+        }
     }
 
     outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
@@ -0,0 +1,570 @@
+#include "vge_deferred_render_system.hpp"
+#include "../vge_game_object.hpp"
+#include "../vge_swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+
+namespace vge {
+
+/* Constructs a VgeDeferredRenderSystem object.
+ *
+ * Creates the geometry render pass, the G-buffer sampler and descriptor set
+ * layout, and the geometry, tiled lighting and composite pipelines. The
+ * G-buffers themselves are created on first use, sized to the frame.
+ */
+VgeDeferredRenderSystem::VgeDeferredRenderSystem(
+    VgeDevice& device,
+    VkRenderPass swapChainRenderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    VgeDescriptorLayoutCache& layoutCache)
+    : m_vgeDevice{ device }
+    , m_depthFormat{}
+    , m_renderPass{}
+    , m_sampler{}
+    , m_gbufferSetLayout{
+        VgeDescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(
+                2,
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(
+                3,
+                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build(layoutCache)
+    }
+    , m_pipelineLayout{}
+    , m_geometryPipelines{}
+    , m_lightingPipelines{}
+    , m_lightingPipeline{ nullptr }
+    , m_compositePipeline{}
+    , m_gbuffers(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_gbufferDescriptorSets(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+{
+    createRenderPass();
+    createSampler();
+    createPipelineLayout(globalSetLayout);
+    createPipelines(swapChainRenderPass);
+}
+
+/* Destroys the VgeDeferredRenderSystem object.
+ *
+ * Releases the G-buffers before the render pass they were created against,
+ * then the sampler and pipeline layout.
+ */
+VgeDeferredRenderSystem::~VgeDeferredRenderSystem()
+{
+    m_gbuffers.clear();
+    vkDestroyPipelineLayout(m_vgeDevice.getDevice(), m_pipelineLayout, nullptr);
+    vkDestroySampler(m_vgeDevice.getDevice(), m_sampler, nullptr);
+    vkDestroyRenderPass(m_vgeDevice.getDevice(), m_renderPass, nullptr);
+}
+
+/* Creates the render pass of the geometry pass.
+ *
+ * Normals, albedo and depth are cleared, written and stored, then left in
+ * read only layouts for the lighting and composite passes. The outgoing
+ * dependency makes the attachment writes visible to compute and fragment
+ * shader reads.
+ */
+void VgeDeferredRenderSystem::createRenderPass()
+{
+    // the depth attachment is sampled afterwards, so its format must support both uses
+    m_depthFormat = m_vgeDevice.findSupportedFormat(
+        { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentDescription normalAttachment = colorAttachment;
+    normalAttachment.format = VgeGBuffer::NORMAL_FORMAT;
+    VkAttachmentDescription albedoAttachment = colorAttachment;
+    albedoAttachment.format = VgeGBuffer::ALBEDO_FORMAT;
+
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = m_depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    std::array<VkAttachmentReference, 2> colorAttachmentRefs{};
+    colorAttachmentRefs[0].attachment = 0;
+    colorAttachmentRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachmentRefs[1].attachment = 1;
+    colorAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 2;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
+    subpass.pColorAttachments = colorAttachmentRefs.data();
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    std::array<VkSubpassDependency, 2> dependencies{};
+    // the previous lighting and composite reads of this G-buffer must finish first
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask =
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask =
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    std::array<VkAttachmentDescription, 3> attachments = { normalAttachment,
+                                                           albedoAttachment,
+                                                           depthAttachment };
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(m_vgeDevice.getDevice(), &renderPassInfo, nullptr, &m_renderPass) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create G-buffer render pass!");
+    }
+}
+
+/* Creates the sampler the G-buffer attachments are bound with.
+ *
+ * The lighting and composite shaders only texelFetch, so a nearest,
+ * clamped sampler without mips is enough.
+ */
+void VgeDeferredRenderSystem::createSampler()
+{
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.f;
+
+    if (vkCreateSampler(m_vgeDevice.getDevice(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create G-buffer sampler!");
+    }
+}
+
+/* Creates the pipeline layout shared by all three deferred passes.
+ *
+ * Set 0 is the global set and set 1 the frame's G-buffer set. The geometry
+ * pass pushes the same per-object matrices as the forward render system.
+ */
+void VgeDeferredRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(SimplePushConstantData);
+
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalSetLayout,
+        m_gbufferSetLayout.getDescriptorSetLayout(),
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(
+            m_vgeDevice.getDevice(),
+            &pipelineLayoutInfo,
+            nullptr,
+            &m_pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+}
+
+/* Creates the geometry, lighting and composite pipelines.
+ *
+ * The geometry pipelines write two color attachments, there is one per
+ * vertex format. The lighting pipeline starts out specialized for the
+ * default ShaderFeatures, see setShaderFeatures. The composite pipeline
+ * draws a vertex-less fullscreen triangle into the swap chain pass
+ * and always writes depth, so forward passes drawn after it are still
+ * occluded by the deferred geometry.
+ */
+void VgeDeferredRenderSystem::createPipelines(VkRenderPass swapChainRenderPass)
+{
+    assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+    for (uint32_t format = 0; format < VgeModel::VERTEX_FORMAT_COUNT; format++) {
+        VgeModel::VertexFormat vertexFormat = static_cast<VgeModel::VertexFormat>(format);
+        PipelineConfigInfo geometryConfig{};
+        VgePipeline::defaultPipelineConfigInfo(geometryConfig);
+        geometryConfig.bindingDescriptions = VgeModel::getBindingDescriptions(vertexFormat);
+        geometryConfig.attributeDescriptions = VgeModel::getAttributeDescriptions(vertexFormat);
+        std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachments{
+            geometryConfig.colorBlendAttachment,
+            geometryConfig.colorBlendAttachment,
+        };
+        geometryConfig.colorBlendInfo.attachmentCount =
+            static_cast<uint32_t>(blendAttachments.size());
+        geometryConfig.colorBlendInfo.pAttachments = blendAttachments.data();
+        geometryConfig.renderPass = m_renderPass;
+        geometryConfig.pipelineLayout = m_pipelineLayout;
+        VgePipeline::addSpecializationConstant(
+            geometryConfig,
+            VgeRenderSystem::PACKED_VERTICES_CONSTANT_ID,
+            static_cast<uint32_t>(vertexFormat == VgeModel::VertexFormat::PACKED ? VK_TRUE
+                                                                                 : VK_FALSE));
+        m_geometryPipelines[format] = std::make_unique<VgePipeline>(
+            m_vgeDevice,
+            "./shaders/gbuffer.vert.spv",
+            "./shaders/gbuffer.frag.spv",
+            geometryConfig);
+    }
+
+    m_lightingPipeline = &getLightingPipeline(ShaderFeatures{});
+
+    PipelineConfigInfo compositeConfig{};
+    VgePipeline::defaultPipelineConfigInfo(compositeConfig);
+    compositeConfig.bindingDescriptions.clear();
+    compositeConfig.attributeDescriptions.clear();
+    compositeConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+    compositeConfig.renderPass = swapChainRenderPass;
+    compositeConfig.pipelineLayout = m_pipelineLayout;
+    m_compositePipeline = std::make_unique<VgePipeline>(
+        m_vgeDevice,
+        "./shaders/composite.vert.spv",
+        "./shaders/composite.frag.spv",
+        compositeConfig);
+}
+
+/* Retrieves the frame's G-buffer, sized to the given extent.
+ *
+ * A G-buffer is only used by its own frame index, whose fence has been
+ * waited on, so it can be replaced right away when the extent changed.
+ */
+VgeGBuffer& VgeDeferredRenderSystem::getGBuffer(int frameIndex, VkExtent2D extent)
+{
+    std::unique_ptr<VgeGBuffer>& gbuffer = m_gbuffers[frameIndex];
+    if (gbuffer == nullptr || gbuffer->getExtent().width != extent.width ||
+        gbuffer->getExtent().height != extent.height)
+    {
+        gbuffer.reset();
+        gbuffer = std::make_unique<VgeGBuffer>(m_vgeDevice, m_renderPass, m_depthFormat, extent);
+    }
+    return *gbuffer;
+}
+
+/* Renders game objects into the frame's G-buffer.
+ *
+ * Must be recorded outside the swap chain render pass. Also writes the
+ * frame's G-buffer descriptor set, allocated from the frame's transient
+ * allocator, for the lighting and composite passes.
+ */
+void VgeDeferredRenderSystem::renderGeometry(FrameInfo& frameInfo, VkExtent2D extent)
+{
+    VgeGBuffer& gbuffer = getGBuffer(frameInfo.frameIndex, extent);
+
+    VkDescriptorImageInfo normalInfo{
+        m_sampler,
+        gbuffer.getNormalView(),
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkDescriptorImageInfo albedoInfo{
+        m_sampler,
+        gbuffer.getAlbedoView(),
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkDescriptorImageInfo depthInfo{
+        m_sampler,
+        gbuffer.getDepthView(),
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+    };
+    VkDescriptorImageInfo lightingInfo{
+        VK_NULL_HANDLE,
+        gbuffer.getLightingView(),
+        VK_IMAGE_LAYOUT_GENERAL,
+    };
+    if (!VgeDescriptorWriter(m_gbufferSetLayout, frameInfo.frameDescriptorAllocator)
+             .writeImage(0, &normalInfo)
+             .writeImage(1, &albedoInfo)
+             .writeImage(2, &depthInfo)
+             .writeImage(3, &lightingInfo)
+             .build(m_gbufferDescriptorSets[frameInfo.frameIndex]))
+    {
+        throw std::runtime_error("Failed to allocate G-buffer descriptor set!");
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_renderPass;
+    renderPassInfo.framebuffer = gbuffer.getFramebuffer();
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = extent;
+
+    std::array<VkClearValue, 3> clearValues{};
+    clearValues[0].color = { 0.f, 0.f, 0.f, 0.f }; // normal
+    clearValues[1].color = { 0.f, 0.f, 0.f, 0.f }; // albedo
+    clearValues[2].depthStencil = { 1.0f, 0 };
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{
+        { 0, 0 },
+        extent
+    };
+    vkCmdSetViewport(frameInfo.commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_pipelineLayout,
+        0,
+        1,
+        &frameInfo.globalDescriptorSet,
+        0,
+        nullptr);
+
+    const glm::mat4& view = frameInfo.camera.getViewMatrix();
+    float projectionScale = frameInfo.camera.getProjectionMatrix()[1][1];
+    VgePipeline* boundPipeline = nullptr;
+    for (std::pair<const unsigned int, VgeGameObject>& kv : frameInfo.gameObjects) {
+        VgeGameObject& obj = kv.second;
+        if (obj.m_model == nullptr)
+            continue;
+        VgePipeline* pipeline =
+            m_geometryPipelines[static_cast<uint32_t>(obj.m_model->getVertexFormat())].get();
+        if (pipeline != boundPipeline) {
+            pipeline->bind(frameInfo.commandBuffer);
+            boundPipeline = pipeline;
+        }
+        float depthView = (view * glm::vec4(obj.m_transform.translation, 1.f)).z;
+        uint32_t lod = obj.m_model->selectLod(depthView, obj.m_transform.scale, projectionScale);
+        SimplePushConstantData pushData{};
+        pushData.modelMatrix = obj.m_transform.mat4() * obj.m_model->getDequantizationMatrix();
+        pushData.normalMatrix = obj.m_transform.normalMatrix();
+
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            0,
+            sizeof(SimplePushConstantData),
+            &pushData);
+        obj.m_model->bind(frameInfo.commandBuffer);
+        obj.m_model->draw(frameInfo.commandBuffer, 0, lod);
+    }
+
+    vkCmdEndRenderPass(frameInfo.commandBuffer);
+}
+
+/* Retrieves the lighting pipeline specialized for the given shader features.
+ *
+ * Only the specular features apply to deferred_lighting.comp, under the
+ * constant_ids VgeRenderSystem gives them in shader.frag, so both paths
+ * shade alike. Variants are created on first use and kept, switching
+ * never destroys a pipeline a frame in flight may still use.
+ */
+VgeComputePipeline& VgeDeferredRenderSystem::getLightingPipeline(const ShaderFeatures& features)
+{
+    assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+    struct SpecializationData
+    {
+        VkBool32 specular;
+        float specularExponent;
+    };
+    SpecializationData data{ features.specular ? VK_TRUE : VK_FALSE, features.specularExponent };
+    uint64_t key = static_cast<uint64_t>(data.specular) << 32 |
+                   std::bit_cast<uint32_t>(data.specularExponent);
+
+    std::unique_ptr<VgeComputePipeline>& pipeline = m_lightingPipelines[key];
+    if (pipeline == nullptr) {
+        std::array<VkSpecializationMapEntry, 2> entries{};
+        entries[0].constantID = VgeRenderSystem::SPECULAR_CONSTANT_ID;
+        entries[0].offset = offsetof(SpecializationData, specular);
+        entries[0].size = sizeof(VkBool32);
+        entries[1].constantID = VgeRenderSystem::SPECULAR_EXPONENT_CONSTANT_ID;
+        entries[1].offset = offsetof(SpecializationData, specularExponent);
+        entries[1].size = sizeof(float);
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+        specializationInfo.pMapEntries = entries.data();
+        specializationInfo.dataSize = sizeof(SpecializationData);
+        specializationInfo.pData = &data;
+
+        pipeline = std::make_unique<VgeComputePipeline>(
+            m_vgeDevice,
+            "shaders/deferred_lighting.comp.spv",
+            m_pipelineLayout,
+            &specializationInfo);
+    }
+    return *pipeline;
+}
+
+/* Selects the shader features the lighting pass shades with.
+ *
+ * Pass the features given to VgeRenderSystem, so switching between the
+ * forward and deferred path keeps the shading.
+ */
+void VgeDeferredRenderSystem::setShaderFeatures(const ShaderFeatures& features)
+{
+    m_lightingPipeline = &getLightingPipeline(features);
+}
+
+/* Shades the G-buffer with the frame's point lights.
+ *
+ * Dispatches one workgroup per TILE_SIZE x TILE_SIZE screen tile. Each
+ * workgroup bounds its tile's depth range, culls the lights against the
+ * tile once in shared memory, then shades its pixels with only those
+ * lights. Must be recorded after renderGeometry and outside any render pass.
+ */
+void VgeDeferredRenderSystem::computeLighting(FrameInfo& frameInfo)
+{
+    VgeGBuffer& gbuffer = *m_gbuffers[frameInfo.frameIndex];
+    VkExtent2D extent = gbuffer.getExtent();
+
+    // the previous contents are overwritten, so the old layout can be discarded
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = gbuffer.getLightingImage();
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &barrier);
+
+    m_lightingPipeline->bind(frameInfo.commandBuffer);
+
+    std::array<VkDescriptorSet, 2> descriptorSets{
+        frameInfo.globalDescriptorSet,
+        m_gbufferDescriptorSets[frameInfo.frameIndex],
+    };
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_pipelineLayout,
+        0,
+        static_cast<uint32_t>(descriptorSets.size()),
+        descriptorSets.data(),
+        0,
+        nullptr);
+
+    vkCmdDispatch(
+        frameInfo.commandBuffer,
+        (extent.width + TILE_SIZE - 1) / TILE_SIZE,
+        (extent.height + TILE_SIZE - 1) / TILE_SIZE,
+        1);
+
+    // the composite pass reads the lit image from its fragment shader
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &barrier);
+}
+
+/* Copies the lit G-buffer into the swap chain image.
+ *
+ * Must be recorded inside the swap chain render pass, before any forward
+ * pass that should be depth tested against the deferred geometry. Pixels
+ * without geometry are discarded and keep the clear color.
+ */
+void VgeDeferredRenderSystem::composite(FrameInfo& frameInfo)
+{
+    m_compositePipeline->bind(frameInfo.commandBuffer);
+
+    std::array<VkDescriptorSet, 2> descriptorSets{
+        frameInfo.globalDescriptorSet,
+        m_gbufferDescriptorSets[frameInfo.frameIndex],
+    };
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_pipelineLayout,
+        0,
+        static_cast<uint32_t>(descriptorSets.size()),
+        descriptorSets.data(),
+        0,
+        nullptr);
+
+    vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
+
+} // namespace vge
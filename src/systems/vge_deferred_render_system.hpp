@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../vge_compute_pipeline.hpp"
+#include "../vge_descriptors.hpp"
+#include "../vge_device.hpp"
+#include "../vge_frame_info.hpp"
+#include "../vge_gbuffer.hpp"
+#include "../vge_model.hpp"
+#include "../vge_pipeline.hpp"
+#include "vge_render_system.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vge {
+
+// Deferred alternative to VgeRenderSystem: geometry into a G-buffer, tiled compute lighting,
+// then a fullscreen composite into the swap chain pass
+class VgeDeferredRenderSystem {
+public:
+    // screen tile shaded by one lighting workgroup, must match deferred_lighting.comp
+    static constexpr uint32_t TILE_SIZE = 16;
+
+    VgeDeferredRenderSystem(
+        VgeDevice& device,
+        VkRenderPass swapChainRenderPass,
+        VkDescriptorSetLayout globalSetLayout,
+        VgeDescriptorLayoutCache& layoutCache);
+    ~VgeDeferredRenderSystem();
+
+    VgeDeferredRenderSystem(const VgeDeferredRenderSystem&) = delete;
+    VgeDeferredRenderSystem& operator=(const VgeDeferredRenderSystem&) = delete;
+
+    void renderGeometry(FrameInfo& frameInfo, VkExtent2D extent);
+    void computeLighting(FrameInfo& frameInfo);
+    void composite(FrameInfo& frameInfo);
+    void setShaderFeatures(const ShaderFeatures& features);
+
+private:
+    void createRenderPass();
+    void createSampler();
+    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+    void createPipelines(VkRenderPass swapChainRenderPass);
+    VgeGBuffer& getGBuffer(int frameIndex, VkExtent2D extent);
+    VgeComputePipeline& getLightingPipeline(const ShaderFeatures& features);
+
+    VgeDevice& m_vgeDevice;
+    VkFormat m_depthFormat;
+    VkRenderPass m_renderPass; // geometry pass into the G-buffer
+    VkSampler m_sampler;
+    VgeDescriptorSetLayout& m_gbufferSetLayout;
+    VkPipelineLayout m_pipelineLayout;
+    // one per vertex format
+    std::array<std::unique_ptr<VgePipeline>, VgeModel::VERTEX_FORMAT_COUNT> m_geometryPipelines;
+    // lighting variants keyed by their specular features, created on first use
+    std::unordered_map<uint64_t, std::unique_ptr<VgeComputePipeline>> m_lightingPipelines;
+    VgeComputePipeline* m_lightingPipeline; // variant of the current shader features
+    std::unique_ptr<VgePipeline> m_compositePipeline;
+    std::vector<std::unique_ptr<VgeGBuffer>> m_gbuffers;  // one per frame in flight
+    std::vector<VkDescriptorSet> m_gbufferDescriptorSets; // rebuilt every frame
+};
+
+} // namespace vge
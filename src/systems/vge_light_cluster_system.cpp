@@ -0,0 +1,257 @@
+#include "vge_light_cluster_system.hpp"
+#include "../vge_swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace vge {
+
+/* Records a barrier on the first size bytes of a buffer.
+ *
+ * Waits for srcAccess in srcStage before dstAccess in dstStage.
+ */
+static void recordBufferBarrier(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize size,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage,
+    VkPipelineStageFlags dstStage)
+{
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = size;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        srcStage,
+        dstStage,
+        0,
+        0,
+        nullptr,
+        1,
+        &barrier,
+        0,
+        nullptr);
+}
+
+/* Constructs a VgeLightClusterSystem object.
+ *
+ * Creates the light culling compute pipeline and one cluster buffer per
+ * frame in flight. Each buffer holds the count of lights dropped from full
+ * clusters, the light count of every cluster and then
+ * MAX_LIGHTS_PER_CLUSTER light indices per cluster. A host visible buffer
+ * per frame receives the dropped light count.
+ */
+VgeLightClusterSystem::VgeLightClusterSystem(
+    VgeDevice& device,
+    VkDescriptorSetLayout globalSetLayout)
+    : m_vgeDevice{ device }
+    , m_vgeComputePipeline{}
+    , m_pipelineLayout{}
+    , m_clusterBuffers(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_droppedLightReadbacks(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_hasDroppedLightReadback(VgeSwapChain::MAX_FRAMES_IN_FLIGHT, false)
+    , m_droppedLightCount{ 0 }
+    , m_reportedDroppedLights{ false }
+{
+    createPipelineLayout(globalSetLayout);
+    createPipeline();
+
+    for (std::unique_ptr<VgeBuffer>& clusterBuffer : m_clusterBuffers) {
+        clusterBuffer = std::make_unique<VgeBuffer>(
+            m_vgeDevice,
+            sizeof(uint32_t),
+            1 + CLUSTER_COUNT * (1 + MAX_LIGHTS_PER_CLUSTER),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    for (std::unique_ptr<VgeBuffer>& readback : m_droppedLightReadbacks) {
+        readback = std::make_unique<VgeBuffer>(
+            m_vgeDevice,
+            sizeof(uint32_t),
+            1,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        readback->map();
+    }
+}
+
+/* Destroys the VgeLightClusterSystem object.
+ *
+ * Cleans up the Vulkan pipeline layout used by the light culling pass.
+ */
+VgeLightClusterSystem::~VgeLightClusterSystem()
+{
+    vkDestroyPipelineLayout(m_vgeDevice.getDevice(), m_pipelineLayout, nullptr);
+}
+
+/* Creates the pipeline layout for the light culling pass.
+ *
+ * The compute shader reads the camera and lights from the global set and
+ * writes the cluster buffer bound to it, so no push constants are needed.
+ */
+void VgeLightClusterSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(
+            m_vgeDevice.getDevice(),
+            &pipelineLayoutInfo,
+            nullptr,
+            &m_pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+}
+
+/* Creates the light culling compute pipeline.
+ *
+ * Loads the light_cluster compute shader against the pipeline layout, with
+ * MAX_LIGHTS_PER_CLUSTER specialized in.
+ */
+void VgeLightClusterSystem::createPipeline()
+{
+    assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+    uint32_t maxLightsPerCluster = MAX_LIGHTS_PER_CLUSTER;
+    VkSpecializationMapEntry entry{};
+    entry.constantID = MAX_LIGHTS_PER_CLUSTER_CONSTANT_ID;
+    entry.offset = 0;
+    entry.size = sizeof(uint32_t);
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &entry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &maxLightsPerCluster;
+
+    m_vgeComputePipeline = std::make_unique<VgeComputePipeline>(
+        m_vgeDevice,
+        "shaders/light_cluster.comp.spv",
+        m_pipelineLayout,
+        &specializationInfo);
+}
+
+/* Bins the frame's point lights into the froxel grid.
+ *
+ * Records one workgroup per depth slice, each invocation testing every light
+ * sphere against its cluster's view space bounds. Must be recorded outside
+ * the render pass, after the light and uniform buffers of the frame have been
+ * written. A barrier makes the cluster lists visible to fragment shaders.
+ * The count of lights dropped from full clusters is copied to the host and
+ * picked up the next time the frame index is culled, once its fence was
+ * waited on.
+ */
+void VgeLightClusterSystem::cullLights(FrameInfo& frameInfo)
+{
+    readDroppedLightCount(frameInfo.frameIndex);
+
+    VkBuffer clusterBuffer = m_clusterBuffers[frameInfo.frameIndex]->getBuffer();
+    // the shader adds to the dropped light count atomically, so it starts from zero
+    vkCmdFillBuffer(frameInfo.commandBuffer, clusterBuffer, 0, sizeof(uint32_t), 0);
+    recordBufferBarrier(
+        frameInfo.commandBuffer,
+        clusterBuffer,
+        sizeof(uint32_t),
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    m_vgeComputePipeline->bind(frameInfo.commandBuffer);
+
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_pipelineLayout,
+        0,
+        1,
+        &frameInfo.globalDescriptorSet,
+        0,
+        nullptr);
+
+    // workgroup size is CLUSTER_X * CLUSTER_Y, see light_cluster.comp
+    vkCmdDispatch(frameInfo.commandBuffer, 1, 1, CLUSTER_Z);
+
+    recordBufferBarrier(
+        frameInfo.commandBuffer,
+        clusterBuffer,
+        VK_WHOLE_SIZE,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VgeBuffer& readback = *m_droppedLightReadbacks[frameInfo.frameIndex];
+    VkBufferCopy region{};
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = sizeof(uint32_t);
+    vkCmdCopyBuffer(frameInfo.commandBuffer, clusterBuffer, readback.getBuffer(), 1, &region);
+    recordBufferBarrier(
+        frameInfo.commandBuffer,
+        readback.getBuffer(),
+        VK_WHOLE_SIZE,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_HOST_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT);
+    m_hasDroppedLightReadback[frameInfo.frameIndex] = true;
+}
+
+/* Picks up the dropped light count of the frame index about to be culled.
+ *
+ * Reports the first time lights are dropped, a sign MAX_LIGHTS_PER_CLUSTER
+ * is too small for the scene. getDroppedLightCount keeps the latest count.
+ */
+void VgeLightClusterSystem::readDroppedLightCount(int frameIndex)
+{
+    if (!m_hasDroppedLightReadback[frameIndex]) {
+        return;
+    }
+    m_hasDroppedLightReadback[frameIndex] = false;
+
+    VgeBuffer& readback = *m_droppedLightReadbacks[frameIndex];
+    readback.invalidate();
+    m_droppedLightCount = *static_cast<const uint32_t*>(readback.getMappedMemory());
+    if (m_droppedLightCount > 0 && !m_reportedDroppedLights) {
+        std::cout << "Light clusters full: " << m_droppedLightCount
+                  << " lights dropped, MAX_LIGHTS_PER_CLUSTER is " << MAX_LIGHTS_PER_CLUSTER
+                  << std::endl;
+        m_reportedDroppedLights = true;
+    }
+}
+
+/* Get the descriptor info of a frame's cluster buffer.
+ *
+ * Bound as binding 2 of the global descriptor set.
+ */
+VkDescriptorBufferInfo VgeLightClusterSystem::getClusterBufferInfo(int frameIndex)
+{
+    return m_clusterBuffers[frameIndex]->descriptorInfo();
+}
+
+// Returns the number of lights dropped from full clusters by the latest completed culling pass.
+uint32_t VgeLightClusterSystem::getDroppedLightCount() const
+{
+    return m_droppedLightCount;
+}
+
+} // namespace vge
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../vge_buffer.hpp"
+#include "../vge_compute_pipeline.hpp"
+#include "../vge_device.hpp"
+#include "../vge_frame_info.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vge {
+
+class VgeLightClusterSystem {
+public:
+    // froxel grid, must match light_cluster.comp and the clustered fragment shaders
+    static constexpr uint32_t CLUSTER_X = 16;
+    static constexpr uint32_t CLUSTER_Y = 9;
+    static constexpr uint32_t CLUSTER_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+    // passed to light_cluster.comp and the clustered fragment shaders as a specialization
+    // constant, lights past it are dropped from the cluster and counted
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER_CONSTANT_ID = 5;
+
+    VgeLightClusterSystem(VgeDevice& device, VkDescriptorSetLayout globalSetLayout);
+    ~VgeLightClusterSystem();
+
+    VgeLightClusterSystem(const VgeLightClusterSystem&) = delete;
+    VgeLightClusterSystem& operator=(const VgeLightClusterSystem&) = delete;
+
+    void cullLights(FrameInfo& frameInfo);
+
+    VkDescriptorBufferInfo getClusterBufferInfo(int frameIndex);
+    uint32_t getDroppedLightCount() const;
+
+private:
+    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+    void createPipeline();
+    void readDroppedLightCount(int frameIndex);
+
+    VgeDevice& m_vgeDevice;
+    std::unique_ptr<VgeComputePipeline> m_vgeComputePipeline;
+    VkPipelineLayout m_pipelineLayout;
+    std::vector<std::unique_ptr<VgeBuffer>> m_clusterBuffers; // one per frame in flight
+
+    // the dropped light count of each frame's culling pass, copied out of its cluster buffer
+    std::vector<std::unique_ptr<VgeBuffer>> m_droppedLightReadbacks;
+    std::vector<bool> m_hasDroppedLightReadback;
+    uint32_t m_droppedLightCount; // of the latest completed culling pass
+    bool m_reportedDroppedLights;
+};
+
+} // namespace vge
@@ -0,0 +1,260 @@
+#include "vge_meshlet_culling_system.hpp"
+#include "../vge_game_object.hpp"
+#include "../vge_model.hpp"
+#include "../vge_swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <stdexcept>
+
+namespace vge {
+
+/* Constructs a VgeMeshletCullingSystem object.
+ *
+ * Creates the meshlet culling compute pipeline. Set 0 is the global set
+ * for the camera, set 1 the culled model's meshlets and the frame's
+ * indirect draw buffer. coneCulling enables backface culling of meshlets,
+ * which is only correct if the graphics pipelines cull back faces too.
+ */
+VgeMeshletCullingSystem::VgeMeshletCullingSystem(
+    VgeDevice& device,
+    VkDescriptorSetLayout globalSetLayout,
+    VgeDescriptorLayoutCache& layoutCache,
+    bool coneCulling)
+    : m_vgeDevice{ device }
+    , m_meshletSetLayout{
+        VgeDescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build(layoutCache)
+    }
+    , m_pipelineLayout{}
+    , m_cullPipeline{}
+    , m_coneCulling{ coneCulling }
+    , m_indirectBuffers(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_drawRanges{}
+{
+    createPipelineLayout(globalSetLayout);
+    m_cullPipeline = std::make_unique<VgeComputePipeline>(
+        m_vgeDevice,
+        "shaders/meshlet_cull.comp.spv",
+        m_pipelineLayout);
+}
+
+/* Destroys the VgeMeshletCullingSystem object.
+ *
+ * Cleans up the Vulkan pipeline layout used by the culling pass.
+ */
+VgeMeshletCullingSystem::~VgeMeshletCullingSystem()
+{
+    vkDestroyPipelineLayout(m_vgeDevice.getDevice(), m_pipelineLayout, nullptr);
+}
+
+/* Creates the pipeline layout of the culling pass.
+ *
+ * The global set and the meshlet set, plus the per object push constant.
+ */
+void VgeMeshletCullingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshletCullPushConstantData);
+
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalSetLayout,
+        m_meshletSetLayout.getDescriptorSetLayout(),
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(
+            m_vgeDevice.getDevice(),
+            &pipelineLayoutInfo,
+            nullptr,
+            &m_pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+}
+
+/* Makes sure the frame's indirect buffer can hold commandCount draws.
+ *
+ * The buffer grows by doubling. It is only replaced after the frame's fence
+ * has been waited on, so no submitted work still reads it.
+ */
+void VgeMeshletCullingSystem::reserveIndirectBuffer(int frameIndex, uint32_t commandCount)
+{
+    std::unique_ptr<VgeBuffer>& indirectBuffer = m_indirectBuffers[frameIndex];
+    if (indirectBuffer != nullptr && indirectBuffer->getInstanceCount() >= commandCount) {
+        return;
+    }
+
+    uint32_t capacity = indirectBuffer != nullptr ? indirectBuffer->getInstanceCount() : 256;
+    while (capacity < commandCount) {
+        capacity *= 2;
+    }
+    indirectBuffer = std::make_unique<VgeBuffer>(
+        m_vgeDevice,
+        sizeof(VkDrawIndexedIndirectCommand),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+/* Culls the meshlets of every queued full detail model with meshlets.
+ *
+ * Records one dispatch per such render queue item, each writing the
+ * item's indirect draws. Must be recorded outside the render pass, after
+ * the frame's uniform buffer has been written and the queue built. A
+ * barrier makes the draws visible to indirect draw calls.
+ */
+void VgeMeshletCullingSystem::cullMeshlets(FrameInfo& frameInfo, const VgeRenderQueue& renderQueue)
+{
+    const std::vector<VgeRenderQueue::DrawItem>& drawItems = renderQueue.getItems();
+    m_drawRanges.assign(drawItems.size(), DrawRange{});
+
+    uint32_t commandCount = 0;
+    for (const VgeRenderQueue::DrawItem& item : drawItems) {
+        if (item.lod == 0) {
+            commandCount += item.gameObject->m_model->getMeshletCount();
+        }
+    }
+    if (commandCount == 0) {
+        return;
+    }
+    reserveIndirectBuffer(frameInfo.frameIndex, commandCount);
+    VgeBuffer& indirectBuffer = *m_indirectBuffers[frameInfo.frameIndex];
+    VkDescriptorBufferInfo indirectBufferInfo = indirectBuffer.descriptorInfo();
+
+    m_cullPipeline->bind(frameInfo.commandBuffer);
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_pipelineLayout,
+        0,
+        1,
+        &frameInfo.globalDescriptorSet,
+        0,
+        nullptr);
+
+    uint32_t firstCommand = 0;
+    for (size_t i = 0; i < drawItems.size(); i++) {
+        VgeGameObject& obj = *drawItems[i].gameObject;
+        uint32_t meshletCount = obj.m_model->getMeshletCount();
+        if (drawItems[i].lod != 0 || meshletCount == 0) {
+            continue;
+        }
+
+        VkDescriptorBufferInfo meshletBufferInfo = obj.m_model->getMeshletBufferInfo();
+        VkDescriptorSet meshletSet{};
+        if (!VgeDescriptorWriter(m_meshletSetLayout, frameInfo.frameDescriptorAllocator)
+                 .writeBuffer(0, &meshletBufferInfo)
+                 .writeBuffer(1, &indirectBufferInfo)
+                 .build(meshletSet))
+        {
+            throw std::runtime_error("Failed to allocate meshlet descriptor set!");
+        }
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_pipelineLayout,
+            1,
+            1,
+            &meshletSet,
+            0,
+            nullptr);
+
+        const glm::vec3& scale = obj.m_transform.scale;
+        MeshletCullPushConstantData pushData{};
+        pushData.modelMatrix = obj.m_transform.mat4();
+        pushData.meshletCount = meshletCount;
+        pushData.firstCommand = firstCommand;
+        pushData.firstInstance = static_cast<uint32_t>(i);
+        pushData.maxScale =
+            glm::max(glm::abs(scale.x), glm::max(glm::abs(scale.y), glm::abs(scale.z)));
+        // cone axes are only rotated by the shader, non-uniform scale would bend them
+        pushData.coneCulling = m_coneCulling && scale.x == scale.y && scale.y == scale.z;
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_pipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(MeshletCullPushConstantData),
+            &pushData);
+
+        vkCmdDispatch(
+            frameInfo.commandBuffer,
+            (meshletCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+            1,
+            1);
+
+        m_drawRanges[i].offset = firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+        m_drawRanges[i].drawCount = meshletCount;
+        firstCommand += meshletCount;
+    }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = indirectBuffer.getBuffer();
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0,
+        0,
+        nullptr,
+        1,
+        &barrier,
+        0,
+        nullptr);
+}
+
+/* Draws a render queue item's meshlets from the culled indirect draws.
+ *
+ * The item's model must be bound. Returns false, recording nothing, if the
+ * item was not culled by meshlets this frame and has to be drawn whole.
+ * Without multi draw indirect support every meshlet is its own indirect
+ * draw call.
+ */
+bool VgeMeshletCullingSystem::drawMeshlets(FrameInfo& frameInfo, size_t queueIndex) const
+{
+    if (queueIndex >= m_drawRanges.size() || m_drawRanges[queueIndex].drawCount == 0) {
+        return false;
+    }
+
+    const DrawRange& drawRange = m_drawRanges[queueIndex];
+    VkBuffer indirectBuffer = m_indirectBuffers[frameInfo.frameIndex]->getBuffer();
+    constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (m_vgeDevice.supportsMultiDrawIndirect()) {
+        vkCmdDrawIndexedIndirect(
+            frameInfo.commandBuffer,
+            indirectBuffer,
+            drawRange.offset,
+            drawRange.drawCount,
+            stride);
+        return true;
+    }
+    for (uint32_t draw = 0; draw < drawRange.drawCount; draw++) {
+        vkCmdDrawIndexedIndirect(
+            frameInfo.commandBuffer,
+            indirectBuffer,
+            drawRange.offset + draw * stride,
+            1,
+            stride);
+    }
+    return true;
+}
+
+} // namespace vge
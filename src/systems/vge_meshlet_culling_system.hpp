@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../vge_buffer.hpp"
+#include "../vge_compute_pipeline.hpp"
+#include "../vge_descriptors.hpp"
+#include "../vge_device.hpp"
+#include "../vge_frame_info.hpp"
+#include "../vge_render_queue.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vge {
+
+struct MeshletCullPushConstantData
+{
+    glm::mat4 modelMatrix{ 1.f };
+    uint32_t meshletCount = 0;
+    uint32_t firstCommand = 0;  // first command of the object in the indirect buffer
+    uint32_t firstInstance = 0; // render queue index, the bindless object of the draws
+    float maxScale = 1.f;       // largest axis scale of modelMatrix, scales bounding spheres
+    uint32_t coneCulling = 0;
+};
+
+// Culls the meshlets of queued full detail models on the GPU. A compute pre-pass writes one
+// indexed indirect draw per meshlet, with an instance count of 0 for meshlets outside the
+// frustum or, when enabled, facing away from the camera
+class VgeMeshletCullingSystem {
+public:
+    // workgroup size of meshlet_cull.comp
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    // the indirect draws of one render queue item, none for items drawn whole
+    struct DrawRange
+    {
+        VkDeviceSize offset = 0;
+        uint32_t drawCount = 0;
+    };
+
+    VgeMeshletCullingSystem(
+        VgeDevice& device,
+        VkDescriptorSetLayout globalSetLayout,
+        VgeDescriptorLayoutCache& layoutCache,
+        bool coneCulling);
+    ~VgeMeshletCullingSystem();
+
+    VgeMeshletCullingSystem(const VgeMeshletCullingSystem&) = delete;
+    VgeMeshletCullingSystem& operator=(const VgeMeshletCullingSystem&) = delete;
+
+    void cullMeshlets(FrameInfo& frameInfo, const VgeRenderQueue& renderQueue);
+    bool drawMeshlets(FrameInfo& frameInfo, size_t queueIndex) const;
+
+private:
+    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+    void reserveIndirectBuffer(int frameIndex, uint32_t commandCount);
+
+    VgeDevice& m_vgeDevice;
+    VgeDescriptorSetLayout& m_meshletSetLayout;
+    VkPipelineLayout m_pipelineLayout;
+    std::unique_ptr<VgeComputePipeline> m_cullPipeline;
+    bool m_coneCulling; // only valid when back faces are culled by the graphics pipelines
+
+    std::vector<std::unique_ptr<VgeBuffer>> m_indirectBuffers; // one per frame in flight
+    std::vector<DrawRange> m_drawRanges; // per render queue item of the frame being recorded
+};
+
+} // namespace vge
@@ -0,0 +1,485 @@
+#include "vge_occlusion_culling_system.hpp"
+#include "../vge_swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vge {
+
+/* Constructs a VgeOcclusionCullingSystem object.
+ *
+ * Creates the reduction pipeline that builds the depth pyramid. The
+ * pyramids are created on first use, sized to the depth buffer.
+ */
+VgeOcclusionCullingSystem::VgeOcclusionCullingSystem(
+    VgeDevice& device,
+    VgeDescriptorLayoutCache& layoutCache)
+    : m_vgeDevice{ device }
+    , m_reduceSetLayout{
+        VgeDescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build(layoutCache)
+    }
+    , m_sampler{}
+    , m_pipelineLayout{}
+    , m_reducePipeline{}
+    , m_pyramids(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_readbackDepth{}
+    , m_readbackWidth{ 0 }
+    , m_readbackHeight{ 0 }
+    , m_readbackDepthExtent{}
+    , m_readbackShift{ 0 }
+    , m_readbackViewProjection{ 1.f }
+    , m_hasReadback{ false }
+{
+    createSampler();
+    createPipelineLayout();
+    m_reducePipeline = std::make_unique<VgeComputePipeline>(
+        m_vgeDevice,
+        "shaders/hiz_reduce.comp.spv",
+        m_pipelineLayout);
+}
+
+/* Destroys the VgeOcclusionCullingSystem object.
+ *
+ * Releases the depth pyramids, the sampler and the pipeline layout.
+ */
+VgeOcclusionCullingSystem::~VgeOcclusionCullingSystem()
+{
+    for (DepthPyramid& pyramid : m_pyramids) {
+        destroyDepthPyramid(pyramid);
+    }
+    vkDestroyPipelineLayout(m_vgeDevice.getDevice(), m_pipelineLayout, nullptr);
+    vkDestroySampler(m_vgeDevice.getDevice(), m_sampler, nullptr);
+}
+
+/* Creates the sampler the reduction reads its source level with.
+ *
+ * The shader only texelFetches, so a nearest, clamped sampler is enough.
+ */
+void VgeOcclusionCullingSystem::createSampler()
+{
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.f;
+
+    if (vkCreateSampler(m_vgeDevice.getDevice(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z sampler!");
+    }
+}
+
+/* Creates the pipeline layout of the reduction pass.
+ *
+ * Set 0 holds the source level and the destination mip, the push constant
+ * carries both extents.
+ */
+void VgeOcclusionCullingSystem::createPipelineLayout()
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(HiZPushConstantData);
+
+    VkDescriptorSetLayout setLayout = m_reduceSetLayout.getDescriptorSetLayout();
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(
+            m_vgeDevice.getDevice(),
+            &pipelineLayoutInfo,
+            nullptr,
+            &m_pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+}
+
+/* Creates a depth pyramid for a depth buffer of the given extent.
+ *
+ * Level 0 is half the depth resolution and every further level halves
+ * again down to 1x1. Each texel holds the farthest depth of its footprint,
+ * so a box is hidden when it is behind that depth. Also creates the host
+ * visible buffer the readback level is copied into.
+ */
+void VgeOcclusionCullingSystem::createDepthPyramid(DepthPyramid& pyramid, VkExtent2D depthExtent)
+{
+    pyramid.depthExtent = depthExtent;
+    pyramid.mipExtents.clear();
+    VkExtent2D mipExtent{ std::max(depthExtent.width / 2, 1u),
+                          std::max(depthExtent.height / 2, 1u) };
+    while (true) {
+        pyramid.mipExtents.push_back(mipExtent);
+        if (mipExtent.width == 1 && mipExtent.height == 1) {
+            break;
+        }
+        mipExtent = { std::max(mipExtent.width / 2, 1u), std::max(mipExtent.height / 2, 1u) };
+    }
+    uint32_t mipLevels = static_cast<uint32_t>(pyramid.mipExtents.size());
+
+    pyramid.readbackLevel = mipLevels - 1;
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        const VkExtent2D& extent = pyramid.mipExtents[level];
+        if (std::max(extent.width, extent.height) <= READBACK_MAX_SIZE) {
+            pyramid.readbackLevel = level;
+            break;
+        }
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = pyramid.mipExtents[0].width;
+    imageInfo.extent.height = pyramid.mipExtents[0].height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                      VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    m_vgeDevice.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        pyramid.image,
+        pyramid.memory);
+
+    // one view per level, each level is written as a storage image and read as the next source
+    pyramid.mipViews.resize(mipLevels);
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = pyramid.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(
+                m_vgeDevice.getDevice(),
+                &viewInfo,
+                nullptr,
+                &pyramid.mipViews[level]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create Hi-Z image view!");
+        }
+    }
+
+    const VkExtent2D& readbackExtent = pyramid.mipExtents[pyramid.readbackLevel];
+    pyramid.readbackBuffer = std::make_unique<VgeBuffer>(
+        m_vgeDevice,
+        sizeof(float),
+        readbackExtent.width * readbackExtent.height,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    pyramid.readbackBuffer->map();
+    pyramid.hasReadback = false;
+}
+
+/* Destroys a depth pyramid's image, views and readback buffer.
+ *
+ * Leaves the pyramid empty, ready to be created again.
+ */
+void VgeOcclusionCullingSystem::destroyDepthPyramid(DepthPyramid& pyramid)
+{
+    for (VkImageView mipView : pyramid.mipViews) {
+        vkDestroyImageView(m_vgeDevice.getDevice(), mipView, nullptr);
+    }
+    vkDestroyImage(m_vgeDevice.getDevice(), pyramid.image, nullptr);
+    vkFreeMemory(m_vgeDevice.getDevice(), pyramid.memory, nullptr);
+    pyramid = DepthPyramid{};
+}
+
+/* Picks up the depth readback of the frame index about to be recorded.
+ *
+ * The frame's fence has been waited on, so the readback its previous use
+ * recorded is complete. isOccluded tests against it until the next call.
+ * Without a readback, for example right after culling was enabled, no
+ * object is culled.
+ */
+void VgeOcclusionCullingSystem::beginFrame(int frameIndex)
+{
+    DepthPyramid& pyramid = m_pyramids[frameIndex];
+    m_hasReadback = pyramid.hasReadback;
+    if (!m_hasReadback) {
+        return;
+    }
+    pyramid.hasReadback = false;
+
+    pyramid.readbackBuffer->invalidate();
+    const VkExtent2D& extent = pyramid.mipExtents[pyramid.readbackLevel];
+    const float* depth = static_cast<const float*>(pyramid.readbackBuffer->getMappedMemory());
+    m_readbackDepth.assign(depth, depth + extent.width * extent.height);
+    m_readbackWidth = extent.width;
+    m_readbackHeight = extent.height;
+    m_readbackDepthExtent = pyramid.depthExtent;
+    // level 0 already halves the depth buffer
+    m_readbackShift = pyramid.readbackLevel + 1;
+    m_readbackViewProjection = pyramid.viewProjection;
+}
+
+/* Builds the frame's depth pyramid from its depth buffer.
+ *
+ * Must be recorded after the swap chain render pass, which leaves depth in
+ * the read only layout. Each level is reduced from the previous one by
+ * hiz_reduce.comp, then the readback level is copied to the host. The
+ * camera's view projection is kept with it for the test.
+ */
+void VgeOcclusionCullingSystem::buildDepthPyramid(
+    FrameInfo& frameInfo,
+    VkImageView depthView,
+    VkExtent2D extent)
+{
+    DepthPyramid& pyramid = m_pyramids[frameInfo.frameIndex];
+    if (pyramid.image == VK_NULL_HANDLE || pyramid.depthExtent.width != extent.width ||
+        pyramid.depthExtent.height != extent.height)
+    {
+        // only this frame index uses the pyramid and its fence has been waited on
+        destroyDepthPyramid(pyramid);
+        createDepthPyramid(pyramid, extent);
+    }
+    pyramid.viewProjection =
+        frameInfo.camera.getProjectionMatrix() * frameInfo.camera.getViewMatrix();
+    uint32_t mipLevels = static_cast<uint32_t>(pyramid.mipViews.size());
+
+    // every level is overwritten, so the previous contents can be discarded
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramid.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &barrier);
+
+    m_reducePipeline->bind(frameInfo.commandBuffer);
+
+    VkExtent2D srcExtent = extent;
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        VkDescriptorImageInfo srcInfo{};
+        srcInfo.sampler = m_sampler;
+        if (level == 0) {
+            srcInfo.imageView = depthView;
+            srcInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        }
+        else {
+            srcInfo.imageView = pyramid.mipViews[level - 1];
+            srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        VkDescriptorImageInfo dstInfo{
+            VK_NULL_HANDLE,
+            pyramid.mipViews[level],
+            VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        VkDescriptorSet reduceSet{};
+        if (!VgeDescriptorWriter(m_reduceSetLayout, frameInfo.frameDescriptorAllocator)
+                 .writeImage(0, &srcInfo)
+                 .writeImage(1, &dstInfo)
+                 .build(reduceSet))
+        {
+            throw std::runtime_error("Failed to allocate Hi-Z descriptor set!");
+        }
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_pipelineLayout,
+            0,
+            1,
+            &reduceSet,
+            0,
+            nullptr);
+
+        const VkExtent2D& dstExtent = pyramid.mipExtents[level];
+        HiZPushConstantData pushData{};
+        pushData.srcExtent = glm::ivec2(srcExtent.width, srcExtent.height);
+        pushData.dstExtent = glm::ivec2(dstExtent.width, dstExtent.height);
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_pipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(HiZPushConstantData),
+            &pushData);
+
+        vkCmdDispatch(
+            frameInfo.commandBuffer,
+            (dstExtent.width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            (dstExtent.height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            1);
+
+        // the level is the source of the next reduction, and maybe of the readback copy
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = 1;
+        vkCmdPipelineBarrier(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            1,
+            &barrier);
+
+        srcExtent = dstExtent;
+    }
+
+    const VkExtent2D& readbackExtent = pyramid.mipExtents[pyramid.readbackLevel];
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = pyramid.readbackLevel;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { readbackExtent.width, readbackExtent.height, 1 };
+    vkCmdCopyImageToBuffer(
+        frameInfo.commandBuffer,
+        pyramid.image,
+        VK_IMAGE_LAYOUT_GENERAL,
+        pyramid.readbackBuffer->getBuffer(),
+        1,
+        &region);
+
+    VkBufferMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    readbackBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    readbackBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    readbackBarrier.buffer = pyramid.readbackBuffer->getBuffer();
+    readbackBarrier.offset = 0;
+    readbackBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        0,
+        nullptr,
+        1,
+        &readbackBarrier,
+        0,
+        nullptr);
+
+    pyramid.hasReadback = true;
+}
+
+/* Maps an ndc coordinate to the readback texel covering it along one axis.
+ *
+ * The coordinate goes through the depth buffer pixel it falls on, and that
+ * pixel through the level footprints the pyramid was reduced with.
+ */
+uint32_t VgeOcclusionCullingSystem::readbackTexel(
+    float ndc,
+    uint32_t depthSize,
+    uint32_t readbackSize) const
+{
+    uint32_t pixel = std::min(static_cast<uint32_t>((ndc * .5f + .5f) * depthSize), depthSize - 1);
+    return std::min(pixel >> m_readbackShift, readbackSize - 1);
+}
+
+/* Tests whether a model is hidden behind the read back depth.
+ *
+ * The model's bounding box is projected with the view projection the depth
+ * was rendered with. The box is occluded when its nearest depth is behind
+ * the farthest depth of every readback texel its screen rectangle touches.
+ * Boxes crossing the camera plane or leaving the screen are never culled,
+ * so the test only errs towards drawing.
+ */
+bool VgeOcclusionCullingSystem::isOccluded(const VgeModel& model, const glm::mat4& modelMatrix)
+    const
+{
+    if (!m_hasReadback) {
+        return false;
+    }
+
+    glm::mat4 modelViewProjection = m_readbackViewProjection * modelMatrix;
+    const glm::vec3& boundsMin = model.getBoundsMin();
+    const glm::vec3& boundsMax = model.getBoundsMax();
+
+    glm::vec2 ndcMin{ 1.f };
+    glm::vec2 ndcMax{ -1.f };
+    float nearestDepth = 1.f;
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        glm::vec3 position{ (corner & 1) ? boundsMax.x : boundsMin.x,
+                            (corner & 2) ? boundsMax.y : boundsMin.y,
+                            (corner & 4) ? boundsMax.z : boundsMin.z };
+        glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.f);
+        if (clip.w <= 0.f) {
+            return false;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+        ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+        nearestDepth = std::min(nearestDepth, ndc.z);
+    }
+    if (ndcMin.x < -1.f || ndcMin.y < -1.f || ndcMax.x > 1.f || ndcMax.y > 1.f) {
+        return false;
+    }
+
+    // ndc to depth buffer pixels, rows run top to bottom like ndc y. Every level floor halves the
+    // previous one and hiz_reduce.comp folds an odd last row and column into the last texel, so
+    // a pixel lands in texel pixel >> shift, clamped to the level's last texel
+    uint32_t x0 = readbackTexel(ndcMin.x, m_readbackDepthExtent.width, m_readbackWidth);
+    uint32_t y0 = readbackTexel(ndcMin.y, m_readbackDepthExtent.height, m_readbackHeight);
+    uint32_t x1 = readbackTexel(ndcMax.x, m_readbackDepthExtent.width, m_readbackWidth);
+    uint32_t y1 = readbackTexel(ndcMax.y, m_readbackDepthExtent.height, m_readbackHeight);
+
+    for (uint32_t y = y0; y <= y1; y++) {
+        for (uint32_t x = x0; x <= x1; x++) {
+            if (nearestDepth <= m_readbackDepth[y * m_readbackWidth + x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace vge
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../vge_buffer.hpp"
+#include "../vge_compute_pipeline.hpp"
+#include "../vge_descriptors.hpp"
+#include "../vge_device.hpp"
+#include "../vge_frame_info.hpp"
+#include "../vge_model.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vge {
+
+struct HiZPushConstantData
+{
+    glm::ivec2 srcExtent{};
+    glm::ivec2 dstExtent{};
+};
+
+// Occlusion culling against a hierarchical depth (Hi-Z) pyramid of an earlier frame. The
+// pyramid is reduced on the GPU, a coarse mip is read back and objects are tested on the CPU
+class VgeOcclusionCullingSystem {
+public:
+    // workgroup size of hiz_reduce.comp
+    static constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+    // the first mip whose larger side is at most this many texels is read back
+    static constexpr uint32_t READBACK_MAX_SIZE = 128;
+
+    VgeOcclusionCullingSystem(VgeDevice& device, VgeDescriptorLayoutCache& layoutCache);
+    ~VgeOcclusionCullingSystem();
+
+    VgeOcclusionCullingSystem(const VgeOcclusionCullingSystem&) = delete;
+    VgeOcclusionCullingSystem& operator=(const VgeOcclusionCullingSystem&) = delete;
+
+    void beginFrame(int frameIndex);
+    void buildDepthPyramid(FrameInfo& frameInfo, VkImageView depthView, VkExtent2D extent);
+    bool isOccluded(const VgeModel& model, const glm::mat4& modelMatrix) const;
+
+private:
+    struct DepthPyramid
+    {
+        VkExtent2D depthExtent{}; // extent of the depth buffer the pyramid was built from
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        std::vector<VkImageView> mipViews{};
+        std::vector<VkExtent2D> mipExtents{};
+        uint32_t readbackLevel = 0;
+        std::unique_ptr<VgeBuffer> readbackBuffer{};
+        glm::mat4 viewProjection{ 1.f };
+        bool hasReadback = false; // set when built, cleared once read back
+    };
+
+    void createSampler();
+    void createPipelineLayout();
+    void createDepthPyramid(DepthPyramid& pyramid, VkExtent2D depthExtent);
+    void destroyDepthPyramid(DepthPyramid& pyramid);
+    uint32_t readbackTexel(float ndc, uint32_t depthSize, uint32_t readbackSize) const;
+
+    VgeDevice& m_vgeDevice;
+    VgeDescriptorSetLayout& m_reduceSetLayout;
+    VkSampler m_sampler;
+    VkPipelineLayout m_pipelineLayout;
+    std::unique_ptr<VgeComputePipeline> m_reducePipeline;
+    std::vector<DepthPyramid> m_pyramids; // one per frame in flight
+
+    // coarse depth of the latest completed frame, tested against by isOccluded
+    std::vector<float> m_readbackDepth;
+    uint32_t m_readbackWidth;
+    uint32_t m_readbackHeight;
+    VkExtent2D m_readbackDepthExtent; // depth buffer pixels the readback level was reduced from
+    uint32_t m_readbackShift; // depth buffer pixel to readback texel, readback level + 1
+    glm::mat4 m_readbackViewProjection;
+    bool m_hasReadback;
+};
+
+} // namespace vge
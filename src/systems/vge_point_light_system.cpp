@@ -1,4 +1,6 @@
 #include "vge_point_light_system.hpp"
+#include "../vge_light_store.hpp"
+#include "../vge_swapchain.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -17,18 +19,28 @@ namespace vge {
  *
  * Initializes the point light system by creating the pipeline layout
  * and pipeline with the provided Vulkan device, render pass, and global
- * descriptor set layout.
+ * descriptor set layout. The per-frame light buffers are created up front
+ * so the global descriptor sets can reference them before the first update.
  */
 VgePointLightSystem::VgePointLightSystem(
     VgeDevice& device,
     VkRenderPass renderPass,
-    VkDescriptorSetLayout globalSetLayout)
+    VkDescriptorSetLayout globalSetLayout,
+    VgeThreadPool& threadPool)
     : m_vgeDevice{ device }
     , m_vgePipeline{}
     , m_pipelineLayout{}
+    , m_threadPool{ threadPool }
+    , m_lightBuffers(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_lightCapacities(VgeSwapChain::MAX_FRAMES_IN_FLIGHT, INITIAL_LIGHT_CAPACITY)
+    , m_lightCount{ 0 }
 {
     createPipelineLayout(globalSetLayout);
     createPipeline(renderPass);
+
+    for (std::unique_ptr<VgeBuffer>& lightBuffer : m_lightBuffers) {
+        lightBuffer = createLightBuffer(INITIAL_LIGHT_CAPACITY);
+    }
 }
 
 /* Destroys the VgePointLightSystem object.
@@ -43,25 +55,20 @@ VgePointLightSystem::~VgePointLightSystem()
 
 /* Creates the pipeline layout for the point light system.
  *
- * Sets up the push constant range and descriptor set layouts for the
- * pipeline, allowing the shader to access point light information.
+ * Sets up the descriptor set layouts for the pipeline. The billboards read
+ * every point light from the light buffer of the global set, so no push
+ * constants are needed.
  */
 void VgePointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(PointLightPushConstants);
-
-    // TODO: for having multiple sets (currently only set 0, so not needed yet)
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
     if (vkCreatePipelineLayout(
             m_vgeDevice.getDevice(),
             &pipelineLayoutInfo,
@@ -94,43 +101,94 @@ void VgePointLightSystem::createPipeline(VkRenderPass renderPass)
         pipelineConfig);
 }
 
-/* Updates the point lights in the current frame.
+/* Creates a host visible light storage buffer.
  *
- * Rotates the lights based on the frame time and updates their positions
- * and colors in the global uniform buffer object for rendering.
+ * The buffer holds a PointLightBufferHeader followed by room for
+ * lightCapacity point lights, and stays mapped for its whole lifetime.
  */
-void VgePointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo)
+std::unique_ptr<VgeBuffer> VgePointLightSystem::createLightBuffer(uint32_t lightCapacity)
 {
-    // rotate lights
-    glm::mat<4, 4, float, (glm::qualifier)0U> rotateLight =
-        glm::rotate(glm::mat4(1.f), frameInfo.frameTime, { 0.f, -1.f, 0.f });
-
-    int lightIndex = 0;
-    for (std::pair<const unsigned int, VgeGameObject>& kv : frameInfo.gameObjects) {
-        VgeGameObject& obj = kv.second;
-        if (obj.m_pointLight == nullptr)
-            continue;
+    std::unique_ptr<VgeBuffer> lightBuffer = std::make_unique<VgeBuffer>(
+        m_vgeDevice,
+        sizeof(PointLightBufferHeader) + sizeof(PointLight) * lightCapacity,
+        1,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    lightBuffer->map();
+    return lightBuffer;
+}
 
-        assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified!");
+/* Makes sure the frame's light buffer can hold lightCount lights.
+ *
+ * The capacity doubles until it fits. Returns true if the buffer was
+ * replaced, in which case descriptor sets referencing it must be rewritten.
+ * Only called after the frame's fence was waited on, so the old buffer is
+ * no longer in use.
+ */
+bool VgePointLightSystem::reserveLightBuffer(int frameIndex, uint32_t lightCount)
+{
+    uint32_t& capacity = m_lightCapacities[frameIndex];
+    if (lightCount <= capacity) {
+        return false;
+    }
 
-        // update light postion
-        obj.m_transform.translation =
-            glm::vec3(rotateLight * glm::vec4(obj.m_transform.translation, 1.f));
+    while (capacity < lightCount) {
+        capacity *= 2;
+    }
+    m_lightBuffers[frameIndex] = createLightBuffer(capacity);
+    return true;
+}
 
-        // copy light to ubo
-        ubo.pointLights[lightIndex].position = glm::vec4(obj.m_transform.translation, 1.f);
-        ubo.pointLights[lightIndex].color =
-            glm::vec4(obj.m_color, obj.m_pointLight->lightIntensity);
+/* Updates the point lights in the current frame.
+ *
+ * Rotates the lights of the frame's light store based on the frame time and
+ * packs them straight into the mapped light buffer in the same pass. Only
+ * lights are visited, however many game objects the scene has, and large
+ * light counts are split across the thread pool. Returns true if the light
+ * buffer had to grow, meaning the frame's global descriptor set must be
+ * pointed at getLightBufferInfo again.
+ */
+bool VgePointLightSystem::update(FrameInfo& frameInfo)
+{
+    VgeLightStore& lightStore = frameInfo.lightStore;
+    m_lightCount = static_cast<uint32_t>(lightStore.size());
+    bool reallocated = reserveLightBuffer(frameInfo.frameIndex, m_lightCount);
+
+    VgeBuffer& lightBuffer = *m_lightBuffers[frameInfo.frameIndex];
+    PointLightBufferHeader header{};
+    header.numLights = static_cast<int>(m_lightCount);
+    lightBuffer.writeToBuffer(&header, sizeof(PointLightBufferHeader), 0);
+
+    // rotate lights, writing each one into the light buffer right after its update
+    PointLight* packed = reinterpret_cast<PointLight*>(
+        static_cast<char*>(lightBuffer.getMappedMemory()) + sizeof(PointLightBufferHeader));
+    float angle = frameInfo.frameTime;
+    m_threadPool.parallelFor(
+        m_lightCount,
+        MIN_LIGHTS_PER_TASK,
+        [&lightStore, angle, packed](size_t begin, size_t end)
+        {
+            lightStore.rotateAndPack(begin, end, angle, packed);
+        });
+    lightBuffer.flush();
+
+    return reallocated;
+}
 
-        lightIndex += 1;
-    }
-    ubo.numLights = lightIndex;
+/* Get the descriptor info of a frame's light buffer.
+ *
+ * Bound as binding 1 of the global descriptor set.
+ */
+VkDescriptorBufferInfo VgePointLightSystem::getLightBufferInfo(int frameIndex)
+{
+    return m_lightBuffers[frameIndex]->descriptorInfo();
 }
 
 /* Renders the point lights for the current frame.
  *
- * Binds the pipeline and descriptor sets, then pushes the point light
- * data to the shaders and issues draw calls for each active point light.
+ * Binds the pipeline and descriptor sets, then draws every billboard with a
+ * single instanced draw. Each instance reads its light from the frame's
+ * light buffer written by update, so nothing is recorded per light.
  */
 void VgePointLightSystem::render(FrameInfo& frameInfo)
 {
@@ -146,25 +204,8 @@ void VgePointLightSystem::render(FrameInfo& frameInfo)
         0,
         nullptr);
 
-    for (std::pair<const unsigned int, VgeGameObject>& kv : frameInfo.gameObjects) {
-        VgeGameObject& obj = kv.second;
-        if (obj.m_pointLight == nullptr)
-            continue;
-
-        PointLightPushConstants push{};
-        push.position = glm::vec4(obj.m_transform.translation, 1.f);
-        push.color = glm::vec4(obj.m_color, obj.m_pointLight->lightIntensity);
-        push.radius = obj.m_transform.scale.x;
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            m_pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(PointLightPushConstants),
-            &push);
-
-        vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+    if (m_lightCount > 0) {
+        vkCmdDraw(frameInfo.commandBuffer, 6, m_lightCount, 0, 0);
     }
 }
 
@@ -1,43 +1,53 @@
 #pragma once
 
+#include "../vge_buffer.hpp"
 #include "../vge_device.hpp"
 #include "../vge_frame_info.hpp"
 #include "../vge_pipeline.hpp"
+#include "../vge_thread_pool.hpp"
 
 #include <vulkan/vulkan_core.h>
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace vge {
 
-struct PointLightPushConstants
-{
-    glm::vec4 position{};
-    glm::vec4 color{};
-    float radius;
-};
-
 class VgePointLightSystem {
 public:
     VgePointLightSystem(
         VgeDevice& device,
         VkRenderPass renderPass,
-        VkDescriptorSetLayout globalSetLayout);
+        VkDescriptorSetLayout globalSetLayout,
+        VgeThreadPool& threadPool);
     ~VgePointLightSystem();
 
     VgePointLightSystem(const VgePointLightSystem&) = delete;
     VgePointLightSystem& operator=(const VgePointLightSystem&) = delete;
 
-    void update(FrameInfo& frameInfo, GlobalUbo& ubo);
+    static constexpr uint32_t INITIAL_LIGHT_CAPACITY = 16;
+    static constexpr size_t MIN_LIGHTS_PER_TASK = 4096; // below this, update runs inline
+
+    bool update(FrameInfo& frameInfo);
     void render(FrameInfo& frameInfo);
 
+    VkDescriptorBufferInfo getLightBufferInfo(int frameIndex);
+
 private:
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
     void createPipeline(VkRenderPass renderPass);
+    std::unique_ptr<VgeBuffer> createLightBuffer(uint32_t lightCapacity);
+    bool reserveLightBuffer(int frameIndex, uint32_t lightCount);
 
     VgeDevice& m_vgeDevice; // use device for window
     std::unique_ptr<VgePipeline> m_vgePipeline;
     VkPipelineLayout m_pipelineLayout;
+    VgeThreadPool& m_threadPool;
+
+    std::vector<std::unique_ptr<VgeBuffer>> m_lightBuffers; // one per frame in flight
+    std::vector<uint32_t> m_lightCapacities;
+    uint32_t m_lightCount; // lights written by the last update
 };
 
 } // namespace vge
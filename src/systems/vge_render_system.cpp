@@ -1,11 +1,15 @@
 #include "vge_render_system.hpp"
+#include "vge_light_cluster_system.hpp"
 #include "../vge_game_object.hpp"
+#include "../vge_model.hpp"
+#include "../vge_swapchain.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <array>
 #include <cassert>
 #include <stdexcept>
 
@@ -13,29 +17,49 @@ namespace vge {
 
 /* Constructs a VgeRenderSystem object.
  *
- * Initializes the render system by creating the pipeline layout and
- * pipeline with the provided Vulkan device, render pass, and global
- * descriptor set layout.
+ * Initializes the render system by creating the pipeline layout with the
+ * provided Vulkan device, render pass, and global descriptor set layout.
+ * Pipelines are created when the first model of their vertex format is
+ * drawn. When bindless descriptors are given, per-object
+ * data is read from a storage buffer instead of push constants.
  */
 VgeRenderSystem::VgeRenderSystem(
     VgeDevice& device,
     VkRenderPass renderPass,
-    VkDescriptorSetLayout globalSetLayout)
+    VkDescriptorSetLayout globalSetLayout,
+    VgeBindlessDescriptors* bindless)
     : m_vgeDevice{ device }
-    , m_vgePipeline{}
+    , m_renderPass{ renderPass }
+    , m_pipelineVariants{}
+    , m_vgePipelines{}
+    , m_shaderFeatures{}
     , m_pipelineLayout{}
+    , m_renderQueue{}
+    , m_depthPrepass{ false }
+    , m_depthPrepassPipelines{}
+    , m_occlusionCulling{ nullptr }
+    , m_meshletCulling{ nullptr }
+    , m_bindless{ bindless }
+    , m_objectBuffers(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+    , m_objectBufferIndices(
+          VgeSwapChain::MAX_FRAMES_IN_FLIGHT,
+          VgeBindlessDescriptors::INVALID_INDEX)
 {
     createPipelineLayout(globalSetLayout);
-    createPipeline(renderPass);
 }
 
 /* Destroys the VgeRenderSystem object.
  *
  * Cleans up the Vulkan pipeline layout used by the render system
- * to release resources.
+ * to release resources, and hands the object buffer slots back.
  */
 VgeRenderSystem::~VgeRenderSystem()
 {
+    for (uint32_t index : m_objectBufferIndices) {
+        if (index != VgeBindlessDescriptors::INVALID_INDEX) {
+            m_bindless->removeStorageBuffer(index);
+        }
+    }
     vkDestroyPipelineLayout(m_vgeDevice.getDevice(), m_pipelineLayout, nullptr);
 }
 
@@ -43,6 +67,8 @@ VgeRenderSystem::~VgeRenderSystem()
  *
  * Sets up the push constant range and descriptor set layouts for the
  * pipeline, allowing the shader to access model transformation data.
+ * In bindless mode set 1 is the bindless set and the push constant only
+ * carries the index of the object buffer.
  */
 void VgeRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
@@ -51,8 +77,11 @@ void VgeRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout
     pushConstantRange.offset = 0;
     pushConstantRange.size = sizeof(SimplePushConstantData);
 
-    // TODO: for having multiple sets (currently only set 0, so not needed yet)
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+    if (m_bindless != nullptr) {
+        descriptorSetLayouts.push_back(m_bindless->getDescriptorSetLayout());
+        pushConstantRange.size = sizeof(BindlessPushConstantData);
+    }
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -70,35 +99,191 @@ void VgeRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout
     }
 }
 
-/* Creates the graphics pipeline for rendering game objects.
+/* Creates the depth-only pre-pass pipeline for a vertex format.
  *
- * Configures the pipeline settings, including vertex and fragment shader
- * paths, and binds it to the specified render pass.
+ * Only the position stream is fetched and no color is written, so the pass
+ * costs little more than rasterization. Its vertex shaders compute
+ * gl_Position exactly like the shaded ones and declare it invariant, so
+ * the shaded pass can match the stored depth with an EQUAL test. Packed
+ * positions need no decoding here, the vertex fetch expands them.
  */
-void VgeRenderSystem::createPipeline(VkRenderPass renderPass)
+void VgeRenderSystem::createDepthPrepassPipeline(VgeModel::VertexFormat vertexFormat)
 {
     assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
     PipelineConfigInfo pipelineConfig{};
     VgePipeline::defaultPipelineConfigInfo(pipelineConfig);
-    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.bindingDescriptions = VgeModel::getPositionBindingDescriptions(vertexFormat);
+    pipelineConfig.attributeDescriptions =
+        VgeModel::getPositionAttributeDescriptions(vertexFormat);
+    pipelineConfig.colorBlendAttachment.colorWriteMask = 0;
+    pipelineConfig.renderPass = m_renderPass;
     pipelineConfig.pipelineLayout = m_pipelineLayout;
-    m_vgePipeline = std::make_unique<VgePipeline>(
+
+    m_depthPrepassPipelines[static_cast<uint32_t>(vertexFormat)] = std::make_unique<VgePipeline>(
         m_vgeDevice,
-        "./shaders/shader.vert.spv",
-        "./shaders/shader.frag.spv",
+        m_bindless != nullptr ? "./shaders/bindless_depth_prepass.vert.spv"
+                              : "./shaders/depth_prepass.vert.spv",
+        "./shaders/depth_prepass.frag.spv",
         pipelineConfig);
 }
 
+/* Retrieves the graphics pipeline specialized for the given shader features.
+ *
+ * The features are baked into the pipeline as specialization constants, so
+ * the driver can drop disabled branches and unroll fixed light loops. Each
+ * distinct variant is compiled once and cached by its variant key, its
+ * variant state compared on a hit so colliding keys never share a
+ * pipeline. With the depth pre-pass enabled the variant only shades
+ * fragments whose depth equals the pre-pass result and leaves the depth
+ * buffer untouched. The vertex format selects the vertex input and whether
+ * the vertex shader decodes packed normals.
+ */
+VgePipeline& VgeRenderSystem::getPipelineVariant(
+    const ShaderFeatures& features,
+    VgeModel::VertexFormat vertexFormat)
+{
+    assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+    PipelineConfigInfo pipelineConfig{};
+    VgePipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.bindingDescriptions = VgeModel::getBindingDescriptions(vertexFormat);
+    pipelineConfig.attributeDescriptions = VgeModel::getAttributeDescriptions(vertexFormat);
+    pipelineConfig.renderPass = m_renderPass;
+    pipelineConfig.pipelineLayout = m_pipelineLayout;
+    VgePipeline::addSpecializationConstant(
+        pipelineConfig,
+        SPECULAR_CONSTANT_ID,
+        static_cast<uint32_t>(features.specular ? VK_TRUE : VK_FALSE));
+    VgePipeline::addSpecializationConstant(
+        pipelineConfig,
+        SPECULAR_EXPONENT_CONSTANT_ID,
+        features.specularExponent);
+    VgePipeline::addSpecializationConstant(
+        pipelineConfig,
+        LIGHT_COUNT_CONSTANT_ID,
+        static_cast<uint32_t>(features.lightCount));
+    VgePipeline::addSpecializationConstant(
+        pipelineConfig,
+        CLUSTERED_SHADING_CONSTANT_ID,
+        static_cast<uint32_t>(features.clusteredLighting ? VK_TRUE : VK_FALSE));
+    VgePipeline::addSpecializationConstant(
+        pipelineConfig,
+        PACKED_VERTICES_CONSTANT_ID,
+        static_cast<uint32_t>(vertexFormat == VgeModel::VertexFormat::PACKED ? VK_TRUE : VK_FALSE));
+    VgePipeline::addSpecializationConstant(
+        pipelineConfig,
+        VgeLightClusterSystem::MAX_LIGHTS_PER_CLUSTER_CONSTANT_ID,
+        VgeLightClusterSystem::MAX_LIGHTS_PER_CLUSTER);
+    if (m_depthPrepass) {
+        pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    }
+    VgePipeline::foldVariantKey(
+        pipelineConfig,
+        static_cast<uint64_t>(pipelineConfig.depthStencilInfo.depthCompareOp));
+
+    std::vector<std::unique_ptr<VgePipeline>>& variants =
+        m_pipelineVariants[pipelineConfig.variantKey];
+    for (std::unique_ptr<VgePipeline>& variant : variants) {
+        if (variant->getVariantState() == pipelineConfig.variantState) {
+            return *variant;
+        }
+    }
+    variants.push_back(std::make_unique<VgePipeline>(
+        m_vgeDevice,
+        m_bindless != nullptr ? "./shaders/bindless.vert.spv" : "./shaders/shader.vert.spv",
+        m_bindless != nullptr ? "./shaders/bindless.frag.spv" : "./shaders/shader.frag.spv",
+        pipelineConfig));
+    return *variants.back();
+}
+
+/* Retrieves the pipeline drawing models of a vertex format.
+ *
+ * The depth pre-pass pipeline when depthOnly is set, otherwise the variant
+ * matching the current shader features. Either is created on first use.
+ */
+VgePipeline& VgeRenderSystem::getPipeline(bool depthOnly, VgeModel::VertexFormat vertexFormat)
+{
+    uint32_t formatIndex = static_cast<uint32_t>(vertexFormat);
+    if (depthOnly) {
+        if (m_depthPrepassPipelines[formatIndex] == nullptr) {
+            createDepthPrepassPipeline(vertexFormat);
+        }
+        return *m_depthPrepassPipelines[formatIndex];
+    }
+    if (m_vgePipelines[formatIndex] == nullptr) {
+        m_vgePipelines[formatIndex] = &getPipelineVariant(m_shaderFeatures, vertexFormat);
+    }
+    return *m_vgePipelines[formatIndex];
+}
+
+/* Selects the shader features used for subsequent draws.
+ *
+ * The active pipelines switch to the variants specialized for the features,
+ * compiled on first use.
+ */
+void VgeRenderSystem::setShaderFeatures(const ShaderFeatures& features)
+{
+    m_shaderFeatures = features;
+    m_vgePipelines.fill(nullptr);
+}
+
+/* Enables or disables the depth pre-pass.
+ *
+ * Worth enabling in scenes with heavy overdraw: every object is drawn
+ * twice, but the expensive fragment shader then runs only once per pixel.
+ * The active pipelines switch to the matching depth test variants.
+ */
+void VgeRenderSystem::setDepthPrepass(bool enabled)
+{
+    if (enabled == m_depthPrepass) {
+        return;
+    }
+    m_depthPrepass = enabled;
+    m_vgePipelines.fill(nullptr);
+}
+
+/* Sets the occlusion culling system the render queue is filtered with.
+ *
+ * Objects it reports as hidden behind an earlier frame's depth are not
+ * drawn. Pass nullptr to draw every object.
+ */
+void VgeRenderSystem::setOcclusionCulling(const VgeOcclusionCullingSystem* occlusionCulling)
+{
+    m_occlusionCulling = occlusionCulling;
+}
+
+/* Sets the meshlet culling system whose indirect draws are used.
+ *
+ * It must have culled the current render queue this frame. Queue items it
+ * culled are drawn meshlet by meshlet, the others whole. Pass nullptr to
+ * draw every model whole.
+ */
+void VgeRenderSystem::setMeshletCulling(const VgeMeshletCullingSystem* meshletCulling)
+{
+    m_meshletCulling = meshletCulling;
+}
+
+// Returns the render queue of the frame, valid after buildRenderQueue.
+const VgeRenderQueue& VgeRenderSystem::getRenderQueue() const
+{
+    return m_renderQueue;
+}
+
 /* Renders game objects in the current frame.
  *
- * Binds the pipeline and descriptor sets, then pushes the transformation
- * matrices for each game object to the shaders and issues draw calls
- * for the corresponding models.
+ * Draws the render queue built by buildRenderQueue this frame. Binds the
+ * descriptor sets, then draws every queued object with the depth-only
+ * pipelines when the pre-pass is enabled, and again with the shading
+ * pipelines.
  */
 void VgeRenderSystem::renderGameObjects(FrameInfo& frameInfo)
 {
-    m_vgePipeline->bind(frameInfo.commandBuffer);
+    if (m_bindless != nullptr) {
+        renderGameObjectsBindless(frameInfo);
+        return;
+    }
 
     vkCmdBindDescriptorSets(
         frameInfo.commandBuffer,
@@ -110,13 +295,76 @@ void VgeRenderSystem::renderGameObjects(FrameInfo& frameInfo)
         0,
         nullptr);
 
+    if (m_depthPrepass) {
+        drawGameObjects(frameInfo, true);
+    }
+    drawGameObjects(frameInfo, false);
+}
+
+/* Fills the render queue with the frame's drawable game objects.
+ *
+ * Models only select the pipeline by their vertex format, so the key
+ * orders by vertex format, texture, then model, then the view depth of the
+ * object's origin. Draws sharing a model end up adjacent, and each run is
+ * drawn front to back so early depth testing rejects as much as possible.
+ * Objects the occlusion culling system reports as hidden are skipped, and
+ * each object's LOD is picked from its distance. Must be called before the
+ * render pass, so meshlet culling can run on the queue in between.
+ */
+void VgeRenderSystem::buildRenderQueue(FrameInfo& frameInfo)
+{
+    const glm::mat4& view = frameInfo.camera.getViewMatrix();
+    float projectionScale = frameInfo.camera.getProjectionMatrix()[1][1];
+    float zNear = frameInfo.camera.getNear();
+    float zFar = frameInfo.camera.getFar();
+
+    m_renderQueue.clear();
     for (std::pair<const unsigned int, VgeGameObject>& kv : frameInfo.gameObjects) {
-        // kv.second = gameObj kv.first = objId
         VgeGameObject& obj = kv.second;
         if (obj.m_model == nullptr)
             continue;
+        if (m_occlusionCulling != nullptr &&
+            m_occlusionCulling->isOccluded(*obj.m_model, obj.m_transform.mat4()))
+        {
+            continue;
+        }
+        float depthView = (view * glm::vec4(obj.m_transform.translation, 1.f)).z;
+        uint64_t sortKey = VgeRenderQueue::makeSortKey(
+            static_cast<uint32_t>(obj.m_model->getVertexFormat()),
+            obj.m_textureIndex,
+            m_renderQueue.getMeshId(obj.m_model.get()),
+            (depthView - zNear) / (zFar - zNear));
+        uint32_t lod =
+            obj.m_model->selectLod(depthView, obj.m_transform.scale, projectionScale);
+        m_renderQueue.push(sortKey, obj, lod);
+    }
+    m_renderQueue.sort();
+}
+
+/* Draws the sorted render queue with the shading or depth-only pipelines.
+ *
+ * Pushes the transformation matrices for each game object to the shaders
+ * and issues draw calls for the corresponding models, or their culled
+ * meshlets. The model matrix includes the model's position dequantization.
+ * Pipelines are only rebound when the vertex format changes, vertex and
+ * index buffers when the model changes.
+ */
+void VgeRenderSystem::drawGameObjects(FrameInfo& frameInfo, bool depthOnly)
+{
+    const std::vector<VgeRenderQueue::DrawItem>& drawItems = m_renderQueue.getItems();
+    VgePipeline* boundPipeline = nullptr;
+    VgeModel* boundModel = nullptr;
+    for (size_t i = 0; i < drawItems.size(); i++) {
+        const VgeRenderQueue::DrawItem& item = drawItems[i];
+        VgeGameObject& obj = *item.gameObject;
+        VgePipeline& pipeline = getPipeline(depthOnly, obj.m_model->getVertexFormat());
+        if (&pipeline != boundPipeline) {
+            pipeline.bind(frameInfo.commandBuffer);
+            boundPipeline = &pipeline;
+        }
+
         SimplePushConstantData pushData{};
-        pushData.modelMatrix = obj.m_transform.mat4();
+        pushData.modelMatrix = obj.m_transform.mat4() * obj.m_model->getDequantizationMatrix();
         pushData.normalMatrix = obj.m_transform.normalMatrix();
 
         vkCmdPushConstants(
@@ -126,8 +374,136 @@ void VgeRenderSystem::renderGameObjects(FrameInfo& frameInfo)
             0,
             sizeof(SimplePushConstantData),
             &pushData);
-        obj.m_model->bind(frameInfo.commandBuffer);
-        obj.m_model->draw(frameInfo.commandBuffer);
+        if (obj.m_model.get() != boundModel) {
+            obj.m_model->bind(frameInfo.commandBuffer);
+            boundModel = obj.m_model.get();
+        }
+        if (m_meshletCulling == nullptr || !m_meshletCulling->drawMeshlets(frameInfo, i)) {
+            obj.m_model->draw(frameInfo.commandBuffer, 0, item.lod);
+        }
+    }
+}
+
+/* Makes sure the frame's object buffer can hold objectCount objects.
+ *
+ * The buffer grows by doubling. It is only replaced after the frame's fence
+ * has been waited on, and its storage buffer slot is only read by this
+ * frame, so the slot is rewritten in place.
+ */
+void VgeRenderSystem::reserveObjectBuffer(int frameIndex, uint32_t objectCount)
+{
+    std::unique_ptr<VgeBuffer>& objectBuffer = m_objectBuffers[frameIndex];
+    if (objectBuffer != nullptr && objectBuffer->getInstanceCount() >= objectCount) {
+        return;
+    }
+
+    uint32_t capacity = objectBuffer != nullptr ? objectBuffer->getInstanceCount() : 64;
+    while (capacity < objectCount) {
+        capacity *= 2;
+    }
+    objectBuffer = std::make_unique<VgeBuffer>(
+        m_vgeDevice,
+        sizeof(ObjectData),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    objectBuffer->map();
+
+    uint32_t& slot = m_objectBufferIndices[frameIndex];
+    if (slot == VgeBindlessDescriptors::INVALID_INDEX) {
+        slot = m_bindless->addStorageBuffer(objectBuffer->descriptorInfo());
+        if (slot == VgeBindlessDescriptors::INVALID_INDEX) {
+            throw std::runtime_error("Bindless storage buffer array is full!");
+        }
+    }
+    else {
+        m_bindless->updateStorageBuffer(slot, objectBuffer->descriptorInfo());
+    }
+}
+
+/* Renders game objects through the bindless descriptor set.
+ *
+ * Per-object transforms and texture slots are written to the frame's object
+ * buffer once, and both descriptor sets and the push constant are bound once
+ * for the whole pass, including the depth pre-pass. Each draw only selects
+ * its object through firstInstance, which the shaders see as
+ * gl_InstanceIndex.
+ */
+void VgeRenderSystem::renderGameObjectsBindless(FrameInfo& frameInfo)
+{
+    const std::vector<VgeRenderQueue::DrawItem>& drawItems = m_renderQueue.getItems();
+    std::vector<ObjectData> objects{};
+    objects.reserve(drawItems.size());
+    for (const VgeRenderQueue::DrawItem& item : drawItems) {
+        VgeGameObject& obj = *item.gameObject;
+        ObjectData data{};
+        data.modelMatrix = obj.m_transform.mat4() * obj.m_model->getDequantizationMatrix();
+        data.normalMatrix = obj.m_transform.normalMatrix();
+        data.textureIndex = obj.m_textureIndex;
+        objects.push_back(data);
+    }
+    if (objects.empty()) {
+        return;
+    }
+
+    reserveObjectBuffer(frameInfo.frameIndex, static_cast<uint32_t>(objects.size()));
+    VgeBuffer& objectBuffer = *m_objectBuffers[frameInfo.frameIndex];
+    objectBuffer.writeToBuffer(objects.data(), sizeof(ObjectData) * objects.size());
+    objectBuffer.flush();
+
+    std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.globalDescriptorSet,
+                                                   m_bindless->getDescriptorSet() };
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_pipelineLayout,
+        0,
+        static_cast<uint32_t>(descriptorSets.size()),
+        descriptorSets.data(),
+        0,
+        nullptr);
+
+    BindlessPushConstantData pushData{};
+    pushData.objectBufferIndex = m_objectBufferIndices[frameInfo.frameIndex];
+    vkCmdPushConstants(
+        frameInfo.commandBuffer,
+        m_pipelineLayout,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        0,
+        sizeof(BindlessPushConstantData),
+        &pushData);
+
+    if (m_depthPrepass) {
+        drawGameObjectsBindless(frameInfo, true);
+    }
+    drawGameObjectsBindless(frameInfo, false);
+}
+
+/* Draws the sorted render queue through the bindless object buffer.
+ *
+ * Draw i reads object i of the buffer through firstInstance, which culled
+ * meshlet draws carry as well. Pipelines are only rebound when the vertex
+ * format changes, vertex and index buffers when the model changes.
+ */
+void VgeRenderSystem::drawGameObjectsBindless(FrameInfo& frameInfo, bool depthOnly)
+{
+    const std::vector<VgeRenderQueue::DrawItem>& drawItems = m_renderQueue.getItems();
+    VgePipeline* boundPipeline = nullptr;
+    VgeModel* boundModel = nullptr;
+    for (uint32_t i = 0; i < drawItems.size(); i++) {
+        VgeModel* model = drawItems[i].gameObject->m_model.get();
+        VgePipeline& pipeline = getPipeline(depthOnly, model->getVertexFormat());
+        if (&pipeline != boundPipeline) {
+            pipeline.bind(frameInfo.commandBuffer);
+            boundPipeline = &pipeline;
+        }
+        if (model != boundModel) {
+            model->bind(frameInfo.commandBuffer);
+            boundModel = model;
+        }
+        if (m_meshletCulling == nullptr || !m_meshletCulling->drawMeshlets(frameInfo, i)) {
+            model->draw(frameInfo.commandBuffer, i, drawItems[i].lod);
+        }
     }
 }
 
@@ -1,12 +1,22 @@
 #pragma once
 
+#include "../vge_bindless_descriptors.hpp"
+#include "../vge_buffer.hpp"
 #include "../vge_device.hpp"
 #include "../vge_frame_info.hpp"
+#include "../vge_model.hpp"
 #include "../vge_pipeline.hpp"
+#include "../vge_render_queue.hpp"
+#include "vge_meshlet_culling_system.hpp"
+#include "vge_occlusion_culling_system.hpp"
 
 #include <vulkan/vulkan_core.h>
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace vge {
 
@@ -16,26 +26,94 @@ struct SimplePushConstantData
     glm::mat4 normalMatrix{ 1.f }; // identity matrix
 };
 
+// Per-object data read by the bindless shaders, indexed by gl_InstanceIndex (std430)
+struct ObjectData
+{
+    glm::mat4 modelMatrix{ 1.f };
+    glm::mat4 normalMatrix{ 1.f };
+    uint32_t textureIndex = VgeBindlessDescriptors::INVALID_INDEX;
+    uint32_t padding[3]{};
+};
+
+struct BindlessPushConstantData
+{
+    uint32_t objectBufferIndex = 0; // storage buffer slot holding this frame's ObjectData
+};
+
+// Shading features folded into shader.frag as specialization constants
+struct ShaderFeatures
+{
+    bool specular = true;           // Blinn-Phong specular term
+    float specularExponent = 512.f; // higher values -> sharper highlights
+    int lightCount = -1;            // < 0 reads the light count from the light buffer
+    bool clusteredLighting = true;  // only shade lights binned into the fragment's cluster
+};
+
 class VgeRenderSystem {
 public:
+    // constant_id values declared in shader.frag, the specular ones also in deferred_lighting.comp
+    static constexpr uint32_t SPECULAR_CONSTANT_ID = 0;
+    static constexpr uint32_t SPECULAR_EXPONENT_CONSTANT_ID = 1;
+    static constexpr uint32_t LIGHT_COUNT_CONSTANT_ID = 2;
+    static constexpr uint32_t CLUSTERED_SHADING_CONSTANT_ID = 3;
+    // constant_id declared in shader.vert
+    static constexpr uint32_t PACKED_VERTICES_CONSTANT_ID = 4;
+
     VgeRenderSystem(
         VgeDevice& device,
         VkRenderPass renderPass,
-        VkDescriptorSetLayout globalSetLayout);
+        VkDescriptorSetLayout globalSetLayout,
+        VgeBindlessDescriptors* bindless = nullptr);
     ~VgeRenderSystem();
 
     VgeRenderSystem(const VgeRenderSystem&) = delete;
     VgeRenderSystem& operator=(const VgeRenderSystem&) = delete;
 
+    void buildRenderQueue(FrameInfo& frameInfo);
     void renderGameObjects(FrameInfo& frameInfo);
+    void setShaderFeatures(const ShaderFeatures& features);
+    void setDepthPrepass(bool enabled);
+    void setOcclusionCulling(const VgeOcclusionCullingSystem* occlusionCulling);
+    void setMeshletCulling(const VgeMeshletCullingSystem* meshletCulling);
+
+    const VgeRenderQueue& getRenderQueue() const;
 
 private:
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-    void createPipeline(VkRenderPass renderPass);
+    void createDepthPrepassPipeline(VgeModel::VertexFormat vertexFormat);
+    VgePipeline& getPipelineVariant(
+        const ShaderFeatures& features,
+        VgeModel::VertexFormat vertexFormat);
+    VgePipeline& getPipeline(bool depthOnly, VgeModel::VertexFormat vertexFormat);
+    void drawGameObjects(FrameInfo& frameInfo, bool depthOnly);
+    void renderGameObjectsBindless(FrameInfo& frameInfo);
+    void drawGameObjectsBindless(FrameInfo& frameInfo, bool depthOnly);
+    void reserveObjectBuffer(int frameIndex, uint32_t objectCount);
 
     VgeDevice& m_vgeDevice; // use device for window
-    std::unique_ptr<VgePipeline> m_vgePipeline;
+    VkRenderPass m_renderPass;
+    // variants by variant key, the few whose keys collide share a bucket
+    std::unordered_map<uint64_t, std::vector<std::unique_ptr<VgePipeline>>> m_pipelineVariants;
+    // variants matching m_shaderFeatures per vertex format, null until first used
+    std::array<VgePipeline*, VgeModel::VERTEX_FORMAT_COUNT> m_vgePipelines;
+    ShaderFeatures m_shaderFeatures;
     VkPipelineLayout m_pipelineLayout;
+    VgeRenderQueue m_renderQueue; // rebuilt and sorted every frame
+
+    // depth-only pass that lets the shaded pass run with an EQUAL depth test
+    bool m_depthPrepass;
+    std::array<std::unique_ptr<VgePipeline>, VgeModel::VERTEX_FORMAT_COUNT>
+        m_depthPrepassPipelines;
+
+    // objects it reports as hidden are left out of the render queue, nullptr disables culling
+    const VgeOcclusionCullingSystem* m_occlusionCulling;
+    // draws the queue's culled meshlets where it has any, nullptr draws every model whole
+    const VgeMeshletCullingSystem* m_meshletCulling;
+
+    // bindless mode, object buffers are per frame in flight
+    VgeBindlessDescriptors* m_bindless;
+    std::vector<std::unique_ptr<VgeBuffer>> m_objectBuffers;
+    std::vector<uint32_t> m_objectBufferIndices;
 };
 
 } // namespace vge
@@ -1,40 +1,102 @@
 #include "vge_app.hpp"
+#include "systems/vge_deferred_render_system.hpp"
+#include "systems/vge_light_cluster_system.hpp"
+#include "systems/vge_meshlet_culling_system.hpp"
+#include "systems/vge_occlusion_culling_system.hpp"
 #include "systems/vge_point_light_system.hpp"
 #include "systems/vge_render_system.hpp"
 #include "vge_buffer.hpp"
 #include "vge_camera.hpp"
 #include "vge_descriptors.hpp"
+#include "vge_gpu_timer.hpp"
 #include "vge_keyboard_movement_controller.hpp"
+#include "vge_scene.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/ext/matrix_transform.hpp>
 #include <glm/glm.hpp>
-#include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <vulkan/vulkan_core.h>
 
 #include <cassert>
 #include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace vge {
+/* Builds the global descriptor set of one frame.
+ *
+ * Binding 0 is the frame's uniform buffer, binding 1 its point light buffer
+ * and binding 2 its light cluster buffer. The set comes from the descriptor
+ * set cache, so rebuilding with unchanged buffers returns the same set.
+ */
+static void buildGlobalDescriptorSet(
+    VgeDescriptorSetLayout& globalSetLayout,
+    VgeDescriptorSetCache& descriptorSetCache,
+    VkDescriptorBufferInfo uboInfo,
+    VkDescriptorBufferInfo lightBufferInfo,
+    VkDescriptorBufferInfo clusterBufferInfo,
+    VkDescriptorSet& globalDescriptorSet)
+{
+    VgeDescriptorWriter(globalSetLayout)
+        .writeBuffer(0, &uboInfo)
+        .writeBuffer(1, &lightBufferInfo)
+        .writeBuffer(2, &clusterBufferInfo)
+        .build(globalDescriptorSet, descriptorSetCache);
+}
+
 /* Constructs a VgeApp object.
  *
- * Initializes the application by setting up the global descriptor pool
- * and loading game objects into the scene.
+ * Initializes the application by setting up the descriptor layout and set
+ * caches, the per-frame descriptor allocator, the bindless descriptors when
+ * the device supports descriptor indexing, and loading game objects into
+ * the scene.
  */
 VgeApp::VgeApp()
     : m_vgeWindow{ WIDTH, HEIGHT, "Hello Vulkan!" }
     , m_vgeDevice{ m_vgeWindow }
     , m_vgeRenderer{ m_vgeWindow, m_vgeDevice }
-    , m_globalPool{}
+    , m_layoutCache{}
+    , m_descriptorSetCache{}
+    , m_frameAllocator{}
+    , m_bindless{}
+    , m_samplerCache{ m_vgeDevice }
+    , m_textures{}
+    , m_threadPool{}
+    , m_assetManager{ m_vgeDevice }
     , m_gameObjects{}
+    , m_lightStore{}
 {
-    m_globalPool =
-        VgeDescriptorPool::Builder(m_vgeDevice)
-            .setMaxSets(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
-            .build();
+    m_layoutCache = std::make_unique<VgeDescriptorLayoutCache>(m_vgeDevice);
+
+    // long lived sets, shared by every request for the same layout and resources
+    m_descriptorSetCache = std::make_unique<VgeDescriptorSetCache>(
+        VgeDescriptorAllocator::Builder(m_vgeDevice)
+            .setSetsPerPool(VgeSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f)
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f) // lights and clusters
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f));
+
+    // transient per-material/per-draw sets, reset wholesale each frame
+    m_frameAllocator = std::make_unique<VgeFrameDescriptorAllocator>(
+        VgeDescriptorAllocator::Builder(m_vgeDevice)
+            .setSetsPerPool(128)
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f)
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f) // meshlets and draws
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f)
+            .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f), // deferred lighting target
+        VgeSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    if (m_vgeDevice.supportsDescriptorIndexing()) {
+        m_bindless = std::make_unique<VgeBindlessDescriptors>(
+            m_vgeDevice,
+            VgeSwapChain::MAX_FRAMES_IN_FLIGHT);
+    }
+
     loadGameObjects();
 }
 
@@ -63,29 +125,63 @@ void VgeApp::run()
         uboBuffers[i]->map();
     }
 
-    std::unique_ptr<VgeDescriptorSetLayout> globalSetLayout =
+    // the light culling compute pass reads the same set as the graphics passes
+    VkShaderStageFlags globalStages = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+    VgeDescriptorSetLayout& globalSetLayout =
         VgeDescriptorSetLayout::Builder(m_vgeDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-            .build();
-
-    std::vector<VkDescriptorSet> globalDescriptorSets(VgeSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (size_t i = 0; i < globalDescriptorSets.size(); i++) {
-        VkDescriptorBufferInfo bufferInfo = uboBuffers[i]->descriptorInfo();
-        VgeDescriptorWriter(*globalSetLayout, *m_globalPool)
-            .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets[i]);
-    }
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, globalStages)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, globalStages)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, globalStages)
+            .build(*m_layoutCache);
 
     VgeRenderSystem renderSystem{
         m_vgeDevice,
         m_vgeRenderer.getSwapChainRenderPass(),
-        globalSetLayout->getDescriptorSetLayout(),
+        globalSetLayout.getDescriptorSetLayout(),
+        m_bindless.get(),
     };
     VgePointLightSystem pointLightSystem{
         m_vgeDevice,
         m_vgeRenderer.getSwapChainRenderPass(),
-        globalSetLayout->getDescriptorSetLayout(),
+        globalSetLayout.getDescriptorSetLayout(),
+        m_threadPool,
+    };
+    VgeLightClusterSystem lightClusterSystem{
+        m_vgeDevice,
+        globalSetLayout.getDescriptorSetLayout(),
+    };
+    VgeDeferredRenderSystem deferredRenderSystem{
+        m_vgeDevice,
+        m_vgeRenderer.getSwapChainRenderPass(),
+        globalSetLayout.getDescriptorSetLayout(),
+        *m_layoutCache,
     };
+    VgeOcclusionCullingSystem occlusionCullingSystem{ m_vgeDevice, *m_layoutCache };
+    // the forward pipelines draw both faces, so meshlets are not backface culled
+    VgeMeshletCullingSystem meshletCullingSystem{
+        m_vgeDevice,
+        globalSetLayout.getDescriptorSetLayout(),
+        *m_layoutCache,
+        false,
+    };
+
+    std::vector<VkDescriptorSet> globalDescriptorSets(VgeSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < globalDescriptorSets.size(); i++) {
+        int frameIndex = static_cast<int>(i);
+        buildGlobalDescriptorSet(
+            globalSetLayout,
+            *m_descriptorSetCache,
+            uboBuffers[i]->descriptorInfo(),
+            pointLightSystem.getLightBufferInfo(frameIndex),
+            lightClusterSystem.getClusterBufferInfo(frameIndex),
+            globalDescriptorSets[i]);
+    }
+
+    // the scene's light count is fixed, so fold it into the unclustered shader variant
+    ShaderFeatures shaderFeatures{};
+    shaderFeatures.lightCount = static_cast<int>(m_lightStore.size());
+    renderSystem.setShaderFeatures(shaderFeatures);
+    deferredRenderSystem.setShaderFeatures(shaderFeatures);
 
     VgeCamera camera{};
     camera.setViewTargetDirectionMatrix(glm::vec3(-1.f, -2.f, 2.f), glm::vec3(0.f, 0.f, 2.5f));
@@ -93,6 +189,15 @@ void VgeApp::run()
     VgeGameObject viewerObject = VgeGameObject::createGameObject();
     viewerObject.m_transform.translation.z = -2.5f;
     VgeKeyboardMovementController cameraController{};
+    RenderSettings renderSettings{};
+
+    // forward opaque pass GPU time, averaged and logged to compare depth pre-pass on and off
+    VgeGpuTimer gpuTimer{ m_vgeDevice, VgeSwapChain::MAX_FRAMES_IN_FLIGHT };
+    constexpr uint32_t opaqueTimerScope = 0;
+    float opaqueMilliseconds = 0.f;
+    int opaqueSamples = 0;
+    float opaqueReportTime = 0.f;
+    bool opaqueTimedDepthPrepass = renderSettings.depthPrepass;
 
     std::chrono::time_point currentTime = std::chrono::high_resolution_clock::now();
 
@@ -107,6 +212,15 @@ void VgeApp::run()
         currentTime = newTime;
 
         cameraController.moveInPlaneXZ(m_vgeWindow.getGLFWwindow(), frameTime, viewerObject);
+        cameraController.updateRenderSettings(m_vgeWindow.getGLFWwindow(), renderSettings);
+        if (renderSettings.depthPrepass != opaqueTimedDepthPrepass) {
+            // start a fresh average for the new mode
+            renderSystem.setDepthPrepass(renderSettings.depthPrepass);
+            opaqueTimedDepthPrepass = renderSettings.depthPrepass;
+            opaqueMilliseconds = 0.f;
+            opaqueSamples = 0;
+            opaqueReportTime = 0.f;
+        }
         camera.setViewYXZMatrix(
             viewerObject.m_transform.translation,
             viewerObject.m_transform.rotation);
@@ -117,9 +231,24 @@ void VgeApp::run()
         // beginFrame returns nullptr if swapchain needs to be recreated
         if (VkCommandBuffer commandBuffer = m_vgeRenderer.beginFrame()) {
             int frameIndex = m_vgeRenderer.getFrameIndex();
+            // the frame's fence has been waited on, so its transient sets can be recycled
+            VgeDescriptorAllocator& frameAllocator = m_frameAllocator->beginFrame(frameIndex);
+            if (m_bindless != nullptr) {
+                m_bindless->beginFrame(frameIndex);
+            }
+            // models whose upload has completed are drawn from this frame on
+            m_assetManager.update(commandBuffer, m_gameObjects);
+            gpuTimer.beginFrame(commandBuffer, frameIndex);
+            occlusionCullingSystem.beginFrame(frameIndex);
             FrameInfo frameInfo{
-                frameIndex,    frameTime, commandBuffer, camera, globalDescriptorSets[frameIndex],
+                frameIndex,
+                frameTime,
+                commandBuffer,
+                camera,
+                globalDescriptorSets[frameIndex],
                 m_gameObjects,
+                m_lightStore,
+                frameAllocator,
             };
 
             // update
@@ -127,15 +256,73 @@ void VgeApp::run()
             ubo.projection = camera.getProjectionMatrix();
             ubo.view = camera.getViewMatrix();
             ubo.inverseView = camera.getInverseViewMatrix();
-            pointLightSystem.update(frameInfo, ubo);
+            VkExtent2D extent = m_vgeRenderer.getSwapChainExtent();
+            ubo.screenExtent = glm::vec2(extent.width, extent.height);
+            ubo.zNear = camera.getNear();
+            ubo.zFar = camera.getFar();
+            VkBuffer lightBuffer = pointLightSystem.getLightBufferInfo(frameIndex).buffer;
+            if (pointLightSystem.update(frameInfo)) {
+                // the light buffer grew, point the frame's global set at the new one. The old
+                // buffer's sets go first, its handle may come back for the new buffer
+                m_descriptorSetCache->invalidateBuffer(lightBuffer);
+                buildGlobalDescriptorSet(
+                    globalSetLayout,
+                    *m_descriptorSetCache,
+                    uboBuffers[frameIndex]->descriptorInfo(),
+                    pointLightSystem.getLightBufferInfo(frameIndex),
+                    lightClusterSystem.getClusterBufferInfo(frameIndex),
+                    globalDescriptorSets[frameIndex]);
+                frameInfo.globalDescriptorSet = globalDescriptorSets[frameIndex];
+            }
             uboBuffers[frameIndex]->writeToBuffer(&ubo);
             uboBuffers[frameIndex]->flush();
 
             // render
-            m_vgeRenderer.beginSwapChainRenderPass(commandBuffer);
-            renderSystem.renderGameObjects(frameInfo);
+            if (renderSettings.deferredShading) {
+                // the tiled lighting pass culls its own lights, no clusters needed
+                deferredRenderSystem.renderGeometry(frameInfo, extent);
+                deferredRenderSystem.computeLighting(frameInfo);
+                m_vgeRenderer.beginSwapChainRenderPass(commandBuffer);
+                deferredRenderSystem.composite(frameInfo);
+            }
+            else {
+                // bin lights into clusters before the render pass that shades with them
+                lightClusterSystem.cullLights(frameInfo);
+                renderSystem.setOcclusionCulling(
+                    renderSettings.occlusionCulling ? &occlusionCullingSystem : nullptr);
+                renderSystem.buildRenderQueue(frameInfo);
+                if (renderSettings.meshletCulling) {
+                    meshletCullingSystem.cullMeshlets(frameInfo, renderSystem.getRenderQueue());
+                }
+                renderSystem.setMeshletCulling(
+                    renderSettings.meshletCulling ? &meshletCullingSystem : nullptr);
+                m_vgeRenderer.beginSwapChainRenderPass(commandBuffer);
+                gpuTimer.beginScope(commandBuffer, opaqueTimerScope);
+                renderSystem.renderGameObjects(frameInfo);
+                gpuTimer.endScope(commandBuffer, opaqueTimerScope);
+
+                opaqueMilliseconds += gpuTimer.getScopeMilliseconds(opaqueTimerScope);
+                opaqueSamples++;
+                opaqueReportTime += frameTime;
+                if (gpuTimer.isSupported() && opaqueReportTime >= 2.f) {
+                    std::cout << "opaque pass: " << opaqueMilliseconds / opaqueSamples
+                              << " ms (depth pre-pass "
+                              << (renderSettings.depthPrepass ? "on" : "off") << ")"
+                              << std::endl;
+                    opaqueMilliseconds = 0.f;
+                    opaqueSamples = 0;
+                    opaqueReportTime = 0.f;
+                }
+            }
             pointLightSystem.render(frameInfo);
             m_vgeRenderer.endSwapChainRenderPass(commandBuffer);
+            if (renderSettings.occlusionCulling && !renderSettings.deferredShading) {
+                // culls the objects of a later frame, see VgeOcclusionCullingSystem::beginFrame
+                occlusionCullingSystem.buildDepthPyramid(
+                    frameInfo,
+                    m_vgeRenderer.getCurrentDepthImageView(),
+                    extent);
+            }
             m_vgeRenderer.endFrame();
         }
     }
@@ -145,53 +332,71 @@ void VgeApp::run()
 
 /* Loads game objects into the application.
  *
- * Creates models from files, sets their transformations, and stores
- * them in the game object container for rendering.
+ * Maps the scene file and builds the game objects and point lights
+ * straight from its arrays. Every model the scene references is queued
+ * once for streaming, its entities share the asset and are drawn once it
+ * is resident. Textures are uploaded right away and registered with the
+ * bindless set, only the bindless shaders sample them, so they are skipped
+ * without descriptor indexing.
  */
 void VgeApp::loadGameObjects()
 {
-    std::shared_ptr<VgeModel> vgeModel =
-        VgeModel::createModelFromFile(m_vgeDevice, "models/flat_vase.obj");
-    VgeGameObject flatVase = VgeGameObject::createGameObject();
-    flatVase.m_model = vgeModel;
-    flatVase.m_transform.translation = { -.5f, .5f, 0.f };
-    flatVase.m_transform.scale = { 3.f, 1.5f, 3.f };
-    m_gameObjects.emplace(flatVase.getId(), std::move(flatVase));
-
-    vgeModel = VgeModel::createModelFromFile(m_vgeDevice, "models/smooth_vase.obj");
-    VgeGameObject smoothVase = VgeGameObject::createGameObject();
-    smoothVase.m_model = vgeModel;
-    smoothVase.m_transform.translation = { .5f, .5f, 0.f };
-    smoothVase.m_transform.scale = { 3.f, 1.5f, 3.f };
-    m_gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
-
-    vgeModel = VgeModel::createModelFromFile(m_vgeDevice, "models/quad.obj");
-    VgeGameObject floor = VgeGameObject::createGameObject();
-    floor.m_model = vgeModel;
-    floor.m_transform.translation = { 0.f, .5f, 0.f };
-    floor.m_transform.scale = { 3.f, 1.f, 3.f };
-    m_gameObjects.emplace(floor.getId(), std::move(floor));
-
-    std::vector<glm::vec3> lightColors{
-        { 1.f, .1f, .1f },
-        { .1f, .1f, 1.f },
-        { .1f, 1.f, .1f },
-        { 1.f, 1.f, .1f },
-        { .1f, 1.f, 1.f },
-        { 1.f, 1.f, 1.f }  //
-    };
+    VgeScene scene{ "scenes/default.vgescene" };
+
+    std::vector<std::shared_ptr<VgeModelAsset>> modelAssets(scene.getModelCount());
+    const VgeScene::Model* models = scene.getModels();
+    for (uint32_t i = 0; i < scene.getModelCount(); i++) {
+        if (models[i].vertexFormat >= VgeModel::VERTEX_FORMAT_COUNT) {
+            throw std::runtime_error("Scene model has an unknown vertex format!");
+        }
+        modelAssets[i] = m_assetManager.loadModel(
+            std::string{ scene.getModelPath(models[i]) },
+            static_cast<VgeModel::VertexFormat>(models[i].vertexFormat));
+    }
+
+    std::vector<uint32_t> textureIndices(
+        scene.getTextureCount(),
+        VgeBindlessDescriptors::INVALID_INDEX);
+    const VgeScene::Texture* textures = scene.getTextures();
+    for (uint32_t i = 0; i < scene.getTextureCount() && m_bindless != nullptr; i++) {
+        m_textures.push_back(VgeTexture::createTextureFromFile(
+            m_vgeDevice,
+            std::string{ scene.getTexturePath(textures[i]) }));
+        // trilinear with anisotropy, the default sampler state
+        textureIndices[i] = m_bindless->addSampledImage(
+            m_textures.back()->getImageView(),
+            m_samplerCache.getSampler(),
+            m_textures.back()->getImageLayout());
+    }
+
+    const VgeScene::Entity* entities = scene.getEntities();
+    m_gameObjects.reserve(m_gameObjects.size() + scene.getEntityCount());
+    for (uint32_t i = 0; i < scene.getEntityCount(); i++) {
+        const VgeScene::Entity& entity = entities[i];
+        VgeGameObject obj = VgeGameObject::createGameObject();
+        obj.m_transform.translation = glm::make_vec3(entity.translation);
+        obj.m_transform.rotation = glm::make_vec3(entity.rotation);
+        obj.m_transform.scale = glm::make_vec3(entity.scale);
+        if (entity.modelIndex != VgeScene::NO_MODEL) {
+            m_assetManager.attachModel(obj, modelAssets[entity.modelIndex]);
+        }
+        if (entity.textureIndex != VgeScene::NO_TEXTURE) {
+            obj.m_textureIndex = textureIndices[entity.textureIndex];
+        }
+        m_gameObjects.emplace(obj.getId(), std::move(obj));
+    }
 
-    for (size_t i = 0; i < lightColors.size(); i++) {
-        VgeGameObject pointLight = VgeGameObject::makePointLight(0.2f);
-        pointLight.m_color = lightColors[i];
-        glm::mat<4, 4, float, (glm::qualifier)0U> rotateLight = glm::rotate(
-            glm::mat4(1.f),
-            (i * glm::two_pi<float>()) / lightColors.size(),
-            { 0.f, -1.f, 0.f });
-        pointLight.m_transform.translation =
-            glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
-        m_gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+    const VgeScene::Light* lights = scene.getLights();
+    for (uint32_t i = 0; i < scene.getLightCount(); i++) {
+        m_lightStore.addLight(
+            glm::make_vec3(lights[i].position),
+            glm::make_vec3(lights[i].color),
+            lights[i].intensity,
+            lights[i].radius);
     }
+    std::cout << "scenes/default.vgescene: " << scene.getEntityCount() << " entities, "
+              << scene.getModelCount() << " models, " << scene.getTextureCount() << " textures, "
+              << scene.getLightCount() << " lights" << std::endl;
 }
 
 } // namespace vge
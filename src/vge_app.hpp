@@ -1,15 +1,22 @@
 #pragma once
 
+#include "vge_asset_manager.hpp"
+#include "vge_bindless_descriptors.hpp"
 #include "vge_descriptors.hpp"
 #include "vge_device.hpp"
 #include "vge_game_object.hpp"
+#include "vge_light_store.hpp"
 #include "vge_renderer.hpp"
+#include "vge_sampler_cache.hpp"
+#include "vge_texture.hpp"
+#include "vge_thread_pool.hpp"
 #include "vge_window.hpp"
 
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan_core.h>
 
 #include <memory>
+#include <vector>
 
 namespace vge {
 
@@ -34,8 +41,16 @@ private:
     VgeRenderer m_vgeRenderer;
 
     // note: order of declarations matters
-    std::unique_ptr<VgeDescriptorPool> m_globalPool;
+    std::unique_ptr<VgeDescriptorLayoutCache> m_layoutCache;
+    std::unique_ptr<VgeDescriptorSetCache> m_descriptorSetCache;
+    std::unique_ptr<VgeFrameDescriptorAllocator> m_frameAllocator;
+    std::unique_ptr<VgeBindlessDescriptors> m_bindless; // null without descriptor indexing
+    VgeSamplerCache m_samplerCache;
+    std::vector<std::unique_ptr<VgeTexture>> m_textures; // sampled through m_bindless
+    VgeThreadPool m_threadPool;
+    VgeAssetManager m_assetManager; // streams models into m_gameObjects
     VgeGameObject::Map m_gameObjects;
+    VgeLightStore m_lightStore;
 };
 
 } // namespace vge
@@ -0,0 +1,588 @@
+#include "vge_asset_manager.hpp"
+#include "vge_swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_set>
+
+namespace vge {
+
+/* Hashes a file's content together with the vertex format it is loaded as.
+ *
+ * 64-bit FNV-1a over the raw bytes, read in chunks. Files with equal
+ * hashes only may hold the same model, isSameFileContent decides.
+ */
+static uint64_t hashModelFile(const std::string& filepath, VgeModel::VertexFormat vertexFormat)
+{
+    constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    std::ifstream file{ filepath, std::ios::binary };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filepath);
+    }
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    std::vector<char> chunk(64 * 1024);
+    while (file) {
+        file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        std::streamsize readCount = file.gcount();
+        for (std::streamsize i = 0; i < readCount; i++) {
+            hash ^= static_cast<unsigned char>(chunk[i]);
+            hash *= FNV_PRIME;
+        }
+    }
+    hash ^= static_cast<uint64_t>(vertexFormat);
+    hash *= FNV_PRIME;
+    return hash;
+}
+
+/* Compares the content of two files.
+ *
+ * Sizes are compared first, then the bytes chunk by chunk. Files that
+ * can't be read are never the same.
+ */
+static bool isSameFileContent(const std::string& filepath, const std::string& otherFilepath)
+{
+    std::error_code error{};
+    std::uintmax_t size = std::filesystem::file_size(filepath, error);
+    if (error || std::filesystem::file_size(otherFilepath, error) != size || error) {
+        return false;
+    }
+
+    std::ifstream file{ filepath, std::ios::binary };
+    std::ifstream otherFile{ otherFilepath, std::ios::binary };
+    if (!file.is_open() || !otherFile.is_open()) {
+        return false;
+    }
+
+    std::vector<char> chunk(64 * 1024);
+    std::vector<char> otherChunk(chunk.size());
+    while (file && otherFile) {
+        file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        otherFile.read(otherChunk.data(), static_cast<std::streamsize>(otherChunk.size()));
+        std::streamsize readCount = file.gcount();
+        if (otherFile.gcount() != readCount ||
+            std::memcmp(chunk.data(), otherChunk.data(), static_cast<size_t>(readCount)) != 0)
+        {
+            return false;
+        }
+    }
+    return !file.bad() && !otherFile.bad();
+}
+
+/* Constructs a VgeAssetManager object.
+ *
+ * Creates the command pool for transfer submissions and starts the worker
+ * threads, which sleep until a model is queued.
+ */
+VgeAssetManager::VgeAssetManager(VgeDevice& device)
+    : m_vgeDevice{ device }
+    , m_graphicsFamily{ 0 }
+    , m_transferFamily{ 0 }
+    , m_commandPool{}
+    , m_batches{}
+    , m_duplicates{}
+    , m_residentAssets{}
+    , m_cache{}
+    , m_retiredModels{}
+    , m_memoryBudget{ DEFAULT_MEMORY_BUDGET }
+    , m_frame{ 0 }
+    , m_workers{}
+    , m_mutex{}
+    , m_workAvailable{}
+    , m_queued{}
+    , m_loaded{}
+    , m_contentAssets{}
+    , m_stopping{ false }
+{
+    QueueFamilyIndices queueFamilies = m_vgeDevice.findPhysicalQueueFamilies();
+    m_graphicsFamily = queueFamilies.graphicsFamily;
+    m_transferFamily = queueFamilies.transferFamily;
+    createCommandPool();
+
+    m_workers.reserve(WORKER_COUNT);
+    for (unsigned int i = 0; i < WORKER_COUNT; i++) {
+        m_workers.emplace_back(&VgeAssetManager::workerLoop, this);
+    }
+}
+
+/* Destroys the VgeAssetManager object.
+ *
+ * Joins the workers, each finishing the import it is working on, then
+ * waits for the submitted uploads before freeing their resources. Imports
+ * that were never submitted are dropped.
+ */
+VgeAssetManager::~VgeAssetManager()
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+
+    for (TransferBatch& batch : m_batches) {
+        vkWaitForFences(m_vgeDevice.getDevice(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        destroyBatch(batch);
+    }
+    vkDestroyCommandPool(m_vgeDevice.getDevice(), m_commandPool, nullptr);
+}
+
+/* Creates the command pool of the transfer queue family.
+ *
+ * Every command buffer is recorded once and freed after its fence
+ * signals, so the pool is transient.
+ */
+void VgeAssetManager::createCommandPool()
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_transferFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    if (vkCreateCommandPool(m_vgeDevice.getDevice(), &poolInfo, nullptr, &m_commandPool) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create transfer command pool!");
+    }
+}
+
+/* Queues a model file for loading, called on the main thread.
+ *
+ * Returns right away with the model's asset. A file already requested in
+ * the same vertex format returns the cached asset, whether it is resident
+ * or still loading. Otherwise a worker imports the file and fills its
+ * buffers, and the next update calls submit the upload and hand the model
+ * to the asset once the upload has completed.
+ */
+std::shared_ptr<VgeModelAsset> VgeAssetManager::loadModel(
+    const std::string& filepath,
+    VgeModel::VertexFormat vertexFormat)
+{
+    // different spellings of one path share an entry, the path is used as is if it can't be
+    // resolved and the worker reports the failure
+    std::error_code error{};
+    std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(filepath, error);
+    std::string key = (error ? filepath : canonicalPath.string()) + '#' +
+                      std::to_string(static_cast<int>(vertexFormat));
+
+    std::unordered_map<std::string, CacheEntry>::iterator it = m_cache.find(key);
+    if (it != m_cache.end()) {
+        it->second.lastRequestFrame = m_frame;
+        return it->second.asset;
+    }
+
+    std::shared_ptr<VgeModelAsset> asset = std::make_shared<VgeModelAsset>();
+    asset->filepath = filepath;
+    asset->vertexFormat = vertexFormat;
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_queued.push_back(asset);
+    }
+    m_workAvailable.notify_one();
+    m_cache.emplace(key, CacheEntry{ asset, m_frame });
+    return asset;
+}
+
+/* Gives a game object a streamed model, called on the main thread.
+ *
+ * The object gets the model right away when the asset is resident.
+ * Otherwise it is remembered by the asset, and the update that makes the
+ * asset resident hands it the model.
+ */
+void VgeAssetManager::attachModel(
+    VgeGameObject& gameObject,
+    const std::shared_ptr<VgeModelAsset>& asset)
+{
+    gameObject.m_modelAsset = asset;
+    gameObject.m_model = asset->model;
+    if (gameObject.m_model == nullptr) {
+        asset->waitingObjects.push_back(gameObject.getId());
+    }
+}
+
+// Sets the memory the cached models may take before unused ones are evicted.
+void VgeAssetManager::setMemoryBudget(VkDeviceSize memoryBudget)
+{
+    m_memoryBudget = memoryBudget;
+}
+
+/* Get the device memory taken by the resident models of the cache.
+ *
+ * A model shared by several assets is counted once.
+ */
+VkDeviceSize VgeAssetManager::getCachedMemorySize() const
+{
+    VkDeviceSize size = 0;
+    std::unordered_set<const VgeModel*> counted{};
+    for (const std::pair<const std::string, CacheEntry>& kv : m_cache) {
+        const std::shared_ptr<VgeModel>& model = kv.second.asset->model;
+        if (model != nullptr && counted.insert(model.get()).second) {
+            size += model->getMemorySize();
+        }
+    }
+    return size;
+}
+
+/* Advances the uploads, called once per frame on the main thread.
+ *
+ * Retires the completed uploads, recording the ownership transfers they
+ * need into the frame's command buffer, which must not have started any
+ * render pass yet. Then submits the imports the workers have finished,
+ * resolves duplicates whose source is resident, evicts unused models over
+ * the budget, and gives the game objects waiting for an asset made
+ * resident by this update its model. Only those objects are visited.
+ */
+void VgeAssetManager::update(VkCommandBuffer commandBuffer, VgeGameObject::Map& gameObjects)
+{
+    // the frame fences waited on since a model was evicted cover every draw that used it
+    while (!m_retiredModels.empty() &&
+           m_retiredModels.front().frame + VgeSwapChain::MAX_FRAMES_IN_FLIGHT <= m_frame)
+    {
+        m_retiredModels.pop_front();
+    }
+
+    retireBatches(commandBuffer);
+
+    std::vector<ModelLoad> loaded{};
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        loaded.swap(m_loaded);
+    }
+    std::vector<ModelLoad> loads{};
+    for (ModelLoad& load : loaded) {
+        if (load.source != nullptr) {
+            m_duplicates.push_back(std::move(load));
+        }
+        else {
+            loads.push_back(std::move(load));
+        }
+    }
+    if (!loads.empty()) {
+        submitLoads(loads);
+    }
+    resolveDuplicates();
+    evictUnused();
+
+    for (const std::shared_ptr<VgeModelAsset>& asset : m_residentAssets) {
+        for (VgeGameObject::id_t id : asset->waitingObjects) {
+            // the object may have been removed or given another asset since
+            VgeGameObject::Map::iterator it = gameObjects.find(id);
+            if (it != gameObjects.end() && it->second.m_modelAsset == asset) {
+                it->second.m_model = asset->model;
+            }
+        }
+        asset->waitingObjects.clear();
+    }
+    m_residentAssets.clear();
+    m_frame++;
+}
+
+/* Hands the duplicate loads the model of their source once it is resident.
+ *
+ * A duplicate of a failed load fails as well.
+ */
+void VgeAssetManager::resolveDuplicates()
+{
+    std::vector<ModelLoad> waiting{};
+    for (ModelLoad& load : m_duplicates) {
+        if (load.source->model != nullptr) {
+            load.asset->model = load.source->model;
+            m_residentAssets.push_back(load.asset);
+            std::cout << load.asset->filepath << ": resident, same content as "
+                      << load.source->filepath << std::endl;
+        }
+        else if (load.source->failed) {
+            load.asset->failed = true;
+            load.asset->waitingObjects.clear();
+        }
+        else {
+            waiting.push_back(std::move(load));
+        }
+    }
+    m_duplicates = std::move(waiting);
+}
+
+/* Evicts cached assets while the cached models exceed the memory budget.
+ *
+ * Only assets referenced by nothing but the cache are evicted, least
+ * recently requested first, and never while they are loading. A model
+ * shared with another asset or still held elsewhere frees no memory until
+ * its last reference goes. Evicted models are kept alive until the frames
+ * in flight are done with them.
+ *
+ * Holds m_mutex throughout, workers only take a reference to an asset
+ * through m_contentAssets under it, so an asset found unused stays unused.
+ * Its content entry is erased with it, later loads of the same content
+ * import it again.
+ */
+void VgeAssetManager::evictUnused()
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    VkDeviceSize cachedSize = getCachedMemorySize();
+    while (cachedSize > m_memoryBudget) {
+        std::unordered_map<std::string, CacheEntry>::iterator victim = m_cache.end();
+        for (std::unordered_map<std::string, CacheEntry>::iterator it = m_cache.begin();
+             it != m_cache.end();
+             it++)
+        {
+            const VgeModelAsset& asset = *it->second.asset;
+            bool unused = it->second.asset.use_count() == 1 &&
+                          (asset.model != nullptr || asset.failed);
+            if (unused && (victim == m_cache.end() ||
+                           it->second.lastRequestFrame < victim->second.lastRequestFrame))
+            {
+                victim = it;
+            }
+        }
+        if (victim == m_cache.end()) {
+            break;
+        }
+
+        std::shared_ptr<VgeModel>& model = victim->second.asset->model;
+        if (model != nullptr) {
+            if (model.use_count() == 1) {
+                cachedSize -= model->getMemorySize();
+            }
+            m_retiredModels.push_back(RetiredModel{ std::move(model), m_frame });
+        }
+        std::unordered_map<uint64_t, std::weak_ptr<VgeModelAsset>>::iterator content =
+            m_contentAssets.find(victim->second.asset->contentHash);
+        if (content != m_contentAssets.end() && content->second.lock() == victim->second.asset) {
+            m_contentAssets.erase(content);
+        }
+        std::cout << victim->second.asset->filepath << ": evicted" << std::endl;
+        m_cache.erase(victim);
+    }
+}
+
+/* Records and submits the buffer copies of finished imports.
+ *
+ * All copies go into one command buffer on the transfer queue, signaling
+ * a fence of their own. When the transfer queue is of another family the
+ * buffers are released to the graphics family at the end.
+ */
+void VgeAssetManager::submitLoads(std::vector<ModelLoad>& loads)
+{
+    TransferBatch batch{};
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(m_vgeDevice.getDevice(), &allocInfo, &batch.commandBuffer) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to allocate transfer command buffer!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+    std::vector<VkBufferMemoryBarrier> releaseBarriers{};
+    for (const ModelLoad& load : loads) {
+        for (const VgeModel::BufferUpload& upload : load.uploads) {
+            VkBufferCopy copyRegion{};
+            copyRegion.size = upload.size;
+            vkCmdCopyBuffer(
+                batch.commandBuffer,
+                upload.stagingBuffer->getBuffer(),
+                upload.buffer,
+                1,
+                &copyRegion);
+
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            barrier.buffer = upload.buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            releaseBarriers.push_back(barrier);
+        }
+    }
+    if (m_transferFamily != m_graphicsFamily && !releaseBarriers.empty()) {
+        vkCmdPipelineBarrier(
+            batch.commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0,
+            nullptr,
+            static_cast<uint32_t>(releaseBarriers.size()),
+            releaseBarriers.data(),
+            0,
+            nullptr);
+    }
+    vkEndCommandBuffer(batch.commandBuffer);
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(m_vgeDevice.getDevice(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create transfer fence!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    if (vkQueueSubmit(m_vgeDevice.getTransferQueue(), 1, &submitInfo, batch.fence) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to submit transfer command buffer!");
+    }
+
+    batch.loads = std::move(loads);
+    m_batches.push_back(std::move(batch));
+}
+
+/* Retires the submitted uploads whose fence has signaled.
+ *
+ * Their buffers are acquired by the graphics family in commandBuffer when
+ * they were released by another family. Within one family the fence
+ * already orders the copies before anything submitted after this check.
+ * The staging buffers are freed and the models handed to their assets.
+ */
+void VgeAssetManager::retireBatches(VkCommandBuffer commandBuffer)
+{
+    std::vector<VkBufferMemoryBarrier> acquireBarriers{};
+    std::vector<TransferBatch> pending{};
+    for (TransferBatch& batch : m_batches) {
+        if (vkGetFenceStatus(m_vgeDevice.getDevice(), batch.fence) != VK_SUCCESS) {
+            pending.push_back(std::move(batch));
+            continue;
+        }
+
+        for (ModelLoad& load : batch.loads) {
+            for (const VgeModel::BufferUpload& upload : load.uploads) {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                        VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+                barrier.srcQueueFamilyIndex = m_transferFamily;
+                barrier.dstQueueFamilyIndex = m_graphicsFamily;
+                barrier.buffer = upload.buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                acquireBarriers.push_back(barrier);
+            }
+            load.asset->model = load.model;
+            m_residentAssets.push_back(load.asset);
+            std::cout << load.asset->filepath << ": resident" << std::endl;
+        }
+        destroyBatch(batch);
+    }
+    m_batches = std::move(pending);
+
+    if (m_transferFamily != m_graphicsFamily && !acquireBarriers.empty()) {
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0,
+            nullptr,
+            static_cast<uint32_t>(acquireBarriers.size()),
+            acquireBarriers.data(),
+            0,
+            nullptr);
+    }
+}
+
+/* Frees the command buffer, fence and staging buffers of a batch.
+ *
+ * The batch's fence must have signaled.
+ */
+void VgeAssetManager::destroyBatch(TransferBatch& batch)
+{
+    vkDestroyFence(m_vgeDevice.getDevice(), batch.fence, nullptr);
+    vkFreeCommandBuffers(m_vgeDevice.getDevice(), m_commandPool, 1, &batch.commandBuffer);
+    batch.loads.clear();
+}
+
+/* Main loop of a worker thread.
+ *
+ * Takes queued assets one at a time and hashes their file. A file whose
+ * content was already imported in the same vertex format becomes a
+ * duplicate of that asset, once a byte compare rules out a hash
+ * collision. Others are imported: the file is parsed, its
+ * vertices welded, LODs and meshlets built, then the model's buffers are
+ * created and their staging buffers filled. The copies are left to the
+ * main thread. Failed imports are reported and flagged on the asset.
+ */
+void VgeAssetManager::workerLoop()
+{
+    while (true) {
+        std::shared_ptr<VgeModelAsset> asset{};
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_workAvailable.wait(
+                lock,
+                [this]()
+                {
+                    return m_stopping || !m_queued.empty();
+                });
+            if (m_stopping) {
+                return;
+            }
+            asset = m_queued.front();
+            m_queued.pop_front();
+        }
+
+        ModelLoad load{};
+        load.asset = asset;
+        try {
+            uint64_t contentHash = hashModelFile(asset->filepath, asset->vertexFormat);
+            {
+                // an expired entry is taken over by the asset
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                asset->contentHash = contentHash;
+                std::weak_ptr<VgeModelAsset>& contentAsset = m_contentAssets[contentHash];
+                load.source = contentAsset.lock();
+                if (load.source == nullptr) {
+                    contentAsset = asset;
+                }
+            }
+            // on a hash collision the asset is imported on its own, without a content entry
+            if (load.source != nullptr && load.source->vertexFormat == asset->vertexFormat &&
+                isSameFileContent(load.source->filepath, asset->filepath))
+            {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                m_loaded.push_back(std::move(load));
+                continue;
+            }
+            load.source = nullptr;
+
+            VgeModel::Builder builder{};
+            builder.vertexFormat = asset->vertexFormat;
+            builder.importModel(asset->filepath);
+            load.model = std::make_shared<VgeModel>(m_vgeDevice, builder, &load.uploads);
+        }
+        catch (const std::exception& e) {
+            std::cout << asset->filepath << ": failed to load, " << e.what() << std::endl;
+            asset->failed = true;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_loaded.push_back(std::move(load));
+    }
+}
+
+} // namespace vge
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "vge_device.hpp"
+#include "vge_game_object.hpp"
+#include "vge_model.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vge {
+
+// A model streamed in by VgeAssetManager, shared with the game objects drawing it
+struct VgeModelAsset
+{
+    std::string filepath{};
+    VgeModel::VertexFormat vertexFormat = VgeModel::VertexFormat::FLOAT;
+    std::shared_ptr<VgeModel> model{}; // set on the main thread once its upload has completed
+    std::atomic<bool> failed{ false }; // set by a worker when the import threw
+    uint64_t contentHash = 0; // of the file and vertex format, set by a worker under m_mutex
+    // game objects to hand the model to once it is resident, only used by the main thread
+    std::vector<VgeGameObject::id_t> waitingObjects{};
+};
+
+// Imports models on worker threads and uploads them through the transfer queue, so loading
+// never stalls a frame. Game objects attached to an asset get its model once the upload's fence
+// has signaled.
+//
+// Loads are deduplicated: requests for the same file share one asset, and files with identical
+// content share one model, so a mesh referenced many times is imported and uploaded once. Assets
+// nothing else references stay cached until the cached models exceed the memory budget, then
+// the least recently requested ones are evicted
+class VgeAssetManager {
+public:
+    static constexpr unsigned int WORKER_COUNT = 2;
+    static constexpr VkDeviceSize DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+    VgeAssetManager(VgeDevice& device);
+    ~VgeAssetManager();
+
+    VgeAssetManager(const VgeAssetManager&) = delete;
+    VgeAssetManager& operator=(const VgeAssetManager&) = delete;
+
+    std::shared_ptr<VgeModelAsset> loadModel(
+        const std::string& filepath,
+        VgeModel::VertexFormat vertexFormat = VgeModel::VertexFormat::FLOAT);
+    void attachModel(VgeGameObject& gameObject, const std::shared_ptr<VgeModelAsset>& asset);
+    void update(VkCommandBuffer commandBuffer, VgeGameObject::Map& gameObjects);
+    void setMemoryBudget(VkDeviceSize memoryBudget);
+
+    VkDeviceSize getCachedMemorySize() const;
+
+private:
+    // a model imported by a worker whose buffers still have to be copied, or a duplicate of
+    // another asset's file that takes its model once that one is resident
+    struct ModelLoad
+    {
+        std::shared_ptr<VgeModelAsset> asset{};
+        std::shared_ptr<VgeModel> model{};
+        std::vector<VgeModel::BufferUpload> uploads{};
+        std::shared_ptr<VgeModelAsset> source{}; // null unless the load is a duplicate
+    };
+
+    // the copies of one submission to the transfer queue
+    struct TransferBatch
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        std::vector<ModelLoad> loads{};
+    };
+
+    struct CacheEntry
+    {
+        std::shared_ptr<VgeModelAsset> asset{};
+        uint64_t lastRequestFrame = 0;
+    };
+
+    // an evicted model, kept until the frames in flight that may draw it have completed
+    struct RetiredModel
+    {
+        std::shared_ptr<VgeModel> model{};
+        uint64_t frame = 0;
+    };
+
+    void createCommandPool();
+    void workerLoop();
+    void submitLoads(std::vector<ModelLoad>& loads);
+    void retireBatches(VkCommandBuffer commandBuffer);
+    void destroyBatch(TransferBatch& batch);
+    void resolveDuplicates();
+    void evictUnused();
+
+    VgeDevice& m_vgeDevice;
+    uint32_t m_graphicsFamily;
+    uint32_t m_transferFamily;
+    VkCommandPool m_commandPool;          // transfer family, only used by the main thread
+    std::vector<TransferBatch> m_batches; // submitted and not yet retired
+    std::vector<ModelLoad> m_duplicates;  // waiting for their source to be resident
+    // made resident by the current update, their waiting objects get the model
+    std::vector<std::shared_ptr<VgeModelAsset>> m_residentAssets;
+
+    // keyed by canonical path and vertex format, only used by the main thread
+    std::unordered_map<std::string, CacheEntry> m_cache;
+    std::deque<RetiredModel> m_retiredModels;
+    VkDeviceSize m_memoryBudget;
+    uint64_t m_frame; // counts update calls
+
+    // shared with the workers, guarded by m_mutex
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::deque<std::shared_ptr<VgeModelAsset>> m_queued; // waiting for a worker
+    std::vector<ModelLoad> m_loaded;                     // waiting for submission
+    // first asset imported per content hash and vertex format, erased when it is evicted
+    std::unordered_map<uint64_t, std::weak_ptr<VgeModelAsset>> m_contentAssets;
+    bool m_stopping;
+};
+
+} // namespace vge
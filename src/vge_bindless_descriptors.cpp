@@ -0,0 +1,353 @@
+#include "vge_bindless_descriptors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace vge {
+
+/* Computes the sampled image array size supported by the device
+ *
+ * Combined image samplers count against both the sampled image and the
+ * sampler update-after-bind limits, so the smallest of them is used.
+ */
+static uint32_t sampledImageCapacity(VgeDevice& vgeDevice)
+{
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits =
+        vgeDevice.getDescriptorIndexingProperties();
+    return std::min({ VgeBindlessDescriptors::MAX_SAMPLED_IMAGES,
+                      limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                      limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                      limits.maxDescriptorSetUpdateAfterBindSamplers,
+                      limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+}
+
+/* Computes the storage buffer array size supported by the device
+ *
+ * Clamps the requested array size to the update-after-bind storage buffer
+ * limits of the physical device.
+ */
+static uint32_t storageBufferCapacity(VgeDevice& vgeDevice)
+{
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits =
+        vgeDevice.getDescriptorIndexingProperties();
+    return std::min({ VgeBindlessDescriptors::MAX_STORAGE_BUFFERS,
+                      limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                      limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+}
+
+// *************** Slot Allocator *********************
+
+/* Constructs a SlotAllocator
+ *
+ * Slots are handed out linearly until the free list holds recycled ones.
+ * Released slots are kept pending per frame index for one full trip around
+ * the frames in flight.
+ */
+VgeBindlessDescriptors::SlotAllocator::SlotAllocator(uint32_t capacity, int frameCount)
+    : m_capacity{ capacity }
+    , m_nextSlot{ 0 }
+    , m_freeSlots{}
+    , m_pendingSlots(frameCount)
+{}
+
+/* Allocates an array slot
+ *
+ * Prefers recycled slots so the array stays densely populated. Returns
+ * INVALID_INDEX when every slot is in use.
+ */
+uint32_t VgeBindlessDescriptors::SlotAllocator::allocate()
+{
+    if (!m_freeSlots.empty()) {
+        uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+    if (m_nextSlot < m_capacity) {
+        return m_nextSlot++;
+    }
+    return INVALID_INDEX;
+}
+
+/* Releases an array slot
+ *
+ * Command buffers of the frames in flight may still index the slot, so it
+ * is only parked under the current frame index until recycle is called for
+ * that frame index again.
+ */
+void VgeBindlessDescriptors::SlotAllocator::release(uint32_t slot, int frameIndex)
+{
+    assert(slot < m_nextSlot && "Releasing a slot that was never allocated!");
+    m_pendingSlots[frameIndex].push_back(slot);
+}
+
+/* Returns the slots parked under a frame index to the free list
+ *
+ * Must be called after the fence of the frame has been waited on, at which
+ * point every frame that could have read the slots has completed.
+ */
+void VgeBindlessDescriptors::SlotAllocator::recycle(int frameIndex)
+{
+    std::vector<uint32_t>& pending = m_pendingSlots[frameIndex];
+    m_freeSlots.insert(m_freeSlots.end(), pending.begin(), pending.end());
+    pending.clear();
+}
+
+/* Get the number of slots in the array
+ *
+ * Returns the descriptor count of the binding the allocator manages.
+ */
+uint32_t VgeBindlessDescriptors::SlotAllocator::getCapacity() const
+{
+    return m_capacity;
+}
+
+// *************** Bindless Descriptors *********************
+
+/* Constructs VgeBindlessDescriptors
+ *
+ * Creates one descriptor set holding a large partially bound array of
+ * combined image samplers and one of storage buffers. Both arrays are
+ * update-after-bind, so resources can be added while the set is bound by
+ * frames in flight, and the set only needs binding once per frame.
+ */
+VgeBindlessDescriptors::VgeBindlessDescriptors(VgeDevice& vgeDevice, int frameCount)
+    : m_vgeDevice{ vgeDevice }
+    , m_sampledImageSlots{ sampledImageCapacity(vgeDevice), frameCount }
+    , m_storageBufferSlots{ storageBufferCapacity(vgeDevice), frameCount }
+    , m_frameIndex{ 0 }
+    , m_descriptorSetLayout{}
+    , m_descriptorPool{}
+    , m_descriptorSet{}
+{
+    assert(m_vgeDevice.supportsDescriptorIndexing() && "Descriptor indexing is not enabled!");
+
+    createDescriptorSetLayout();
+
+    m_descriptorPool =
+        VgeDescriptorPool::Builder(m_vgeDevice)
+            .setMaxSets(1)
+            .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT)
+            .addPoolSize(
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                m_sampledImageSlots.getCapacity())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_storageBufferSlots.getCapacity())
+            .build();
+
+    if (!m_descriptorPool->allocateDescriptorSet(m_descriptorSetLayout, m_descriptorSet)) {
+        throw std::runtime_error("Failed to allocate bindless descriptor set!");
+    }
+}
+
+/* Destroys VgeBindlessDescriptors
+ *
+ * The descriptor set is released with its pool, only the layout has to be
+ * destroyed explicitly.
+ */
+VgeBindlessDescriptors::~VgeBindlessDescriptors()
+{
+    vkDestroyDescriptorSetLayout(m_vgeDevice.getDevice(), m_descriptorSetLayout, nullptr);
+}
+
+/* Creates the bindless descriptor set layout
+ *
+ * Both bindings are partially bound, so unused slots may stay unwritten,
+ * and update-after-bind, so slots not used by pending command buffers may
+ * be written at any time.
+ */
+void VgeBindlessDescriptors::createDescriptorSetLayout()
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = SAMPLED_IMAGE_BINDING;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = m_sampledImageSlots.getCapacity();
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    bindings[1].binding = STORAGE_BUFFER_BINDING;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = m_storageBufferSlots.getCapacity();
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+    VkDescriptorBindingFlagsEXT bindingFlags =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    std::array<VkDescriptorBindingFlagsEXT, 2> flags{ bindingFlags, bindingFlags };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(flags.size());
+    bindingFlagsInfo.pBindingFlags = flags.data();
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    descriptorSetLayoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(
+            m_vgeDevice.getDevice(),
+            &descriptorSetLayoutInfo,
+            nullptr,
+            &m_descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create bindless descriptor set layout!");
+    }
+}
+
+/* Writes a single array element of the bindless set
+ *
+ * Exactly one of imageInfo and bufferInfo is expected to be set, matching
+ * the descriptor type of the binding.
+ */
+void VgeBindlessDescriptors::writeDescriptor(
+    uint32_t binding,
+    uint32_t index,
+    VkDescriptorType descriptorType,
+    const VkDescriptorImageInfo* imageInfo,
+    const VkDescriptorBufferInfo* bufferInfo)
+{
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_descriptorSet;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorType = descriptorType;
+    write.descriptorCount = 1;
+    write.pImageInfo = imageInfo;
+    write.pBufferInfo = bufferInfo;
+
+    vkUpdateDescriptorSets(m_vgeDevice.getDevice(), 1, &write, 0, nullptr);
+}
+
+/* Adds a sampled image to the bindless array
+ *
+ * Returns the array index shaders use to sample the image, or
+ * INVALID_INDEX when the array is full.
+ */
+uint32_t VgeBindlessDescriptors::addSampledImage(
+    VkImageView imageView,
+    VkSampler sampler,
+    VkImageLayout imageLayout)
+{
+    uint32_t index = m_sampledImageSlots.allocate();
+    if (index == INVALID_INDEX) {
+        return INVALID_INDEX;
+    }
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = imageLayout;
+    writeDescriptor(
+        SAMPLED_IMAGE_BINDING,
+        index,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        &imageInfo,
+        nullptr);
+    return index;
+}
+
+/* Adds a storage buffer to the bindless array
+ *
+ * Returns the array index shaders use to access the buffer, or
+ * INVALID_INDEX when the array is full.
+ */
+uint32_t VgeBindlessDescriptors::addStorageBuffer(const VkDescriptorBufferInfo& bufferInfo)
+{
+    uint32_t index = m_storageBufferSlots.allocate();
+    if (index == INVALID_INDEX) {
+        return INVALID_INDEX;
+    }
+
+    updateStorageBuffer(index, bufferInfo);
+    return index;
+}
+
+/* Points an allocated storage buffer slot at a different buffer
+ *
+ * Used when a buffer is reallocated to grow. The slot must not be read by
+ * any command buffer still pending execution.
+ */
+void VgeBindlessDescriptors::updateStorageBuffer(
+    uint32_t index,
+    const VkDescriptorBufferInfo& bufferInfo)
+{
+    assert(index < m_storageBufferSlots.getCapacity() && "Storage buffer index out of range!");
+    writeDescriptor(
+        STORAGE_BUFFER_BINDING,
+        index,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        nullptr,
+        &bufferInfo);
+}
+
+/* Removes a sampled image from the bindless array
+ *
+ * The slot becomes reusable once the frames in flight have completed.
+ */
+void VgeBindlessDescriptors::removeSampledImage(uint32_t index)
+{
+    m_sampledImageSlots.release(index, m_frameIndex);
+}
+
+/* Removes a storage buffer from the bindless array
+ *
+ * The slot becomes reusable once the frames in flight have completed.
+ */
+void VgeBindlessDescriptors::removeStorageBuffer(uint32_t index)
+{
+    m_storageBufferSlots.release(index, m_frameIndex);
+}
+
+/* Marks the beginning of a frame
+ *
+ * Must be called after the frame's fence has been waited on. Slots removed
+ * the last time this frame index was current are recycled.
+ */
+void VgeBindlessDescriptors::beginFrame(int frameIndex)
+{
+    m_frameIndex = frameIndex;
+    m_sampledImageSlots.recycle(frameIndex);
+    m_storageBufferSlots.recycle(frameIndex);
+}
+
+/* Get the bindless descriptor set layout
+ *
+ * Returns the layout to include in pipeline layouts that read bindless
+ * resources.
+ */
+VkDescriptorSetLayout VgeBindlessDescriptors::getDescriptorSetLayout() const
+{
+    return m_descriptorSetLayout;
+}
+
+/* Get the bindless descriptor set
+ *
+ * Returns the single set holding every bindless resource.
+ */
+VkDescriptorSet VgeBindlessDescriptors::getDescriptorSet() const
+{
+    return m_descriptorSet;
+}
+
+/* Get the sampled image array size
+ *
+ * Returns the number of sampled image slots after clamping to device limits.
+ */
+uint32_t VgeBindlessDescriptors::getSampledImageCapacity() const
+{
+    return m_sampledImageSlots.getCapacity();
+}
+
+/* Get the storage buffer array size
+ *
+ * Returns the number of storage buffer slots after clamping to device limits.
+ */
+uint32_t VgeBindlessDescriptors::getStorageBufferCapacity() const
+{
+    return m_storageBufferSlots.getCapacity();
+}
+
+} // namespace vge
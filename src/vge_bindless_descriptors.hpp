@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vge_descriptors.hpp"
+#include "vge_device.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vge {
+
+class VgeBindlessDescriptors {
+public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+    static constexpr uint32_t SAMPLED_IMAGE_BINDING = 0;
+    static constexpr uint32_t STORAGE_BUFFER_BINDING = 1;
+    static constexpr uint32_t MAX_SAMPLED_IMAGES = 4096;
+    static constexpr uint32_t MAX_STORAGE_BUFFERS = 1024;
+
+    VgeBindlessDescriptors(VgeDevice& vgeDevice, int frameCount);
+    ~VgeBindlessDescriptors();
+    VgeBindlessDescriptors(const VgeBindlessDescriptors&) = delete;
+    VgeBindlessDescriptors& operator=(const VgeBindlessDescriptors&) = delete;
+
+    uint32_t addSampledImage(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+    uint32_t addStorageBuffer(const VkDescriptorBufferInfo& bufferInfo);
+    void updateStorageBuffer(uint32_t index, const VkDescriptorBufferInfo& bufferInfo);
+    void removeSampledImage(uint32_t index);
+    void removeStorageBuffer(uint32_t index);
+
+    void beginFrame(int frameIndex);
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const;
+    VkDescriptorSet getDescriptorSet() const;
+    uint32_t getSampledImageCapacity() const;
+    uint32_t getStorageBufferCapacity() const;
+
+private:
+    // Hands out array slots, freed slots are only reused once no frame in flight can read them
+    class SlotAllocator {
+    public:
+        SlotAllocator(uint32_t capacity, int frameCount);
+
+        uint32_t allocate();
+        void release(uint32_t slot, int frameIndex);
+        void recycle(int frameIndex);
+        uint32_t getCapacity() const;
+
+    private:
+        uint32_t m_capacity;
+        uint32_t m_nextSlot;
+        std::vector<uint32_t> m_freeSlots;
+        std::vector<std::vector<uint32_t>> m_pendingSlots; // per frame index
+    };
+
+    void createDescriptorSetLayout();
+    void writeDescriptor(
+        uint32_t binding,
+        uint32_t index,
+        VkDescriptorType descriptorType,
+        const VkDescriptorImageInfo* imageInfo,
+        const VkDescriptorBufferInfo* bufferInfo);
+
+    VgeDevice& m_vgeDevice;
+    SlotAllocator m_sampledImageSlots;
+    SlotAllocator m_storageBufferSlots;
+    int m_frameIndex;
+
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    std::unique_ptr<VgeDescriptorPool> m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+};
+
+} // namespace vge
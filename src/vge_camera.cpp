@@ -32,6 +32,8 @@ void VgeCamera::setOrthographicProjectionMatrix(
     m_projectionMatrix[3][0] = -(right + left) / (right - left);
     m_projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
     m_projectionMatrix[3][2] = -near / (far - near);
+    m_near = near;
+    m_far = far;
 }
 
 /* Sets the Vulkan Canonical View Volume using a Perspective Projection Matrix.
@@ -52,6 +54,8 @@ void VgeCamera::setPerspectiveProjectionMatrix(float fovy, float aspect, float n
     m_projectionMatrix[2][2] = far / (far - near);
     m_projectionMatrix[2][3] = 1.f;
     m_projectionMatrix[3][2] = -(far * near) / (far - near);
+    m_near = near;
+    m_far = far;
 }
 
 /* Sets the camera's View Direction using a Rotation and Translation Matrix.
@@ -187,4 +191,16 @@ const glm::mat4& VgeCamera::getInverseViewMatrix() const
 {
     return m_inverseViewMatrix;
 }
+
+// Returns the distance to the near clipping plane.
+float VgeCamera::getNear() const
+{
+    return m_near;
+}
+
+// Returns the distance to the far clipping plane.
+float VgeCamera::getFar() const
+{
+    return m_far;
+}
 } // namespace vge
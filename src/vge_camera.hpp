@@ -36,10 +36,14 @@ public:
     const glm::mat4& getProjectionMatrix() const;
     const glm::mat4& getViewMatrix() const;
     const glm::mat4& getInverseViewMatrix() const;
+    float getNear() const;
+    float getFar() const;
 
 private:
     glm::mat4 m_projectionMatrix{ 1.f };
     glm::mat4 m_viewMatrix{ 1.f };
     glm::mat4 m_inverseViewMatrix{ 1.f };
+    float m_near{ 0.1f };
+    float m_far{ 100.f };
 };
 } // namespace vge
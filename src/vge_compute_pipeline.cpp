@@ -0,0 +1,92 @@
+#include "vge_compute_pipeline.hpp"
+#include "vge_pipeline.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+namespace vge {
+
+/* Constructs a VgeComputePipeline object.
+ *
+ * Initializes the compute pipeline with the specified device, compute shader
+ * file path, and pipeline layout. The shader's specialization constants are
+ * set from specializationInfo when given, left at their defaults otherwise.
+ */
+VgeComputePipeline::VgeComputePipeline(
+    VgeDevice& device,
+    const std::string& compFilepath,
+    VkPipelineLayout pipelineLayout,
+    const VkSpecializationInfo* specializationInfo)
+    : m_vgeDevice{ device }
+    , m_computePipeline{}
+    , m_compShaderModule{}
+{
+    createComputePipeline(compFilepath, pipelineLayout, specializationInfo);
+}
+
+/* Destroys the VgeComputePipeline object.
+ *
+ * Cleans up the compute shader module and the pipeline.
+ */
+VgeComputePipeline::~VgeComputePipeline()
+{
+    vkDestroyShaderModule(m_vgeDevice.getDevice(), m_compShaderModule, nullptr);
+    vkDestroyPipeline(m_vgeDevice.getDevice(), m_computePipeline, nullptr);
+}
+
+/* Creates a compute pipeline from a SPIR-V compute shader.
+ *
+ * Reads the binary shader file, creates its shader module and builds the
+ * pipeline against the given layout. A runtime error is thrown on failure.
+ */
+void VgeComputePipeline::createComputePipeline(
+    const std::string& compFilepath,
+    VkPipelineLayout pipelineLayout,
+    const VkSpecializationInfo* specializationInfo)
+{
+    std::vector<char> compCode = VgePipeline::readFile(compFilepath);
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = compCode.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+    if (vkCreateShaderModule(m_vgeDevice.getDevice(), &moduleInfo, nullptr, &m_compShaderModule) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create shader module");
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStage{};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStage.module = m_compShaderModule;
+    shaderStage.pName = "main";
+    shaderStage.pSpecializationInfo = specializationInfo;
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = shaderStage;
+    pipelineInfo.layout = pipelineLayout;
+
+    if (vkCreateComputePipelines(
+            m_vgeDevice.getDevice(),
+            VK_NULL_HANDLE,
+            1,
+            &pipelineInfo,
+            nullptr,
+            &m_computePipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create compute pipeline");
+    }
+}
+
+/* Binds the compute pipeline to the specified command buffer.
+ *
+ * Subsequent dispatches recorded into the command buffer use this pipeline.
+ */
+void VgeComputePipeline::bind(VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+}
+
+} // namespace vge
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vge_device.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <string>
+
+namespace vge {
+
+class VgeComputePipeline {
+public:
+    VgeComputePipeline(
+        VgeDevice& device,
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout,
+        const VkSpecializationInfo* specializationInfo = nullptr);
+    ~VgeComputePipeline();
+
+    VgeComputePipeline(const VgeComputePipeline&) = delete;
+    VgeComputePipeline& operator=(const VgeComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+
+private:
+    void createComputePipeline(
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout,
+        const VkSpecializationInfo* specializationInfo);
+
+    VgeDevice& m_vgeDevice;
+    VkPipeline m_computePipeline;
+    VkShaderModule m_compShaderModule;
+};
+
+} // namespace vge
@@ -1,5 +1,7 @@
 #include "vge_descriptors.hpp"
+#include "vge_utils.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -46,6 +48,17 @@ std::unique_ptr<VgeDescriptorSetLayout> VgeDescriptorSetLayout::Builder::build()
     return std::make_unique<VgeDescriptorSetLayout>(m_vgeDevice, m_bindings);
 }
 
+/* Builds the VgeDescriptorSetLayout through a layout cache.
+ *
+ * Returns the cached layout when an identical set of bindings was built
+ * before, otherwise creates it. The cache owns the returned layout.
+ */
+VgeDescriptorSetLayout& VgeDescriptorSetLayout::Builder::build(
+    VgeDescriptorLayoutCache& cache) const
+{
+    return cache.getLayout(m_bindings);
+}
+
 // *************** Descriptor Set Layout *********************
 /* Constructs a VgeDescriptorSetLayout with specified bindings.
  *
@@ -200,6 +213,20 @@ VgeDescriptorPool::~VgeDescriptorPool()
 bool VgeDescriptorPool::allocateDescriptorSet(
     const VkDescriptorSetLayout descriptorSetLayout,
     VkDescriptorSet& descriptor) const
+{
+    return tryAllocateDescriptorSet(descriptorSetLayout, descriptor) == VK_SUCCESS;
+}
+
+/* Allocates a descriptor set from the pool and reports the Vulkan result.
+ *
+ * This function behaves like allocateDescriptorSet, but returns the raw
+ * VkResult so callers can tell an exhausted pool
+ * (VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL) apart from other
+ * failures.
+ */
+VkResult VgeDescriptorPool::tryAllocateDescriptorSet(
+    const VkDescriptorSetLayout descriptorSetLayout,
+    VkDescriptorSet& descriptor) const
 {
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -207,13 +234,8 @@ bool VgeDescriptorPool::allocateDescriptorSet(
     allocInfo.pSetLayouts = &descriptorSetLayout;
     allocInfo.descriptorSetCount = 1;
 
-    // Might want to create a "DescriptorPoolManager" class that handles this
-    // case, and builds a new pool whenever an old pool fills up. But this is
-    // beyond our current scope
-    if (vkAllocateDescriptorSets(m_vgeDevice.getDevice(), &allocInfo, &descriptor) != VK_SUCCESS) {
-        return false;
-    }
-    return true;
+    // VgeDescriptorAllocator handles a full pool by chaining a new one
+    return vkAllocateDescriptorSets(m_vgeDevice.getDevice(), &allocInfo, &descriptor);
 }
 
 /* Frees a vector of descriptor sets back to the pool.
@@ -240,6 +262,521 @@ void VgeDescriptorPool::resetPool()
     vkResetDescriptorPool(m_vgeDevice.getDevice(), m_descriptorPool, 0);
 }
 
+// *************** Descriptor Allocator Builder *********************
+/* Constructs a Builder for creating a VgeDescriptorAllocator.
+ *
+ * This constructor initializes the Builder with the specified VgeDevice.
+ */
+VgeDescriptorAllocator::Builder::Builder(VgeDevice& vgeDevice)
+    : m_vgeDevice{ vgeDevice }
+{}
+
+/* Adds a descriptor type to the pools created by the allocator.
+ *
+ * The ratio is the average number of descriptors of this type per set. Each
+ * pool reserves ratio * setsPerPool descriptors of the type.
+ */
+VgeDescriptorAllocator::Builder& VgeDescriptorAllocator::Builder::addPoolSizeRatio(
+    VkDescriptorType descriptorType,
+    float descriptorsPerSet)
+{
+    m_poolSizeRatios.push_back({ descriptorType, descriptorsPerSet });
+    return *this;
+}
+
+/* Sets the creation flags for every pool created by the allocator.
+ *
+ * Pools are recycled with vkResetDescriptorPool, so the free descriptor set
+ * flag is normally not needed.
+ */
+VgeDescriptorAllocator::Builder& VgeDescriptorAllocator::Builder::setPoolFlags(
+    VkDescriptorPoolCreateFlags flags)
+{
+    m_poolFlags = flags;
+    return *this;
+}
+
+/* Sets the number of descriptor sets the first pool can hold.
+ *
+ * Every additional pool chained by the allocator doubles this count, up to
+ * the maximum set with setMaxSetsPerPool.
+ */
+VgeDescriptorAllocator::Builder& VgeDescriptorAllocator::Builder::setSetsPerPool(uint32_t count)
+{
+    m_setsPerPool = count;
+    return *this;
+}
+
+/* Sets the upper bound for the number of sets in a single pool.
+ *
+ * Limits how large chained pools grow once the allocator starts doubling.
+ */
+VgeDescriptorAllocator::Builder& VgeDescriptorAllocator::Builder::setMaxSetsPerPool(
+    uint32_t count)
+{
+    m_maxSetsPerPool = count;
+    return *this;
+}
+
+/* Builds the VgeDescriptorAllocator from the configured settings.
+ *
+ * This function creates a unique pointer to a VgeDescriptorAllocator
+ * instance, using the parameters previously set in the Builder.
+ */
+std::unique_ptr<VgeDescriptorAllocator> VgeDescriptorAllocator::Builder::build() const
+{
+    return std::make_unique<VgeDescriptorAllocator>(
+        m_vgeDevice,
+        m_setsPerPool,
+        m_maxSetsPerPool,
+        m_poolFlags,
+        m_poolSizeRatios);
+}
+
+// *************** Descriptor Allocator *********************
+/* Constructs a VgeDescriptorAllocator.
+ *
+ * No pool is created until the first allocation. Pools are then created on
+ * demand and chained whenever the current one runs out of memory.
+ */
+VgeDescriptorAllocator::VgeDescriptorAllocator(
+    VgeDevice& vgeDevice,
+    uint32_t setsPerPool,
+    uint32_t maxSetsPerPool,
+    VkDescriptorPoolCreateFlags poolFlags,
+    const std::vector<std::pair<VkDescriptorType, float>>& poolSizeRatios)
+    : m_vgeDevice{ vgeDevice }
+    , m_setsPerPool{ setsPerPool }
+    , m_maxSetsPerPool{ maxSetsPerPool }
+    , m_poolFlags{ poolFlags }
+    , m_poolSizeRatios{ poolSizeRatios }
+    , m_usedPools{}
+    , m_freePools{}
+{
+    assert(m_setsPerPool > 0 && "Descriptor allocator needs at least one set per pool");
+}
+
+/* Destroys the VgeDescriptorAllocator.
+ *
+ * Every pool owned by the allocator is destroyed, which implicitly frees all
+ * descriptor sets allocated from them.
+ */
+VgeDescriptorAllocator::~VgeDescriptorAllocator()
+{}
+
+/* Retrieves a pool ready for allocation.
+ *
+ * Reuses a pool released by resetPools when one is available, otherwise
+ * creates a new pool and doubles the size used for the next one.
+ */
+std::unique_ptr<VgeDescriptorPool> VgeDescriptorAllocator::grabPool()
+{
+    if (!m_freePools.empty()) {
+        std::unique_ptr<VgeDescriptorPool> pool = std::move(m_freePools.back());
+        m_freePools.pop_back();
+        return pool;
+    }
+
+    VgeDescriptorPool::Builder builder{ m_vgeDevice };
+    builder.setMaxSets(m_setsPerPool).setPoolFlags(m_poolFlags);
+    for (const std::pair<VkDescriptorType, float>& ratio : m_poolSizeRatios) {
+        uint32_t count = static_cast<uint32_t>(ratio.second * static_cast<float>(m_setsPerPool));
+        builder.addPoolSize(ratio.first, count > 0 ? count : 1);
+    }
+
+    m_setsPerPool = std::min(m_setsPerPool * 2, m_maxSetsPerPool);
+    return builder.build();
+}
+
+/* Allocates a descriptor set, growing the allocator when needed.
+ *
+ * The set is allocated from the current pool. If the pool is exhausted
+ * (out of pool memory or fragmented), a new pool is chained and the
+ * allocation is retried once. Returns false if the allocation still fails.
+ */
+bool VgeDescriptorAllocator::allocateDescriptorSet(
+    const VkDescriptorSetLayout descriptorSetLayout,
+    VkDescriptorSet& descriptor)
+{
+    if (m_usedPools.empty()) {
+        m_usedPools.push_back(grabPool());
+    }
+
+    VkResult result = m_usedPools.back()->tryAllocateDescriptorSet(descriptorSetLayout, descriptor);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        m_usedPools.push_back(grabPool());
+        result = m_usedPools.back()->tryAllocateDescriptorSet(descriptorSetLayout, descriptor);
+    }
+    return result == VK_SUCCESS;
+}
+
+/* Resets every pool owned by the allocator.
+ *
+ * Each used pool is reset with a single vkResetDescriptorPool call instead
+ * of freeing its sets one by one, and is kept for reuse. All sets allocated
+ * from the allocator become invalid, so the GPU must be done with them.
+ */
+void VgeDescriptorAllocator::resetPools()
+{
+    for (std::unique_ptr<VgeDescriptorPool>& pool : m_usedPools) {
+        pool->resetPool();
+        m_freePools.push_back(std::move(pool));
+    }
+    m_usedPools.clear();
+}
+
+// *************** Frame Descriptor Allocator *********************
+/* Constructs a VgeFrameDescriptorAllocator.
+ *
+ * Builds one growable allocator per frame in flight from the given builder.
+ * Sets allocated for a frame live until that frame index comes around again.
+ */
+VgeFrameDescriptorAllocator::VgeFrameDescriptorAllocator(
+    const VgeDescriptorAllocator::Builder& builder,
+    int frameCount)
+    : m_frameAllocators{}
+{
+    for (int i = 0; i < frameCount; i++) {
+        m_frameAllocators.push_back(builder.build());
+    }
+}
+
+/* Destroys the VgeFrameDescriptorAllocator.
+ *
+ * Releases the allocators, and with them all pools, of every frame.
+ */
+VgeFrameDescriptorAllocator::~VgeFrameDescriptorAllocator()
+{}
+
+/* Begins a frame and returns its allocator.
+ *
+ * Resets all pools of the frame at once. Must only be called after the
+ * frame's fence has been waited on, so the GPU no longer reads its sets.
+ */
+VgeDescriptorAllocator& VgeFrameDescriptorAllocator::beginFrame(int frameIndex)
+{
+    VgeDescriptorAllocator& allocator = getFrameAllocator(frameIndex);
+    allocator.resetPools();
+    return allocator;
+}
+
+/* Retrieves the allocator of the given frame without resetting it.
+ *
+ * Used to allocate transient sets for the frame currently being recorded.
+ */
+VgeDescriptorAllocator& VgeFrameDescriptorAllocator::getFrameAllocator(int frameIndex)
+{
+    assert(
+        frameIndex >= 0 && frameIndex < static_cast<int>(m_frameAllocators.size()) &&
+        "Frame index out of range");
+    return *m_frameAllocators[static_cast<size_t>(frameIndex)];
+}
+
+// *************** Descriptor Layout Cache *********************
+/* Constructs an empty VgeDescriptorLayoutCache.
+ *
+ * Layouts are created on first request and live as long as the cache.
+ */
+VgeDescriptorLayoutCache::VgeDescriptorLayoutCache(VgeDevice& vgeDevice)
+    : m_vgeDevice{ vgeDevice }
+    , m_layouts{}
+{}
+
+/* Destroys the VgeDescriptorLayoutCache.
+ *
+ * Destroys every cached descriptor set layout.
+ */
+VgeDescriptorLayoutCache::~VgeDescriptorLayoutCache()
+{}
+
+/* Retrieves the descriptor set layout for a set of bindings.
+ *
+ * The bindings are normalized by sorting them on their binding index, so the
+ * order bindings were added in doesn't matter. An existing layout is returned
+ * for a repeated request, otherwise a new one is created and cached.
+ */
+VgeDescriptorSetLayout& VgeDescriptorLayoutCache::getLayout(
+    const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings)
+{
+    LayoutKey key{};
+    key.bindings.reserve(bindings.size());
+    for (const std::pair<const uint32_t, VkDescriptorSetLayoutBinding>& kv : bindings) {
+        key.bindings.push_back(kv.second);
+    }
+    std::sort(
+        key.bindings.begin(),
+        key.bindings.end(),
+        [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+        {
+            return a.binding < b.binding;
+        });
+
+    std::unique_ptr<VgeDescriptorSetLayout>& layout = m_layouts[key];
+    if (layout == nullptr) {
+        layout = std::make_unique<VgeDescriptorSetLayout>(m_vgeDevice, bindings);
+    }
+    return *layout;
+}
+
+/* Returns the number of unique layouts in the cache.
+ *
+ * Useful to check that layouts scale with unique binding sets.
+ */
+size_t VgeDescriptorLayoutCache::size() const
+{
+    return m_layouts.size();
+}
+
+/* Compares two layout keys for equality.
+ *
+ * Bindings are compared field by field; immutable samplers aren't used by
+ * the engine and are ignored.
+ */
+bool VgeDescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+{
+    if (bindings.size() != other.bindings.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding& a = bindings[i];
+        const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+            a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Hashes a layout key.
+ *
+ * Combines the binding index, type, count and stage flags of every binding.
+ */
+size_t VgeDescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+{
+    size_t seed = key.bindings.size();
+    for (const VkDescriptorSetLayoutBinding& binding : key.bindings) {
+        hashCombine(
+            seed,
+            binding.binding,
+            binding.descriptorType,
+            binding.descriptorCount,
+            binding.stageFlags);
+    }
+    return seed;
+}
+
+// *************** Descriptor Set Cache *********************
+/* Constructs an empty VgeDescriptorSetCache.
+ *
+ * Cached sets are allocated from an allocator owned by the cache, so they
+ * can all be released together by clear().
+ */
+VgeDescriptorSetCache::VgeDescriptorSetCache(
+    const VgeDescriptorAllocator::Builder& allocatorBuilder)
+    : m_allocator{ allocatorBuilder.build() }
+    , m_sets{}
+    , m_freeSets{}
+{}
+
+/* Destroys the VgeDescriptorSetCache.
+ *
+ * The owned allocator destroys its pools, freeing every cached set.
+ */
+VgeDescriptorSetCache::~VgeDescriptorSetCache()
+{}
+
+/* Retrieves a descriptor set for a layout and the resources written to it.
+ *
+ * The key is the layout plus a value copy of every descriptor written
+ * (binding, array element, type and the buffer range or image written),
+ * sorted by binding and array element. A repeated request returns the
+ * existing set; otherwise a set invalidated earlier for the layout is
+ * reused, or a new one allocated, then written and cached. Returns false
+ * if allocation fails.
+ */
+bool VgeDescriptorSetCache::getDescriptorSet(
+    VgeDescriptorSetLayout& setLayout,
+    const std::vector<VkWriteDescriptorSet>& writes,
+    VkDescriptorSet& set)
+{
+    SetKey key{};
+    key.layout = setLayout.getDescriptorSetLayout();
+    for (const VkWriteDescriptorSet& write : writes) {
+        for (uint32_t i = 0; i < write.descriptorCount; i++) {
+            ResourceKey resource{};
+            resource.binding = write.dstBinding;
+            resource.arrayElement = write.dstArrayElement + i;
+            resource.descriptorType = write.descriptorType;
+            if (write.pBufferInfo != nullptr) {
+                resource.buffer = write.pBufferInfo[i].buffer;
+                resource.offset = write.pBufferInfo[i].offset;
+                resource.range = write.pBufferInfo[i].range;
+            }
+            if (write.pImageInfo != nullptr) {
+                resource.sampler = write.pImageInfo[i].sampler;
+                resource.imageView = write.pImageInfo[i].imageView;
+                resource.imageLayout = write.pImageInfo[i].imageLayout;
+            }
+            key.resources.push_back(resource);
+        }
+    }
+    std::sort(
+        key.resources.begin(),
+        key.resources.end(),
+        [](const ResourceKey& a, const ResourceKey& b)
+        {
+            return a.binding != b.binding ? a.binding < b.binding
+                                          : a.arrayElement < b.arrayElement;
+        });
+
+    std::unordered_map<SetKey, VkDescriptorSet, SetKeyHash>::iterator it = m_sets.find(key);
+    if (it != m_sets.end()) {
+        set = it->second;
+        return true;
+    }
+
+    std::vector<VkDescriptorSet>& freeSets = m_freeSets[key.layout];
+    if (!freeSets.empty()) {
+        set = freeSets.back();
+        freeSets.pop_back();
+    }
+    else if (!m_allocator->allocateDescriptorSet(key.layout, set)) {
+        return false;
+    }
+
+    std::vector<VkWriteDescriptorSet> setWrites = writes;
+    for (VkWriteDescriptorSet& write : setWrites) {
+        write.dstSet = set;
+    }
+    vkUpdateDescriptorSets(
+        setLayout.m_vgeDevice.getDevice(),
+        static_cast<uint32_t>(setWrites.size()),
+        setWrites.data(),
+        0,
+        nullptr);
+
+    m_sets.emplace(std::move(key), set);
+    return true;
+}
+
+/* Forgets every cached set that references a buffer.
+ *
+ * Must be called when the buffer is destroyed, before sets are requested
+ * for a new one: drivers reuse handles, so a new buffer could otherwise
+ * hit a set written for the destroyed one. The forgotten sets are reused
+ * for later sets of their layout, so they must no longer be in use by the
+ * GPU, as the buffer itself.
+ */
+void VgeDescriptorSetCache::invalidateBuffer(VkBuffer buffer)
+{
+    assert(buffer != VK_NULL_HANDLE && "Cannot invalidate a null buffer");
+    invalidate(buffer, VK_NULL_HANDLE);
+}
+
+/* Forgets every cached set that references an image view.
+ *
+ * Same contract as invalidateBuffer, for image views being destroyed.
+ */
+void VgeDescriptorSetCache::invalidateImageView(VkImageView imageView)
+{
+    assert(imageView != VK_NULL_HANDLE && "Cannot invalidate a null image view");
+    invalidate(VK_NULL_HANDLE, imageView);
+}
+
+/* Forgets every cached set that references a buffer or an image view.
+ *
+ * Null handles match nothing. The sets are kept per layout for reuse.
+ */
+void VgeDescriptorSetCache::invalidate(VkBuffer buffer, VkImageView imageView)
+{
+    std::unordered_map<SetKey, VkDescriptorSet, SetKeyHash>::iterator it = m_sets.begin();
+    while (it != m_sets.end()) {
+        bool referenced = false;
+        for (const ResourceKey& resource : it->first.resources) {
+            if ((buffer != VK_NULL_HANDLE && resource.buffer == buffer) ||
+                (imageView != VK_NULL_HANDLE && resource.imageView == imageView))
+            {
+                referenced = true;
+                break;
+            }
+        }
+        if (referenced) {
+            m_freeSets[it->first.layout].push_back(it->second);
+            it = m_sets.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/* Forgets every cached set and recycles their pools.
+ *
+ * Only call it once the GPU no longer uses any of the cached sets. A single
+ * destroyed resource only needs invalidateBuffer or invalidateImageView.
+ */
+void VgeDescriptorSetCache::clear()
+{
+    m_sets.clear();
+    m_freeSets.clear();
+    m_allocator->resetPools();
+}
+
+/* Returns the number of unique descriptor sets in the cache.
+ *
+ * Useful to check that sets scale with unique materials, not objects.
+ */
+size_t VgeDescriptorSetCache::size() const
+{
+    return m_sets.size();
+}
+
+/* Compares two written resources for equality.
+ *
+ * Every field of the descriptor is compared, including image layout.
+ */
+bool VgeDescriptorSetCache::ResourceKey::operator==(const ResourceKey& other) const
+{
+    return binding == other.binding && arrayElement == other.arrayElement &&
+           descriptorType == other.descriptorType && buffer == other.buffer &&
+           offset == other.offset && range == other.range && sampler == other.sampler &&
+           imageView == other.imageView && imageLayout == other.imageLayout;
+}
+
+/* Compares two set keys for equality.
+ *
+ * Keys are equal when they use the same layout and write the same resources.
+ */
+bool VgeDescriptorSetCache::SetKey::operator==(const SetKey& other) const
+{
+    return layout == other.layout && resources == other.resources;
+}
+
+/* Hashes a set key.
+ *
+ * Combines the layout handle with every field of each written descriptor.
+ */
+size_t VgeDescriptorSetCache::SetKeyHash::operator()(const SetKey& key) const
+{
+    size_t seed = std::hash<VkDescriptorSetLayout>{}(key.layout);
+    for (const ResourceKey& resource : key.resources) {
+        hashCombine(
+            seed,
+            resource.binding,
+            resource.arrayElement,
+            resource.descriptorType,
+            resource.buffer,
+            resource.offset,
+            resource.range,
+            resource.sampler,
+            resource.imageView,
+            resource.imageLayout);
+    }
+    return seed;
+}
+
 // *************** Descriptor Writer *********************
 /* Constructs a VgeDescriptorWriter for writing to a descriptor set.
  *
@@ -248,7 +785,35 @@ void VgeDescriptorPool::resetPool()
  */
 VgeDescriptorWriter::VgeDescriptorWriter(VgeDescriptorSetLayout& setLayout, VgeDescriptorPool& pool)
     : m_setLayout{ setLayout }
-    , m_pool{ pool }
+    , m_pool{ &pool }
+    , m_allocator{ nullptr }
+    , m_writes{}
+{}
+
+/* Constructs a VgeDescriptorWriter that allocates from a growable allocator.
+ *
+ * Sets built by this writer are allocated through the VgeDescriptorAllocator,
+ * which chains new pools instead of failing when a pool fills up.
+ */
+VgeDescriptorWriter::VgeDescriptorWriter(
+    VgeDescriptorSetLayout& setLayout,
+    VgeDescriptorAllocator& allocator)
+    : m_setLayout{ setLayout }
+    , m_pool{ nullptr }
+    , m_allocator{ &allocator }
+    , m_writes{}
+{}
+
+/* Constructs a VgeDescriptorWriter without a pool.
+ *
+ * Such a writer can only fetch sets from a VgeDescriptorSetCache or
+ * overwrite existing sets.
+ */
+VgeDescriptorWriter::VgeDescriptorWriter(VgeDescriptorSetLayout& setLayout)
+    : m_setLayout{ setLayout }
+    , m_pool{ nullptr }
+    , m_allocator{ nullptr }
+    , m_writes{}
 {}
 
 /* Writes buffer information to the specified binding in the descriptor set.
@@ -311,13 +876,19 @@ VgeDescriptorWriter& VgeDescriptorWriter::writeImage(
 
 /* Builds and allocates a descriptor set using the writer.
  *
- * This function allocates a descriptor set from the pool and updates it with
- * the configured write operations. Returns true on success, or false if
- * allocation fails.
+ * This function allocates a descriptor set from the pool (or allocator) and
+ * updates it with the configured write operations. Returns true on success,
+ * or false if allocation fails.
  */
 bool VgeDescriptorWriter::build(VkDescriptorSet& set)
 {
-    bool success = m_pool.allocateDescriptorSet(m_setLayout.getDescriptorSetLayout(), set);
+    assert(
+        (m_pool != nullptr || m_allocator != nullptr) &&
+        "Writer has no pool to allocate from, build through a set cache");
+    bool success =
+        m_pool != nullptr
+            ? m_pool->allocateDescriptorSet(m_setLayout.getDescriptorSetLayout(), set)
+            : m_allocator->allocateDescriptorSet(m_setLayout.getDescriptorSetLayout(), set);
     if (!success) {
         return false;
     }
@@ -325,6 +896,17 @@ bool VgeDescriptorWriter::build(VkDescriptorSet& set)
     return true;
 }
 
+/* Retrieves a descriptor set for the configured writes from a set cache.
+ *
+ * Identical layout and resource combinations share one set, so sets scale
+ * with unique materials instead of objects. Returns false if a new set was
+ * needed and allocation failed.
+ */
+bool VgeDescriptorWriter::build(VkDescriptorSet& set, VgeDescriptorSetCache& cache)
+{
+    return cache.getDescriptorSet(m_setLayout, m_writes, set);
+}
+
 /* Overwrites the specified descriptor set with the configured write operations.
  *
  * This function updates the descriptor set with the write operations that have
@@ -336,8 +918,8 @@ void VgeDescriptorWriter::overwrite(VkDescriptorSet& set)
         write.dstSet = set;
     }
     vkUpdateDescriptorSets(
-        m_pool.m_vgeDevice.getDevice(),
-        m_writes.size(),
+        m_setLayout.m_vgeDevice.getDevice(),
+        static_cast<uint32_t>(m_writes.size()),
         m_writes.data(),
         0,
         nullptr);
@@ -4,10 +4,14 @@
 
 #include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace vge {
 
+class VgeDescriptorLayoutCache;
+class VgeDescriptorSetCache;
+
 class VgeDescriptorSetLayout {
 public:
     class Builder {
@@ -20,6 +24,7 @@ public:
             VkShaderStageFlags stageFlags,
             uint32_t count = 1);
         std::unique_ptr<VgeDescriptorSetLayout> build() const;
+        VgeDescriptorSetLayout& build(VgeDescriptorLayoutCache& cache) const;
 
     private:
         VgeDevice& m_vgeDevice;
@@ -41,6 +46,7 @@ private:
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> m_bindings;
 
     friend class VgeDescriptorWriter;
+    friend class VgeDescriptorSetCache;
 };
 
 class VgeDescriptorPool {
@@ -73,6 +79,9 @@ public:
     bool allocateDescriptorSet(
         const VkDescriptorSetLayout descriptorSetLayout,
         VkDescriptorSet& descriptor) const;
+    VkResult tryAllocateDescriptorSet(
+        const VkDescriptorSetLayout descriptorSetLayout,
+        VkDescriptorSet& descriptor) const;
 
     void freeDescriptors(std::vector<VkDescriptorSet>& descriptors) const;
 
@@ -85,19 +94,171 @@ private:
     friend class VgeDescriptorWriter;
 };
 
+class VgeDescriptorAllocator {
+public:
+    class Builder {
+    public:
+        Builder(VgeDevice& vgeDevice);
+
+        Builder& addPoolSizeRatio(VkDescriptorType descriptorType, float descriptorsPerSet);
+        Builder& setPoolFlags(VkDescriptorPoolCreateFlags flags);
+        Builder& setSetsPerPool(uint32_t count);
+        Builder& setMaxSetsPerPool(uint32_t count);
+        std::unique_ptr<VgeDescriptorAllocator> build() const;
+
+    private:
+        VgeDevice& m_vgeDevice;
+        std::vector<std::pair<VkDescriptorType, float>> m_poolSizeRatios{};
+        uint32_t m_setsPerPool = 64;
+        uint32_t m_maxSetsPerPool = 4096;
+        VkDescriptorPoolCreateFlags m_poolFlags = 0;
+    };
+
+    VgeDescriptorAllocator(
+        VgeDevice& vgeDevice,
+        uint32_t setsPerPool,
+        uint32_t maxSetsPerPool,
+        VkDescriptorPoolCreateFlags poolFlags,
+        const std::vector<std::pair<VkDescriptorType, float>>& poolSizeRatios);
+    ~VgeDescriptorAllocator();
+    VgeDescriptorAllocator(const VgeDescriptorAllocator&) = delete;
+    VgeDescriptorAllocator& operator=(const VgeDescriptorAllocator&) = delete;
+
+    bool allocateDescriptorSet(
+        const VkDescriptorSetLayout descriptorSetLayout,
+        VkDescriptorSet& descriptor);
+
+    void resetPools();
+
+private:
+    std::unique_ptr<VgeDescriptorPool> grabPool();
+
+    VgeDevice& m_vgeDevice;
+    uint32_t m_setsPerPool;
+    uint32_t m_maxSetsPerPool;
+    VkDescriptorPoolCreateFlags m_poolFlags;
+    std::vector<std::pair<VkDescriptorType, float>> m_poolSizeRatios;
+
+    // the last used pool is the one currently allocated from
+    std::vector<std::unique_ptr<VgeDescriptorPool>> m_usedPools;
+    std::vector<std::unique_ptr<VgeDescriptorPool>> m_freePools;
+};
+
+class VgeFrameDescriptorAllocator {
+public:
+    VgeFrameDescriptorAllocator(const VgeDescriptorAllocator::Builder& builder, int frameCount);
+    ~VgeFrameDescriptorAllocator();
+    VgeFrameDescriptorAllocator(const VgeFrameDescriptorAllocator&) = delete;
+    VgeFrameDescriptorAllocator& operator=(const VgeFrameDescriptorAllocator&) = delete;
+
+    VgeDescriptorAllocator& beginFrame(int frameIndex);
+    VgeDescriptorAllocator& getFrameAllocator(int frameIndex);
+
+private:
+    std::vector<std::unique_ptr<VgeDescriptorAllocator>> m_frameAllocators;
+};
+
+class VgeDescriptorLayoutCache {
+public:
+    VgeDescriptorLayoutCache(VgeDevice& vgeDevice);
+    ~VgeDescriptorLayoutCache();
+    VgeDescriptorLayoutCache(const VgeDescriptorLayoutCache&) = delete;
+    VgeDescriptorLayoutCache& operator=(const VgeDescriptorLayoutCache&) = delete;
+
+    VgeDescriptorSetLayout& getLayout(
+        const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings);
+    size_t size() const;
+
+private:
+    // bindings sorted by binding index, so equal binding sets compare equal
+    struct LayoutKey
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings{};
+
+        bool operator==(const LayoutKey& other) const;
+    };
+
+    struct LayoutKeyHash
+    {
+        size_t operator()(const LayoutKey& key) const;
+    };
+
+    VgeDevice& m_vgeDevice;
+    std::unordered_map<LayoutKey, std::unique_ptr<VgeDescriptorSetLayout>, LayoutKeyHash>
+        m_layouts;
+};
+
+class VgeDescriptorSetCache {
+public:
+    VgeDescriptorSetCache(const VgeDescriptorAllocator::Builder& allocatorBuilder);
+    ~VgeDescriptorSetCache();
+    VgeDescriptorSetCache(const VgeDescriptorSetCache&) = delete;
+    VgeDescriptorSetCache& operator=(const VgeDescriptorSetCache&) = delete;
+
+    bool getDescriptorSet(
+        VgeDescriptorSetLayout& setLayout,
+        const std::vector<VkWriteDescriptorSet>& writes,
+        VkDescriptorSet& set);
+    void invalidateBuffer(VkBuffer buffer);
+    void invalidateImageView(VkImageView imageView);
+    void clear();
+    size_t size() const;
+
+private:
+    // value copy of a single descriptor written, one per array element
+    struct ResourceKey
+    {
+        uint32_t binding{};
+        uint32_t arrayElement{};
+        VkDescriptorType descriptorType{};
+        VkBuffer buffer{};
+        VkDeviceSize offset{};
+        VkDeviceSize range{};
+        VkSampler sampler{};
+        VkImageView imageView{};
+        VkImageLayout imageLayout{};
+
+        bool operator==(const ResourceKey& other) const;
+    };
+
+    struct SetKey
+    {
+        VkDescriptorSetLayout layout{};
+        std::vector<ResourceKey> resources{};
+
+        bool operator==(const SetKey& other) const;
+    };
+
+    struct SetKeyHash
+    {
+        size_t operator()(const SetKey& key) const;
+    };
+
+    void invalidate(VkBuffer buffer, VkImageView imageView);
+
+    std::unique_ptr<VgeDescriptorAllocator> m_allocator;
+    std::unordered_map<SetKey, VkDescriptorSet, SetKeyHash> m_sets;
+    // invalidated sets by layout, reused before allocating
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> m_freeSets;
+};
+
 class VgeDescriptorWriter {
 public:
     VgeDescriptorWriter(VgeDescriptorSetLayout& setLayout, VgeDescriptorPool& pool);
+    VgeDescriptorWriter(VgeDescriptorSetLayout& setLayout, VgeDescriptorAllocator& allocator);
+    VgeDescriptorWriter(VgeDescriptorSetLayout& setLayout);
 
     VgeDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
     VgeDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
 
     bool build(VkDescriptorSet& set);
+    bool build(VkDescriptorSet& set, VgeDescriptorSetCache& cache);
     void overwrite(VkDescriptorSet& set);
 
 private:
     VgeDescriptorSetLayout& m_setLayout;
-    VgeDescriptorPool& m_pool;
+    VgeDescriptorPool* m_pool;
+    VgeDescriptorAllocator* m_allocator;
     std::vector<VkWriteDescriptorSet> m_writes;
 };
 
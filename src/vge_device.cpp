@@ -83,6 +83,7 @@ VgeDevice::VgeDevice(VgeWindow& window) // default constructor
     , m_surface_{}
     , m_graphicsQueue_{}
     , m_presentQueue_{}
+    , m_transferQueue_{}
 {
     createInstance();      // create/initialize the Vulkan instance/library
     setupDebugMessenger(); // validation layers: debug=on, release=off
@@ -130,7 +131,7 @@ void VgeDevice::createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "Vulkan Game Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_1; // vkGetPhysicalDeviceFeatures2 is core in 1.1
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -202,30 +203,67 @@ void VgeDevice::createLogicalDevice()
     QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily,
+                                               indices.presentFamily,
+                                               indices.transferFamily };
 
-    float queuePriority = 1.0f;
+    float queuePriorities[] = { 1.0f, 1.0f };
     for (uint32_t queueFamily : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo queueCreateInfo = {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount =
+            queueFamily == indices.transferFamily ? indices.transferQueueIndex + 1 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    m_multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    // block-compressed textures, VgeTexture falls back to RGBA8 without them
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    std::vector<const char*> enabledExtensions = m_deviceExtensions;
+
+    // bindless resources: descriptor indexing is optional, enable it when present
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    m_descriptorIndexingSupported = queryDescriptorIndexingSupport(indexingFeatures) &&
+                                    supportedFeatures.shaderSampledImageArrayDynamicIndexing &&
+                                    supportedFeatures.shaderStorageBufferArrayDynamicIndexing;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures{};
+    enabledIndexingFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if (m_descriptorIndexingSupported) {
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+        deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+        enabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    }
+    std::cout << "descriptor indexing: " << (m_descriptorIndexingSupported ? "yes" : "no")
+              << std::endl;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = m_descriptorIndexingSupported ? &enabledIndexingFeatures : nullptr;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // might not really be necessary anymore because device specific validation
     // layers have been deprecated
@@ -243,6 +281,19 @@ void VgeDevice::createLogicalDevice()
 
     vkGetDeviceQueue(m_device_, indices.graphicsFamily, 0, &m_graphicsQueue_);
     vkGetDeviceQueue(m_device_, indices.presentFamily, 0, &m_presentQueue_);
+    vkGetDeviceQueue(
+        m_device_,
+        indices.transferFamily,
+        indices.transferQueueIndex,
+        &m_transferQueue_);
+    const char* transferQueue = "shared with graphics";
+    if (indices.transferFamily != indices.graphicsFamily) {
+        transferQueue = "dedicated family";
+    }
+    else if (indices.transferQueueIndex != 0) {
+        transferQueue = "second graphics queue";
+    }
+    std::cout << "transfer queue: " << transferQueue << std::endl;
 }
 
 /* Creates a command pool for managing command buffers
@@ -442,6 +493,67 @@ bool VgeDevice::checkDeviceExtensionSupport(VkPhysicalDevice device)
     return requiredExtensions.empty();
 }
 
+/* Checks if a single device extension is available on a physical device
+ *
+ * This function is used for optional extensions, which unlike the required
+ * ones in m_deviceExtensions don't disqualify a device when missing.
+ */
+bool VgeDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(
+        device,
+        nullptr,
+        &extensionCount,
+        availableExtensions.data());
+
+    for (const VkExtensionProperties& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Queries VK_EXT_descriptor_indexing support of the selected GPU
+ *
+ * This function fills the supported descriptor indexing features and the
+ * indexing limits, and returns true when every feature the bindless
+ * resource model relies on is available.
+ */
+bool VgeDevice::queryDescriptorIndexingSupport(
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexingFeatures)
+{
+    if (m_properties.apiVersion < VK_API_VERSION_1_1 ||
+        !isDeviceExtensionAvailable(m_physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+    m_descriptorIndexingProperties = {};
+    m_descriptorIndexingProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &m_descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties2);
+
+    return indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+           indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+           indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+           indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+           indexingFeatures.descriptorBindingPartiallyBound &&
+           indexingFeatures.runtimeDescriptorArray;
+}
+
 /* Finds queue families for a physical device that support graphics and
  * presentation
  *
@@ -460,7 +572,11 @@ QueueFamilyIndices VgeDevice::findQueueFamilies(VkPhysicalDevice device)
 
     int i = 0;
     for (const VkQueueFamilyProperties& queueFamily : queueFamilies) {
-        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        // compute work such as light culling is recorded into the graphics command buffers
+        VkQueueFlags graphicsFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+        if (queueFamily.queueCount > 0 &&
+            (queueFamily.queueFlags & graphicsFlags) == graphicsFlags)
+        {
             // prevent type conversion
             indices.graphicsFamily = static_cast<uint32_t>(i);
             indices.graphicsFamilyHasValue = true;
@@ -483,6 +599,24 @@ QueueFamilyIndices VgeDevice::findQueueFamilies(VkPhysicalDevice device)
         i++; // still type int on increment
     }
 
+    // uploads prefer a transfer-only family, usually backed by the copy engines
+    indices.transferFamily = indices.graphicsFamily;
+    indices.transferQueueIndex = 0;
+    VkQueueFlags engineFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        const VkQueueFamilyProperties& queueFamily = queueFamilies[family];
+        if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            (queueFamily.queueFlags & engineFlags) == 0)
+        {
+            indices.transferFamily = family;
+            return indices;
+        }
+    }
+    // otherwise a second queue of the graphics family, if it has one
+    if (indices.graphicsFamilyHasValue && queueFamilies[indices.graphicsFamily].queueCount > 1) {
+        indices.transferQueueIndex = 1;
+    }
+
     return indices;
 }
 
@@ -783,6 +917,17 @@ VkQueue VgeDevice::getPresentQueue()
     return m_presentQueue_;
 }
 
+/* Get the transfer queue
+ *
+ * Returns the Vulkan queue used for background uploads, of the family in
+ * findPhysicalQueueFamilies().transferFamily. Without a spare queue it is
+ * the graphics queue itself.
+ */
+VkQueue VgeDevice::getTransferQueue()
+{
+    return m_transferQueue_;
+}
+
 /* Get swap chain support details
  *
  * Queries the physical device for the supported swap chain capabilities,
@@ -803,6 +948,37 @@ QueueFamilyIndices VgeDevice::findPhysicalQueueFamilies()
     return findQueueFamilies(m_physicalDevice);
 }
 
+/* Reports whether bindless descriptor indexing is enabled
+ *
+ * Returns true when VK_EXT_descriptor_indexing and every feature used by
+ * VgeBindlessDescriptors were enabled on the logical device.
+ */
+bool VgeDevice::supportsDescriptorIndexing() const
+{
+    return m_descriptorIndexingSupported;
+}
+
+/* Get the descriptor indexing limits
+ *
+ * Returns the update-after-bind descriptor limits of the physical device.
+ * Only meaningful when supportsDescriptorIndexing() returns true.
+ */
+const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& VgeDevice::getDescriptorIndexingProperties()
+    const
+{
+    return m_descriptorIndexingProperties;
+}
+
+/* Reports whether multi draw indirect is enabled
+ *
+ * Returns true when indirect draw calls may issue more than one draw.
+ * Otherwise every indirect draw has to be recorded with a draw count of 1.
+ */
+bool VgeDevice::supportsMultiDrawIndirect() const
+{
+    return m_multiDrawIndirectSupported;
+}
+
 /* Checks if both graphics and present families have been set.
  *
  * This function returns true if both the graphicsFamily and presentFamily
@@ -17,6 +17,9 @@ struct QueueFamilyIndices
 {
     uint32_t graphicsFamily{};
     uint32_t presentFamily{};
+    // a transfer-only family when there is one, otherwise the graphics family
+    uint32_t transferFamily{};
+    uint32_t transferQueueIndex = 0; // 1 when the graphics family has a spare queue
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
 
@@ -45,6 +48,7 @@ public:
     VkSurfaceKHR getSurface();
     VkQueue getGraphicsQueue();
     VkQueue getPresentQueue();
+    VkQueue getTransferQueue();
     SwapChainSupportDetails getSwapChainSupport();
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -79,6 +83,10 @@ public:
         VkImage& image,
         VkDeviceMemory& imageMemory);
 
+    bool supportsDescriptorIndexing() const;
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& getDescriptorIndexingProperties() const;
+    bool supportsMultiDrawIndirect() const;
+
     VkPhysicalDeviceProperties m_properties;
 
 private:
@@ -97,6 +105,9 @@ private:
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     void hasGflwRequiredInstanceExtensions();
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
+    bool queryDescriptorIndexingSupport(
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexingFeatures);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
     VkInstance m_instance;
@@ -109,6 +120,14 @@ private:
     VkSurfaceKHR m_surface_;
     VkQueue m_graphicsQueue_;
     VkQueue m_presentQueue_;
+    VkQueue m_transferQueue_; // may be the graphics queue, only submitted to by the main thread
+
+    // optional VK_EXT_descriptor_indexing support used by bindless rendering
+    bool m_descriptorIndexingSupported = false;
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_descriptorIndexingProperties{};
+
+    // optional multiDrawIndirect, lets one indirect draw call issue many draws
+    bool m_multiDrawIndirectSupported = false;
 
     const std::vector<const char*> m_validationLayers = { "VK_LAYER_KHRONOS_validation" };
     const std::vector<const char*> m_deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
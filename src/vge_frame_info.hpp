@@ -1,20 +1,28 @@
 #pragma once
 
 #include "vge_camera.hpp"
+#include "vge_descriptors.hpp"
 #include "vge_game_object.hpp"
 
 #include <vulkan/vulkan.h>
 
 namespace vge {
 
-#define MAX_LIGHTS 10
+class VgeLightStore;
 
 struct PointLight
 {
-    glm::vec4 position{}; // ignore w
+    glm::vec4 position{}; // w is billboard radius
     glm::vec4 color{};    // w is intensity
 };
 
+// Start of the per-frame point light storage buffer, followed by numLights PointLights (std430)
+struct PointLightBufferHeader
+{
+    int numLights = 0;
+    int padding[3]{};
+};
+
 struct GlobalUbo // Uniform buffer object
 {
     glm::mat4 projection{ 1.f };
@@ -22,8 +30,18 @@ struct GlobalUbo // Uniform buffer object
     glm::mat4 inverseView{ 1.f };
 
     glm::vec4 ambientLightColor{ 1.f, 1.f, 1.f, .02f }; // w is intensity
-    PointLight pointLights[MAX_LIGHTS];
-    int numLights;
+    glm::vec2 screenExtent{ 1.f, 1.f };                 // pixels, maps fragments to clusters
+    float zNear = 0.1f;
+    float zFar = 100.f;
+};
+
+// Runtime toggles, flipped from the keyboard by VgeKeyboardMovementController
+struct RenderSettings
+{
+    bool deferredShading = false;  // G-buffer and tiled compute lighting instead of forward
+    bool depthPrepass = false;     // forward only, depth-only pass before shading
+    bool occlusionCulling = false; // forward only, skip objects hidden in an earlier frame
+    bool meshletCulling = true;    // forward only, cull full detail meshes per meshlet on the GPU
 };
 
 struct FrameInfo
@@ -34,5 +52,7 @@ struct FrameInfo
     VgeCamera& camera;
     VkDescriptorSet globalDescriptorSet;
     VgeGameObject::Map& gameObjects;
+    VgeLightStore& lightStore;
+    VgeDescriptorAllocator& frameDescriptorAllocator; // reset every time the frame begins
 };
 } // namespace vge
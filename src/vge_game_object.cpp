@@ -110,22 +110,4 @@ glm::mat3 TransformComponent::normalMatrix()
     }
 }
 
-/* Creates a VgeGameObject configured as a point light source.
- *
- * This method constructs a VgeGameObject that acts as a point light, setting
- * its intensity and radius. It initializes the point light component and scales
- * the object based on the provided radius, allowing for realistic lighting
- * effects within the scene.
- */
-VgeGameObject VgeGameObject::makePointLight(float intensity, float radius, glm::vec3 color)
-{
-    VgeGameObject gameObj = VgeGameObject::createGameObject();
-    gameObj.m_color = color;
-    gameObj.m_transform.scale.x = radius;
-    gameObj.m_pointLight = std::make_unique<PointLightComponent>();
-    gameObj.m_pointLight->lightIntensity = intensity;
-
-    return gameObj;
-}
-
 } // namespace vge
@@ -4,10 +4,13 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cstdint>
 #include <memory>
 #include <unordered_map>
 
 namespace vge {
+struct VgeModelAsset;
+
 struct TransformComponent
 {
     glm::vec3 translation{};          // position offset
@@ -21,11 +24,6 @@ struct TransformComponent
     glm::mat3 normalMatrix();
 };
 
-struct PointLightComponent
-{
-    float lightIntensity = 1.0f;
-};
-
 class VgeGameObject {
 public:
     using id_t = unsigned int;
@@ -33,11 +31,6 @@ public:
 
     static VgeGameObject createGameObject();
 
-    static VgeGameObject makePointLight(
-        float intensity = 10.f,
-        float radius = 0.1f,
-        glm::vec3 color = glm::vec3(1.f));
-
     VgeGameObject(const VgeGameObject&) = delete;
     VgeGameObject& operator=(const VgeGameObject&) = delete;
     VgeGameObject(VgeGameObject&&) = default;
@@ -47,10 +40,12 @@ public:
 
     glm::vec3 m_color{};
     TransformComponent m_transform{};
+    uint32_t m_textureIndex = UINT32_MAX; // bindless sampled image slot, UINT32_MAX for none
 
     // Optional pointer components
     std::shared_ptr<VgeModel> m_model{};
-    std::unique_ptr<PointLightComponent> m_pointLight = nullptr;
+    // streamed model, see VgeAssetManager::attachModel, m_model is set from it once resident
+    std::shared_ptr<VgeModelAsset> m_modelAsset{};
 
 private:
     VgeGameObject(id_t objId);
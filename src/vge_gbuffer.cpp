@@ -0,0 +1,193 @@
+#include "vge_gbuffer.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <stdexcept>
+
+namespace vge {
+
+/* Constructs a VgeGBuffer object.
+ *
+ * Allocates the normal, albedo and depth attachments the geometry pass
+ * renders into, the lighting storage image, and a framebuffer binding the
+ * attachments to the deferred geometry render pass.
+ */
+VgeGBuffer::VgeGBuffer(
+    VgeDevice& device,
+    VkRenderPass renderPass,
+    VkFormat depthFormat,
+    VkExtent2D extent)
+    : m_vgeDevice{ device }
+    , m_extent{ extent }
+    , m_normal{}
+    , m_albedo{}
+    , m_depth{}
+    , m_lighting{}
+    , m_framebuffer{}
+{
+    createAttachment(
+        NORMAL_FORMAT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        m_normal);
+    createAttachment(
+        ALBEDO_FORMAT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        m_albedo);
+    createAttachment(
+        depthFormat,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_DEPTH_BIT,
+        m_depth);
+    createAttachment(
+        LIGHTING_FORMAT,
+        VK_IMAGE_USAGE_STORAGE_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        m_lighting);
+    createFramebuffer(renderPass);
+}
+
+/* Destroys the VgeGBuffer object.
+ *
+ * Releases the framebuffer and every attachment image, view and memory.
+ */
+VgeGBuffer::~VgeGBuffer()
+{
+    vkDestroyFramebuffer(m_vgeDevice.getDevice(), m_framebuffer, nullptr);
+    destroyAttachment(m_normal);
+    destroyAttachment(m_albedo);
+    destroyAttachment(m_depth);
+    destroyAttachment(m_lighting);
+}
+
+/* Creates one device local image of the G-buffer and its view.
+ *
+ * Every attachment covers the full extent with a single mip level and
+ * sample, so the lighting pass can address them with the same pixel
+ * coordinates.
+ */
+void VgeGBuffer::createAttachment(
+    VkFormat format,
+    VkImageUsageFlags usage,
+    VkImageAspectFlags aspectMask,
+    Attachment& attachment)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = m_extent.width;
+    imageInfo.extent.height = m_extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    m_vgeDevice.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        attachment.image,
+        attachment.memory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = attachment.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspectMask;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(m_vgeDevice.getDevice(), &viewInfo, nullptr, &attachment.view) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create G-buffer image view!");
+    }
+}
+
+// Destroys one G-buffer image, its view and its memory.
+void VgeGBuffer::destroyAttachment(Attachment& attachment)
+{
+    vkDestroyImageView(m_vgeDevice.getDevice(), attachment.view, nullptr);
+    vkDestroyImage(m_vgeDevice.getDevice(), attachment.image, nullptr);
+    vkFreeMemory(m_vgeDevice.getDevice(), attachment.memory, nullptr);
+    attachment = Attachment{};
+}
+
+/* Creates the framebuffer of the geometry pass.
+ *
+ * Attachment order matches the deferred render pass: normal, albedo, depth.
+ * The lighting image is only written by compute and is not part of it.
+ */
+void VgeGBuffer::createFramebuffer(VkRenderPass renderPass)
+{
+    std::array<VkImageView, 3> attachments = { m_normal.view, m_albedo.view, m_depth.view };
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = m_extent.width;
+    framebufferInfo.height = m_extent.height;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(m_vgeDevice.getDevice(), &framebufferInfo, nullptr, &m_framebuffer) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create G-buffer framebuffer!");
+    }
+}
+
+// Returns the framebuffer of the geometry pass.
+VkFramebuffer VgeGBuffer::getFramebuffer() const
+{
+    return m_framebuffer;
+}
+
+// Returns the extent every attachment was created with.
+VkExtent2D VgeGBuffer::getExtent() const
+{
+    return m_extent;
+}
+
+// Returns the view of the world space normal attachment.
+VkImageView VgeGBuffer::getNormalView() const
+{
+    return m_normal.view;
+}
+
+// Returns the view of the albedo attachment.
+VkImageView VgeGBuffer::getAlbedoView() const
+{
+    return m_albedo.view;
+}
+
+// Returns the depth only view of the depth attachment.
+VkImageView VgeGBuffer::getDepthView() const
+{
+    return m_depth.view;
+}
+
+// Returns the storage image the lighting pass writes into.
+VkImage VgeGBuffer::getLightingImage() const
+{
+    return m_lighting.image;
+}
+
+// Returns the view of the lighting storage image.
+VkImageView VgeGBuffer::getLightingView() const
+{
+    return m_lighting.view;
+}
+
+} // namespace vge
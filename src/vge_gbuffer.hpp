@@ -0,0 +1,60 @@
+#pragma once
+
+#include "vge_device.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+namespace vge {
+
+// Render targets of the deferred path: world normals, albedo and depth written by the geometry
+// pass, plus the storage image the tiled lighting pass writes the shaded result into
+class VgeGBuffer {
+public:
+    static constexpr VkFormat NORMAL_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static constexpr VkFormat ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr VkFormat LIGHTING_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    VgeGBuffer(
+        VgeDevice& device,
+        VkRenderPass renderPass,
+        VkFormat depthFormat,
+        VkExtent2D extent);
+    ~VgeGBuffer();
+
+    VgeGBuffer(const VgeGBuffer&) = delete;
+    VgeGBuffer& operator=(const VgeGBuffer&) = delete;
+
+    VkFramebuffer getFramebuffer() const;
+    VkExtent2D getExtent() const;
+    VkImageView getNormalView() const;
+    VkImageView getAlbedoView() const;
+    VkImageView getDepthView() const;
+    VkImage getLightingImage() const;
+    VkImageView getLightingView() const;
+
+private:
+    struct Attachment
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    void createAttachment(
+        VkFormat format,
+        VkImageUsageFlags usage,
+        VkImageAspectFlags aspectMask,
+        Attachment& attachment);
+    void destroyAttachment(Attachment& attachment);
+    void createFramebuffer(VkRenderPass renderPass);
+
+    VgeDevice& m_vgeDevice;
+    VkExtent2D m_extent;
+    Attachment m_normal;
+    Attachment m_albedo;
+    Attachment m_depth;
+    Attachment m_lighting;
+    VkFramebuffer m_framebuffer;
+};
+
+} // namespace vge
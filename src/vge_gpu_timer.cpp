@@ -0,0 +1,148 @@
+#include "vge_gpu_timer.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cassert>
+#include <stdexcept>
+
+namespace vge {
+
+/* Constructs a VgeGpuTimer object.
+ *
+ * Creates one timestamp query pool per frame in flight. Devices that
+ * cannot write timestamps on graphics and compute queues leave the timer
+ * disabled, every scope then reads as zero.
+ */
+VgeGpuTimer::VgeGpuTimer(VgeDevice& device, int frameCount)
+    : m_vgeDevice{ device }
+    , m_supported{ device.m_properties.limits.timestampComputeAndGraphics == VK_TRUE }
+    , m_timestampPeriod{ device.m_properties.limits.timestampPeriod }
+    , m_queryPools(static_cast<size_t>(frameCount), VK_NULL_HANDLE)
+    , m_recordedScopes(static_cast<size_t>(frameCount), 0)
+    , m_scopeMilliseconds{}
+    , m_frameIndex{ 0 }
+{
+    if (!m_supported) {
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = MAX_SCOPES * 2;
+
+    for (VkQueryPool& queryPool : m_queryPools) {
+        if (vkCreateQueryPool(m_vgeDevice.getDevice(), &queryPoolInfo, nullptr, &queryPool) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create timestamp query pool!");
+        }
+    }
+}
+
+/* Destroys the VgeGpuTimer object.
+ *
+ * Releases the timestamp query pools.
+ */
+VgeGpuTimer::~VgeGpuTimer()
+{
+    for (VkQueryPool queryPool : m_queryPools) {
+        vkDestroyQueryPool(m_vgeDevice.getDevice(), queryPool, nullptr);
+    }
+}
+
+/* Starts timing a new frame.
+ *
+ * Reads back the scopes this frame index recorded last time, which have
+ * completed since its fence was waited on, then resets its queries. Must be
+ * recorded outside any render pass, before the frame's first scope.
+ */
+void VgeGpuTimer::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+{
+    m_frameIndex = frameIndex;
+    if (!m_supported) {
+        return;
+    }
+
+    VkQueryPool queryPool = m_queryPools[frameIndex];
+    uint32_t& recordedScopes = m_recordedScopes[frameIndex];
+    for (uint32_t scope = 0; scope < MAX_SCOPES; scope++) {
+        if ((recordedScopes & (1u << scope)) == 0) {
+            continue;
+        }
+        std::array<uint64_t, 2> timestamps{};
+        if (vkGetQueryPoolResults(
+                m_vgeDevice.getDevice(),
+                queryPool,
+                scope * 2,
+                2,
+                sizeof(timestamps),
+                timestamps.data(),
+                sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            m_scopeMilliseconds[scope] =
+                static_cast<float>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6f;
+        }
+    }
+    recordedScopes = 0;
+
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, MAX_SCOPES * 2);
+}
+
+/* Writes the start timestamp of a scope.
+ *
+ * The timestamp is taken once all previously recorded commands started.
+ */
+void VgeGpuTimer::beginScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    assert(scope < MAX_SCOPES && "GPU timer scope out of range!");
+    if (!m_supported) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        m_queryPools[m_frameIndex],
+        scope * 2);
+}
+
+/* Writes the end timestamp of a scope.
+ *
+ * The timestamp is taken once all previously recorded commands completed,
+ * so the scope covers the full execution of the commands in between.
+ */
+void VgeGpuTimer::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    assert(scope < MAX_SCOPES && "GPU timer scope out of range!");
+    if (!m_supported) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(
+        commandBuffer,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        m_queryPools[m_frameIndex],
+        scope * 2 + 1);
+    m_recordedScopes[m_frameIndex] |= 1u << scope;
+}
+
+// Returns whether the device can write timestamps.
+bool VgeGpuTimer::isSupported() const
+{
+    return m_supported;
+}
+
+/* Get the GPU time of a scope in milliseconds.
+ *
+ * This is the latest completed measurement, which lags the frame being
+ * recorded by MAX_FRAMES_IN_FLIGHT frames.
+ */
+float VgeGpuTimer::getScopeMilliseconds(uint32_t scope) const
+{
+    assert(scope < MAX_SCOPES && "GPU timer scope out of range!");
+    return m_scopeMilliseconds[scope];
+}
+
+} // namespace vge
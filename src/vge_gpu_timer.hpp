@@ -0,0 +1,42 @@
+#pragma once
+
+#include "vge_device.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace vge {
+
+// Measures GPU time of command buffer ranges with timestamp queries. Results of a frame are read
+// back the next time its frame index begins, once its fence has been waited on
+class VgeGpuTimer {
+public:
+    static constexpr uint32_t MAX_SCOPES = 8;
+
+    VgeGpuTimer(VgeDevice& device, int frameCount);
+    ~VgeGpuTimer();
+
+    VgeGpuTimer(const VgeGpuTimer&) = delete;
+    VgeGpuTimer& operator=(const VgeGpuTimer&) = delete;
+
+    void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+    void beginScope(VkCommandBuffer commandBuffer, uint32_t scope);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    bool isSupported() const;
+    float getScopeMilliseconds(uint32_t scope) const;
+
+private:
+    VgeDevice& m_vgeDevice;
+    bool m_supported;
+    float m_timestampPeriod; // nanoseconds per timestamp tick
+    std::vector<VkQueryPool> m_queryPools;  // one per frame in flight, two queries per scope
+    std::vector<uint32_t> m_recordedScopes; // per frame, bit per scope ended in its last recording
+    std::array<float, MAX_SCOPES> m_scopeMilliseconds;
+    int m_frameIndex;
+};
+
+} // namespace vge
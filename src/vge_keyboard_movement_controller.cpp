@@ -69,4 +69,39 @@ void VgeKeyboardMovementController::moveInPlaneXZ(
         gameObject.m_transform.translation += m_moveSpeed * dt * glm::normalize(moveDir);
     }
 }
+
+/* Flips render settings from keyboard input.
+ *
+ * A toggle only fires on the frame its key goes down, so holding the key
+ * does not flip the setting back and forth every frame.
+ */
+void VgeKeyboardMovementController::updateRenderSettings(
+    GLFWwindow* window,
+    RenderSettings& settings)
+{
+    if (wasKeyPressed(window, m_keys.toggleDeferredShading, m_deferredToggleHeld)) {
+        settings.deferredShading = !settings.deferredShading;
+    }
+    if (wasKeyPressed(window, m_keys.toggleDepthPrepass, m_depthPrepassToggleHeld)) {
+        settings.depthPrepass = !settings.depthPrepass;
+    }
+    if (wasKeyPressed(window, m_keys.toggleOcclusionCulling, m_occlusionCullingToggleHeld)) {
+        settings.occlusionCulling = !settings.occlusionCulling;
+    }
+    if (wasKeyPressed(window, m_keys.toggleMeshletCulling, m_meshletCullingToggleHeld)) {
+        settings.meshletCulling = !settings.meshletCulling;
+    }
+}
+
+/* Checks whether a key went down since the previous check.
+ *
+ * held tracks the key's state between calls and is updated.
+ */
+bool VgeKeyboardMovementController::wasKeyPressed(GLFWwindow* window, int key, bool& held)
+{
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool wasPressed = pressed && !held;
+    held = pressed;
+    return wasPressed;
+}
 } // namespace vge
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "vge_frame_info.hpp"
 #include "vge_game_object.hpp"
 
 namespace vge {
@@ -17,12 +18,26 @@ public:
         int lookRight = GLFW_KEY_RIGHT;
         int lookUp = GLFW_KEY_UP;
         int lookDown = GLFW_KEY_DOWN;
+        int toggleDeferredShading = GLFW_KEY_F1;
+        int toggleDepthPrepass = GLFW_KEY_F2;
+        int toggleOcclusionCulling = GLFW_KEY_F3;
+        int toggleMeshletCulling = GLFW_KEY_F4;
     };
 
     void moveInPlaneXZ(GLFWwindow* window, float dt, VgeGameObject& gameObject);
+    void updateRenderSettings(GLFWwindow* window, RenderSettings& settings);
 
     KeyMappings m_keys{};
     float m_moveSpeed{ 3.f };
     float m_lookSpeed{ 1.5f };
+
+private:
+    bool wasKeyPressed(GLFWwindow* window, int key, bool& held);
+
+    // toggles fire on press, not every frame the key is held
+    bool m_deferredToggleHeld{ false };
+    bool m_depthPrepassToggleHeld{ false };
+    bool m_occlusionCullingToggleHeld{ false };
+    bool m_meshletCullingToggleHeld{ false };
 };
 } // namespace vge
@@ -0,0 +1,127 @@
+#include "vge_light_store.hpp"
+
+#include <cassert>
+#include <cmath>
+
+namespace vge {
+
+/* Constructs an empty VgeLightStore.
+ *
+ * Lights are added with addLight, which hands out the ids used to remove
+ * them later.
+ */
+VgeLightStore::VgeLightStore()
+    : m_positionX{}
+    , m_positionY{}
+    , m_positionZ{}
+    , m_radius{}
+    , m_colorR{}
+    , m_colorG{}
+    , m_colorB{}
+    , m_intensity{}
+    , m_ids{}
+    , m_indices{}
+    , m_nextId{ 0 }
+{}
+
+/* Adds a point light to the store.
+ *
+ * Returns a stable id for the light. Dense indices change when other lights
+ * are removed, ids never do.
+ */
+VgeLightStore::id_t VgeLightStore::addLight(
+    glm::vec3 position,
+    glm::vec3 color,
+    float intensity,
+    float radius)
+{
+    id_t id = m_nextId++;
+    m_indices[id] = m_ids.size();
+    m_ids.push_back(id);
+
+    m_positionX.push_back(position.x);
+    m_positionY.push_back(position.y);
+    m_positionZ.push_back(position.z);
+    m_radius.push_back(radius);
+    m_colorR.push_back(color.r);
+    m_colorG.push_back(color.g);
+    m_colorB.push_back(color.b);
+    m_intensity.push_back(intensity);
+    return id;
+}
+
+/* Removes a point light from the store.
+ *
+ * The last light is moved into the removed light's slot, keeping the arrays
+ * dense without shifting every following light.
+ */
+void VgeLightStore::removeLight(id_t id)
+{
+    assert(m_indices.count(id) == 1 && "Removing a light that is not in the store!");
+
+    size_t index = m_indices[id];
+    size_t last = m_ids.size() - 1;
+    if (index != last) {
+        m_positionX[index] = m_positionX[last];
+        m_positionY[index] = m_positionY[last];
+        m_positionZ[index] = m_positionZ[last];
+        m_radius[index] = m_radius[last];
+        m_colorR[index] = m_colorR[last];
+        m_colorG[index] = m_colorG[last];
+        m_colorB[index] = m_colorB[last];
+        m_intensity[index] = m_intensity[last];
+        m_ids[index] = m_ids[last];
+        m_indices[m_ids[index]] = index;
+    }
+
+    m_positionX.pop_back();
+    m_positionY.pop_back();
+    m_positionZ.pop_back();
+    m_radius.pop_back();
+    m_colorR.pop_back();
+    m_colorG.pop_back();
+    m_colorB.pop_back();
+    m_intensity.pop_back();
+    m_ids.pop_back();
+    m_indices.erase(id);
+}
+
+/* Get the number of point lights.
+ *
+ * Dense indices of the store range from 0 to size() - 1.
+ */
+size_t VgeLightStore::size() const
+{
+    return m_ids.size();
+}
+
+/* Rotates lights [begin, end) about the scene's y axis and packs them.
+ *
+ * Animates and packs in one pass: each light is rotated by angle around
+ * -y, the rotation only touching x and z, and written out as a PointLight
+ * ready for the light buffer. The loop walks plain float arrays with no
+ * branches so the compiler can vectorize it. Ranges may be processed
+ * concurrently as long as they don't overlap.
+ */
+void VgeLightStore::rotateAndPack(size_t begin, size_t end, float angle, PointLight* packed)
+{
+    assert(end <= size() && "Light range out of bounds!");
+
+    // glm::rotate(angle, {0, -1, 0}) reduced to the two coefficients it uses
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+
+    float* positionX = m_positionX.data();
+    float* positionZ = m_positionZ.data();
+    for (size_t i = begin; i < end; i++) {
+        float x = c * positionX[i] - s * positionZ[i];
+        float z = s * positionX[i] + c * positionZ[i];
+        positionX[i] = x;
+        positionZ[i] = z;
+
+        packed[i].position = glm::vec4(x, m_positionY[i], z, m_radius[i]);
+        packed[i].color = glm::vec4(m_colorR[i], m_colorG[i], m_colorB[i], m_intensity[i]);
+    }
+}
+
+} // namespace vge
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "vge_frame_info.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vge {
+
+// Point lights stored densely as structure of arrays, separate from game objects
+class VgeLightStore {
+public:
+    using id_t = uint32_t;
+
+    VgeLightStore();
+
+    VgeLightStore(const VgeLightStore&) = delete;
+    VgeLightStore& operator=(const VgeLightStore&) = delete;
+
+    id_t addLight(
+        glm::vec3 position,
+        glm::vec3 color = glm::vec3(1.f),
+        float intensity = 10.f,
+        float radius = 0.1f);
+    void removeLight(id_t id);
+    size_t size() const;
+
+    void rotateAndPack(size_t begin, size_t end, float angle, PointLight* packed);
+
+private:
+    // one entry per light, removal swaps the last light into the hole
+    std::vector<float> m_positionX;
+    std::vector<float> m_positionY;
+    std::vector<float> m_positionZ;
+    std::vector<float> m_radius;
+    std::vector<float> m_colorR;
+    std::vector<float> m_colorG;
+    std::vector<float> m_colorB;
+    std::vector<float> m_intensity;
+
+    std::vector<id_t> m_ids;                    // dense index -> id
+    std::unordered_map<id_t, size_t> m_indices; // id -> dense index
+    id_t m_nextId;
+};
+
+} // namespace vge
@@ -0,0 +1,431 @@
+#include "vge_mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace vge {
+
+/* Scores a vertex for the cache optimization, following Forsyth.
+ *
+ * Vertices still in the cache score by how recently they were used, the
+ * last triangle's three equally. Vertices with few triangles left are
+ * boosted so they are finished off rather than left as stragglers.
+ */
+static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0) {
+        return -1.f; // no triangle left that could use it
+    }
+
+    float score = 0.f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = 0.75f;
+        }
+        else {
+            constexpr float scale = 1.f / (VgeMeshOptimizer::SCORING_CACHE_SIZE - 3);
+            score = std::pow(1.f - static_cast<float>(cachePosition - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+}
+
+/* Reorders triangles for the post-transform vertex cache.
+ *
+ * Greedy optimization after Tom Forsyth's linear-speed algorithm: the next
+ * triangle is the best scoring one around the simulated cache, falling back
+ * to the next unused triangle in the input when none is left there. Runs
+ * in time linear in the number of triangles.
+ */
+void VgeMeshOptimizer::optimizeVertexCache(
+    uint32_t* indices,
+    size_t indexCount,
+    size_t vertexCount)
+{
+    assert(indexCount % 3 == 0 && "Index count must be a multiple of 3");
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // triangles of each vertex, the first remainingTriangles of them not yet emitted
+    std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        remainingTriangles[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + remainingTriangles[vertex];
+    }
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        vertexScores[vertex] = vertexScore(-1, remainingTriangles[vertex]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        triangleScores[triangle] = vertexScores[indices[triangle * 3 + 0]] +
+                                   vertexScores[indices[triangle * 3 + 1]] +
+                                   vertexScores[indices[triangle * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output(indexCount);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache{};
+    std::vector<uint32_t> newCache{};
+    cache.reserve(SCORING_CACHE_SIZE + 3);
+    newCache.reserve(SCORING_CACHE_SIZE + 3);
+
+    constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+    uint32_t bestTriangle = static_cast<uint32_t>(
+        std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+    size_t inputCursor = 0;
+    for (size_t outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++) {
+        if (bestTriangle == none) {
+            // dead end, nothing around the cache, continue with the input order
+            while (emitted[inputCursor]) {
+                inputCursor++;
+            }
+            bestTriangle = static_cast<uint32_t>(inputCursor);
+        }
+
+        std::array<uint32_t, 3> triangle{ indices[bestTriangle * 3 + 0],
+                                           indices[bestTriangle * 3 + 1],
+                                           indices[bestTriangle * 3 + 2] };
+        output[outputTriangle * 3 + 0] = triangle[0];
+        output[outputTriangle * 3 + 1] = triangle[1];
+        output[outputTriangle * 3 + 2] = triangle[2];
+        emitted[bestTriangle] = true;
+
+        // take the triangle out of its vertices' remaining triangles
+        for (uint32_t vertex : triangle) {
+            uint32_t* first = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t* last = first + remainingTriangles[vertex];
+            uint32_t* found = std::find(first, last, bestTriangle);
+            if (found != last) {
+                std::swap(*found, *(last - 1));
+                remainingTriangles[vertex]--;
+            }
+        }
+
+        // the triangle's vertices move to the front of the cache
+        newCache.assign(triangle.begin(), triangle.end());
+        for (uint32_t vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                newCache.push_back(vertex);
+            }
+        }
+        for (size_t position = SCORING_CACHE_SIZE; position < newCache.size(); position++) {
+            cachePositions[newCache[position]] = -1; // evicted
+        }
+        newCache.resize(std::min<size_t>(newCache.size(), SCORING_CACHE_SIZE));
+        for (size_t position = 0; position < newCache.size(); position++) {
+            cachePositions[newCache[position]] = static_cast<int32_t>(position);
+        }
+
+        // rescore vertices whose cache position or remaining triangles changed, evicted
+        // vertices included, and pick the best triangle around them
+        for (uint32_t vertex : cache) {
+            if (cachePositions[vertex] < 0) {
+                vertexScores[vertex] = vertexScore(-1, remainingTriangles[vertex]);
+            }
+        }
+        for (uint32_t vertex : newCache) {
+            vertexScores[vertex] = vertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+        }
+        bestTriangle = none;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (uint32_t vertex : newCache) {
+            for (uint32_t a = adjacencyOffsets[vertex];
+                 a < adjacencyOffsets[vertex] + remainingTriangles[vertex];
+                 a++)
+            {
+                uint32_t candidate = adjacency[a];
+                float score = vertexScores[indices[candidate * 3 + 0]] +
+                              vertexScores[indices[candidate * 3 + 1]] +
+                              vertexScores[indices[candidate * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = candidate;
+                }
+            }
+        }
+        cache.swap(newCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+/* Reorders clusters of triangles to reduce overdraw.
+ *
+ * The cache optimized order is split into clusters wherever a triangle
+ * misses the simulated cache with all three vertices, so reordering whole
+ * clusters barely changes the cache hit rate. Clusters facing away from the
+ * mesh center are drawn first, as they tend to occlude the ones behind.
+ */
+void VgeMeshOptimizer::optimizeOverdraw(
+    uint32_t* indices,
+    size_t indexCount,
+    const std::vector<VgeModel::Vertex>& vertices)
+{
+    assert(indexCount % 3 == 0 && "Index count must be a multiple of 3");
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // cluster starts, simulating the FIFO through the time a vertex was last loaded
+    std::vector<uint32_t> clusterStarts{ 0 };
+    std::vector<uint32_t> loadTimes(vertices.size(), 0);
+    uint32_t time = VERTEX_CACHE_SIZE + 1;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        uint32_t misses = 0;
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t vertex = indices[triangle * 3 + corner];
+            if (time - loadTimes[vertex] > VERTEX_CACHE_SIZE) {
+                loadTimes[vertex] = time++;
+                misses++;
+            }
+        }
+        if (misses == 3 && triangle > 0) {
+            clusterStarts.push_back(static_cast<uint32_t>(triangle));
+        }
+    }
+    clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2) {
+        return;
+    }
+
+    // area weighted centroid and normal of every cluster and of the whole mesh
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3{ 0.f });
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3{ 0.f });
+    glm::vec3 meshCentroid{ 0.f };
+    float meshArea = 0.f;
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        float clusterArea = 0.f;
+        for (uint32_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1];
+             triangle++)
+        {
+            const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].position;
+            const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+            float area = glm::length(normal);
+            clusterCentroids[cluster] += (p0 + p1 + p2) * (area / 3.f);
+            clusterNormals[cluster] += normal;
+            clusterArea += area;
+        }
+        meshCentroid += clusterCentroids[cluster];
+        meshArea += clusterArea;
+        if (clusterArea > 0.f) {
+            clusterCentroids[cluster] /= clusterArea;
+        }
+    }
+    if (meshArea > 0.f) {
+        meshCentroid /= meshArea;
+    }
+
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        float normalLength = glm::length(clusterNormals[cluster]);
+        sortKeys[cluster] = normalLength > 0.f ? glm::dot(
+                                                     clusterCentroids[cluster] - meshCentroid,
+                                                     clusterNormals[cluster] / normalLength)
+                                               : 0.f;
+    }
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&sortKeys](uint32_t lhs, uint32_t rhs)
+        {
+            return sortKeys[lhs] > sortKeys[rhs];
+        });
+
+    std::vector<uint32_t> output{};
+    output.reserve(indexCount);
+    for (uint32_t cluster : order) {
+        output.insert(
+            output.end(),
+            indices + clusterStarts[cluster] * 3,
+            indices + clusterStarts[cluster + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+/* Reorders vertices in the order the indices first use them.
+ *
+ * Vertex fetches then walk the vertex buffer mostly forward. Vertices no
+ * index refers to are dropped, and the indices are remapped.
+ */
+void VgeMeshOptimizer::optimizeVertexFetch(
+    std::vector<VgeModel::Vertex>& vertices,
+    std::vector<uint32_t>& indices)
+{
+    constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertices.size(), none);
+    std::vector<VgeModel::Vertex> output{};
+    output.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == none) {
+            remap[index] = static_cast<uint32_t>(output.size());
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(output);
+}
+
+/* Computes the bounds of a meshlet over the index range [begin, end).
+ *
+ * The bounding sphere is centered on the box around the meshlet's
+ * vertices. The cone axis is the average triangle normal, and its w the
+ * sine of the largest angle a normal makes with it. A cone spreading too
+ * wide gets a sine of 1, which never culls.
+ */
+static VgeModel::Meshlet makeMeshlet(
+    const std::vector<VgeModel::Vertex>& vertices,
+    const uint32_t* indices,
+    size_t begin,
+    size_t end,
+    const std::vector<uint32_t>& meshletVertices)
+{
+    glm::vec3 boundsMin = vertices[meshletVertices[0]].position;
+    glm::vec3 boundsMax = boundsMin;
+    for (uint32_t vertex : meshletVertices) {
+        boundsMin = glm::min(boundsMin, vertices[vertex].position);
+        boundsMax = glm::max(boundsMax, vertices[vertex].position);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * .5f;
+    float radius = 0.f;
+    for (uint32_t vertex : meshletVertices) {
+        radius = std::max(radius, glm::length(vertices[vertex].position - center));
+    }
+
+    std::vector<glm::vec3> normals{};
+    glm::vec3 axis{ 0.f };
+    for (size_t i = begin; i < end; i += 3) {
+        const glm::vec3& p0 = vertices[indices[i + 0]].position;
+        const glm::vec3& p1 = vertices[indices[i + 1]].position;
+        const glm::vec3& p2 = vertices[indices[i + 2]].position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0.f) {
+            normals.push_back(normal / length);
+            axis += normal / length;
+        }
+    }
+    float axisLength = glm::length(axis);
+    float coneSine = 1.f;
+    if (axisLength > 0.f) {
+        axis = axis / axisLength;
+        float minDot = 1.f;
+        for (const glm::vec3& normal : normals) {
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        }
+        // past about 84 degrees the cone would almost never cull
+        coneSine = minDot > .1f ? std::sqrt(1.f - minDot * minDot) : 1.f;
+    }
+
+    VgeModel::Meshlet meshlet{};
+    meshlet.boundingSphere = glm::vec4(center, radius);
+    meshlet.cone = glm::vec4(axis, coneSine);
+    meshlet.firstIndex = static_cast<uint32_t>(begin);
+    meshlet.indexCount = static_cast<uint32_t>(end - begin);
+    return meshlet;
+}
+
+/* Splits triangles into meshlets in their current order.
+ *
+ * Triangles are added to the open meshlet until it would exceed maxVertices
+ * unique vertices or maxTriangles triangles, so a cache optimized order
+ * gives compact meshlets, and each meshlet stays a contiguous index range.
+ * firstIndex is added to the ranges, for meshes that do not start the
+ * index buffer.
+ */
+std::vector<VgeModel::Meshlet> VgeMeshOptimizer::buildMeshlets(
+    const std::vector<VgeModel::Vertex>& vertices,
+    const uint32_t* indices,
+    size_t indexCount,
+    uint32_t firstIndex,
+    uint32_t maxVertices,
+    uint32_t maxTriangles)
+{
+    assert(indexCount % 3 == 0 && "Index count must be a multiple of 3");
+    assert(maxVertices >= 3 && maxTriangles >= 1 && "Meshlet limits too small");
+
+    // vertexMarks[v] is the meshlet count + 1 while v is in the open meshlet
+    std::vector<uint32_t> vertexMarks(vertices.size(), 0);
+    std::vector<uint32_t> meshletVertices{};
+    std::vector<VgeModel::Meshlet> meshlets{};
+    size_t meshletStart = 0;
+    for (size_t i = 0; i < indexCount; i += 3) {
+        uint32_t newVertices = 0;
+        for (size_t corner = 0; corner < 3; corner++) {
+            newVertices += vertexMarks[indices[i + corner]] != meshlets.size() + 1 ? 1 : 0;
+        }
+        if (meshletVertices.size() + newVertices > maxVertices ||
+            (i - meshletStart) / 3 >= maxTriangles)
+        {
+            meshlets.push_back(makeMeshlet(vertices, indices, meshletStart, i, meshletVertices));
+            meshletVertices.clear();
+            meshletStart = i;
+        }
+
+        uint32_t mark = static_cast<uint32_t>(meshlets.size()) + 1;
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t vertex = indices[i + corner];
+            if (vertexMarks[vertex] != mark) {
+                vertexMarks[vertex] = mark;
+                meshletVertices.push_back(vertex);
+            }
+        }
+    }
+    if (meshletStart < indexCount) {
+        meshlets.push_back(
+            makeMeshlet(vertices, indices, meshletStart, indexCount, meshletVertices));
+    }
+
+    for (VgeModel::Meshlet& meshlet : meshlets) {
+        meshlet.firstIndex += firstIndex;
+    }
+    return meshlets;
+}
+
+/* Computes the average cache miss ratio of an index buffer.
+ *
+ * The vertices transformed per triangle with a FIFO post-transform cache of
+ * VERTEX_CACHE_SIZE entries. 3 means no reuse at all, around 0.5 is the
+ * best a regular grid allows.
+ */
+float VgeMeshOptimizer::computeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    if (indexCount < 3) {
+        return 0.f;
+    }
+
+    std::vector<uint32_t> loadTimes(vertexCount, 0);
+    uint32_t time = VERTEX_CACHE_SIZE + 1;
+    uint32_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (time - loadTimes[indices[i]] > VERTEX_CACHE_SIZE) {
+            loadTimes[indices[i]] = time++;
+            misses++;
+        }
+    }
+    return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
+
+} // namespace vge
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vge_model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vge {
+
+// Import time processing of index and vertex buffers for the GPU: triangles are ordered for the
+// post-transform vertex cache, then in clusters against overdraw, vertices in the order they are
+// first fetched, and the result can be split into meshlets for fine grained culling
+class VgeMeshOptimizer {
+public:
+    // FIFO size assumed when simulating the post-transform cache
+    static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+    // positions scored by the cache optimization, larger than the FIFO to plan ahead
+    static constexpr uint32_t SCORING_CACHE_SIZE = 32;
+
+    static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+    static void optimizeOverdraw(
+        uint32_t* indices,
+        size_t indexCount,
+        const std::vector<VgeModel::Vertex>& vertices);
+    static void optimizeVertexFetch(
+        std::vector<VgeModel::Vertex>& vertices,
+        std::vector<uint32_t>& indices);
+
+    static std::vector<VgeModel::Meshlet> buildMeshlets(
+        const std::vector<VgeModel::Vertex>& vertices,
+        const uint32_t* indices,
+        size_t indexCount,
+        uint32_t firstIndex,
+        uint32_t maxVertices,
+        uint32_t maxTriangles);
+
+    static float computeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+};
+
+} // namespace vge
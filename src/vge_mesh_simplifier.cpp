@@ -0,0 +1,343 @@
+#include "vge_mesh_simplifier.hpp"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace vge {
+
+/* Constructs a VgeMeshSimplifier for an indexed triangle mesh.
+ *
+ * Welds vertices by position, accumulates the plane quadric of every
+ * triangle on its welded vertices and locks open border vertices. The
+ * vertices are referenced, not copied, and must outlive the simplifier.
+ */
+VgeMeshSimplifier::VgeMeshSimplifier(
+    const std::vector<VgeModel::Vertex>& vertices,
+    const std::vector<uint32_t>& indices)
+    : m_vertices{ vertices }
+    , m_indices{ indices }
+    , m_welds{}
+    , m_weldVertices{}
+    , m_quadrics{}
+    , m_locked{}
+    , m_adjacencyOffsets{}
+    , m_adjacency{}
+    , m_error{ 0.0 }
+{
+    assert(m_indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+    weldPositions();
+    computeQuadrics();
+    lockBorders();
+}
+
+/* Simplifies the mesh until it has at most targetIndexCount indices.
+ *
+ * Runs passes of independent collapses, cheapest first, until the target is
+ * reached or no collapse is left that keeps triangles from flipping. Every
+ * call continues from the previous result, so a chain of calls with falling
+ * targets builds successive LODs. Returns the error of the result, the
+ * square root of the largest collapse cost, roughly the model space
+ * distance the surface moved.
+ */
+float VgeMeshSimplifier::simplify(size_t targetIndexCount)
+{
+    constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    std::vector<Collapse> collapses{};
+    std::vector<bool> touched(m_vertices.size());
+    std::vector<uint32_t> collapseTargets(m_vertices.size(), none);
+    while (m_indices.size() > targetIndexCount) {
+        buildAdjacency();
+
+        // cheapest direction of every edge, an edge shows up once per triangle using it
+        collapses.clear();
+        for (size_t i = 0; i < m_indices.size(); i += 3) {
+            for (size_t corner = 0; corner < 3; corner++) {
+                uint32_t a = m_welds[m_indices[i + corner]];
+                uint32_t b = m_welds[m_indices[i + (corner + 1) % 3]];
+                if (a > b || (m_locked[a] && m_locked[b])) {
+                    continue;
+                }
+                Quadric quadric = m_quadrics[a];
+                quadric.add(m_quadrics[b]);
+                double costAB = m_locked[a] ? std::numeric_limits<double>::max()
+                                            : quadric.evaluate(m_vertices[b].position);
+                double costBA = m_locked[b] ? std::numeric_limits<double>::max()
+                                            : quadric.evaluate(m_vertices[a].position);
+                collapses.push_back(
+                    costAB <= costBA ? Collapse{ a, b, costAB } : Collapse{ b, a, costBA });
+            }
+        }
+        std::sort(
+            collapses.begin(),
+            collapses.end(),
+            [](const Collapse& lhs, const Collapse& rhs)
+            {
+                return lhs.cost < rhs.cost;
+            });
+
+        // collapses in one pass must not share triangles, so each is checked against the
+        // mesh it will actually be applied to
+        size_t trianglesToRemove = (m_indices.size() - targetIndexCount + 2) / 3;
+        size_t trianglesRemoved = 0;
+        std::fill(touched.begin(), touched.end(), false);
+        std::fill(collapseTargets.begin(), collapseTargets.end(), none);
+        for (const Collapse& collapse : collapses) {
+            if (trianglesRemoved >= trianglesToRemove) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to] || flipsTriangle(collapse)) {
+                continue;
+            }
+
+            for (uint32_t a = m_adjacencyOffsets[collapse.from];
+                 a < m_adjacencyOffsets[collapse.from + 1];
+                 a++)
+            {
+                uint32_t triangle = m_adjacency[a];
+                bool removed = false;
+                for (size_t corner = 0; corner < 3; corner++) {
+                    uint32_t weld = m_welds[m_indices[triangle * 3 + corner]];
+                    touched[weld] = true;
+                    removed = removed || weld == collapse.to;
+                }
+                trianglesRemoved += removed ? 1 : 0;
+            }
+            collapseTargets[collapse.from] = collapse.to;
+            m_quadrics[collapse.to].add(m_quadrics[collapse.from]);
+            m_error = std::max(m_error, collapse.cost);
+        }
+        if (trianglesRemoved == 0) {
+            break; // nothing left that can collapse without damaging the surface
+        }
+
+        // move collapsed vertices and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < m_indices.size(); i += 3) {
+            std::array<uint32_t, 3> triangle{};
+            for (size_t corner = 0; corner < 3; corner++) {
+                uint32_t vertex = m_indices[i + corner];
+                uint32_t target = collapseTargets[m_welds[vertex]];
+                triangle[corner] = target == none ? vertex : findSeamTarget(vertex, target);
+            }
+            uint32_t w0 = m_welds[triangle[0]];
+            uint32_t w1 = m_welds[triangle[1]];
+            uint32_t w2 = m_welds[triangle[2]];
+            if (w0 == w1 || w1 == w2 || w2 == w0) {
+                continue;
+            }
+            m_indices[write++] = triangle[0];
+            m_indices[write++] = triangle[1];
+            m_indices[write++] = triangle[2];
+        }
+        m_indices.resize(write);
+    }
+
+    return static_cast<float>(std::sqrt(m_error));
+}
+
+// Returns the indices of the current simplification, into the original vertices.
+const std::vector<uint32_t>& VgeMeshSimplifier::getIndices() const
+{
+    return m_indices;
+}
+
+/* Welds vertices that share a position.
+ *
+ * OBJ loading splits vertices wherever normals or uvs differ. Treating the
+ * split copies as one vertex keeps the simplifier from tearing the mesh
+ * open along those seams.
+ */
+void VgeMeshSimplifier::weldPositions()
+{
+    std::unordered_map<glm::vec3, uint32_t> firstVertices{};
+    m_welds.resize(m_vertices.size());
+    m_weldVertices.resize(m_vertices.size());
+    for (uint32_t vertex = 0; vertex < m_vertices.size(); vertex++) {
+        std::pair<std::unordered_map<glm::vec3, uint32_t>::iterator, bool> inserted =
+            firstVertices.emplace(m_vertices[vertex].position, vertex);
+        m_welds[vertex] = inserted.first->second;
+        m_weldVertices[m_welds[vertex]].push_back(vertex);
+    }
+}
+
+/* Accumulates the plane quadric of every triangle on its welded vertices.
+ *
+ * A quadric evaluates to the sum of squared distances of a point to the
+ * planes it holds, which is the cost of moving a vertex there.
+ */
+void VgeMeshSimplifier::computeQuadrics()
+{
+    m_quadrics.assign(m_vertices.size(), Quadric{});
+    for (size_t i = 0; i < m_indices.size(); i += 3) {
+        glm::dvec3 p0 = m_vertices[m_indices[i + 0]].position;
+        glm::dvec3 p1 = m_vertices[m_indices[i + 1]].position;
+        glm::dvec3 p2 = m_vertices[m_indices[i + 2]].position;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0.0) {
+            continue;
+        }
+        normal /= length;
+
+        Quadric plane{};
+        plane.addPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+        for (size_t corner = 0; corner < 3; corner++) {
+            m_quadrics[m_welds[m_indices[i + corner]]].add(plane);
+        }
+    }
+}
+
+/* Locks welded vertices on open borders and non-manifold edges.
+ *
+ * Their quadrics do not hold the surface on both sides, so collapsing them
+ * would pull the outline of the mesh inwards at no measured cost.
+ */
+void VgeMeshSimplifier::lockBorders()
+{
+    std::unordered_map<uint64_t, uint32_t> edgeUses{};
+    for (size_t i = 0; i < m_indices.size(); i += 3) {
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint64_t a = m_welds[m_indices[i + corner]];
+            uint64_t b = m_welds[m_indices[i + (corner + 1) % 3]];
+            edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    }
+
+    m_locked.assign(m_vertices.size(), false);
+    for (const std::pair<const uint64_t, uint32_t>& edge : edgeUses) {
+        if (edge.second != 2) {
+            m_locked[edge.first >> 32] = true;
+            m_locked[edge.first & 0xFFFF'FFFF] = true;
+        }
+    }
+}
+
+/* Builds the list of triangles around every welded vertex.
+ *
+ * Stored compactly, the triangles of welded vertex w are
+ * m_adjacency[m_adjacencyOffsets[w]] up to m_adjacencyOffsets[w + 1].
+ */
+void VgeMeshSimplifier::buildAdjacency()
+{
+    m_adjacencyOffsets.assign(m_vertices.size() + 1, 0);
+    for (uint32_t index : m_indices) {
+        m_adjacencyOffsets[m_welds[index] + 1]++;
+    }
+    for (size_t weld = 0; weld < m_vertices.size(); weld++) {
+        m_adjacencyOffsets[weld + 1] += m_adjacencyOffsets[weld];
+    }
+
+    std::vector<uint32_t> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+    m_adjacency.resize(m_indices.size());
+    for (size_t i = 0; i < m_indices.size(); i++) {
+        m_adjacency[fill[m_welds[m_indices[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+/* Checks whether a collapse would turn any surviving triangle over.
+ *
+ * Triangles around the removed vertex that also use the target vanish, the
+ * others are stretched to the target and must keep facing the same way.
+ */
+bool VgeMeshSimplifier::flipsTriangle(const Collapse& collapse) const
+{
+    const glm::vec3& target = m_vertices[collapse.to].position;
+    for (uint32_t a = m_adjacencyOffsets[collapse.from];
+         a < m_adjacencyOffsets[collapse.from + 1];
+         a++)
+    {
+        uint32_t triangle = m_adjacency[a];
+        std::array<glm::vec3, 3> before{};
+        std::array<glm::vec3, 3> after{};
+        bool removed = false;
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t vertex = m_indices[triangle * 3 + corner];
+            before[corner] = m_vertices[vertex].position;
+            after[corner] = m_welds[vertex] == collapse.from ? target : before[corner];
+            removed = removed || m_welds[vertex] == collapse.to;
+        }
+        if (removed) {
+            continue;
+        }
+
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <= 0.f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Picks the vertex a collapsed vertex is replaced with.
+ *
+ * Several vertices may share the target position with different normals,
+ * colors or uvs. The one whose attributes match best keeps seams sharp.
+ */
+uint32_t VgeMeshSimplifier::findSeamTarget(uint32_t vertex, uint32_t toWeld) const
+{
+    const VgeModel::Vertex& source = m_vertices[vertex];
+    uint32_t best = toWeld;
+    float bestScore = -std::numeric_limits<float>::max();
+    for (uint32_t candidate : m_weldVertices[toWeld]) {
+        const VgeModel::Vertex& target = m_vertices[candidate];
+        float score = glm::dot(source.normal, target.normal) -
+                      glm::length(source.uv - target.uv) -
+                      glm::length(source.color - target.color);
+        if (score > bestScore) {
+            bestScore = score;
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+/* Adds the plane ax + by + cz + d = 0 to the quadric.
+ *
+ * The plane's quadric is the outer product of (a, b, c, d) with itself.
+ */
+void VgeMeshSimplifier::Quadric::addPlane(double a, double b, double c, double d)
+{
+    m[0] += a * a;
+    m[1] += a * b;
+    m[2] += a * c;
+    m[3] += a * d;
+    m[4] += b * b;
+    m[5] += b * c;
+    m[6] += b * d;
+    m[7] += c * c;
+    m[8] += c * d;
+    m[9] += d * d;
+}
+
+// Adds another quadric, the result measures the distance to both sets of planes.
+void VgeMeshSimplifier::Quadric::add(const Quadric& other)
+{
+    for (size_t i = 0; i < m.size(); i++) {
+        m[i] += other.m[i];
+    }
+}
+
+/* Evaluates the quadric at a point.
+ *
+ * Returns the sum of squared distances of p to the quadric's planes.
+ */
+double VgeMeshSimplifier::Quadric::evaluate(const glm::vec3& p) const
+{
+    double x = p.x;
+    double y = p.y;
+    double z = p.z;
+    double error = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+                   m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y + m[7] * z * z +
+                   2.0 * m[8] * z + m[9];
+    return std::max(error, 0.0);
+}
+
+} // namespace vge
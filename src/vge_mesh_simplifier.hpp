@@ -0,0 +1,70 @@
+#pragma once
+
+#include "vge_model.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vge {
+
+// Quadric error metric mesh simplification by edge collapse. Vertices with equal positions are
+// welded, so attribute seams collapse together, and every collapse moves a vertex onto one of
+// its neighbours, so no new vertices are created and all levels can share one vertex buffer
+class VgeMeshSimplifier {
+public:
+    VgeMeshSimplifier(
+        const std::vector<VgeModel::Vertex>& vertices,
+        const std::vector<uint32_t>& indices);
+
+    VgeMeshSimplifier(const VgeMeshSimplifier&) = delete;
+    VgeMeshSimplifier& operator=(const VgeMeshSimplifier&) = delete;
+
+    float simplify(size_t targetIndexCount);
+    const std::vector<uint32_t>& getIndices() const;
+
+private:
+    // symmetric 4x4 matrix, upper triangle row by row
+    struct Quadric
+    {
+        std::array<double, 10> m{};
+
+        void addPlane(double a, double b, double c, double d);
+        void add(const Quadric& other);
+        double evaluate(const glm::vec3& p) const;
+    };
+
+    struct Collapse
+    {
+        uint32_t from = 0; // welded vertex that is removed
+        uint32_t to = 0;   // welded vertex it moves onto
+        double cost = 0.0;
+    };
+
+    void weldPositions();
+    void computeQuadrics();
+    void lockBorders();
+    void buildAdjacency();
+    bool flipsTriangle(const Collapse& collapse) const;
+    uint32_t findSeamTarget(uint32_t vertex, uint32_t toWeld) const;
+
+    const std::vector<VgeModel::Vertex>& m_vertices;
+    std::vector<uint32_t> m_indices;
+
+    // welded id of each vertex, the first vertex with the same position
+    std::vector<uint32_t> m_welds;
+    std::vector<std::vector<uint32_t>> m_weldVertices;
+
+    // per welded vertex
+    std::vector<Quadric> m_quadrics;
+    std::vector<bool> m_locked; // on an open border, collapsing it would eat into the outline
+
+    // triangles around each welded vertex, rebuilt every pass
+    std::vector<uint32_t> m_adjacencyOffsets;
+    std::vector<uint32_t> m_adjacency;
+
+    double m_error; // largest collapse cost so far
+};
+
+} // namespace vge
@@ -1,67 +1,92 @@
 #include "vge_model.hpp"
+#include "vge_mesh_optimizer.hpp"
+#include "vge_mesh_simplifier.hpp"
+#include "vge_obj_reader.hpp"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tinyobjloader/tiny_obj_loader.h>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iostream>
+#include <limits>
 #include <stdexcept>
-#include <unordered_map>
-
-namespace std {
-/* Specializes the hash function for vge::VgeModel::Vertex.
- *
- * This struct provides a custom hash function for Vertex objects, combining
- * the hash values of the position, color, normal, and UV coordinates to
- * produce a unique hash value for each Vertex, enabling its use in hash-based
- * containers like std::unordered_map.
- */
-template <> struct hash<vge::VgeModel::Vertex>
-{
-    size_t operator()(const vge::VgeModel::Vertex& vertex) const
-    {
-        size_t seed = 0;
-        vge::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-        return seed;
-    }
-};
-} // namespace std
 
 namespace vge {
 
-/* Combines multiple hash values into a single hash seed.
- *
- * This function updates the provided seed with the hash of the given values,
- * allowing for the efficient hashing of multiple components by using a
- * combination algorithm.
- */
-template <typename T, typename... Rest>
-void hashCombine(std::size_t& seed, const T& v, const Rest&... rest)
-{
-    seed ^= std::hash<T>{}(v) + 0x9e'37'79'b9 + (seed << 6) + (seed >> 2);
-    // C++17 fold expression (f(), ...) to hash remaining element in rest...
-    (hashCombine(seed, rest), ...);
-}
-
 /* Constructs a VgeModel from the given device and builder.
  *
  * This constructor initializes vertex and index buffers by calling the
- * respective creation methods with data from the builder.
+ * respective creation methods with data from the builder. Without LODs in
+ * the builder the whole mesh is the only LOD. The vertex streams are
+ * emitted in the builder's vertex format from its streams, or from its
+ * vertices if it was never deinterleaved.
+ * Buffers are uploaded right away, or with deferredUploads left for the
+ * caller to copy, see createDeviceLocalBuffer. Safe to call on any thread
+ * in the latter case.
  */
-VgeModel::VgeModel(VgeDevice& device, const VgeModel::Builder& builder)
+VgeModel::VgeModel(
+    VgeDevice& device,
+    const VgeModel::Builder& builder,
+    std::vector<BufferUpload>* deferredUploads)
     : m_vgeDevice{ device }
-    , m_vertexBuffer{}
+    , m_positionBuffer{}
+    , m_attributeBuffer{}
     , m_vertexCount{}
+    , m_vertexFormat{ builder.vertexFormat }
+    , m_dequantizationMatrix{ 1.f }
     , m_indexBuffer{}
     , m_indexCount{}
+    , m_indexType{ VK_INDEX_TYPE_UINT32 }
+    , m_lods{ builder.lods }
+    , m_meshletBuffer{}
+    , m_meshletCount{ 0 }
+    , m_boundsMin{ 0.f }
+    , m_boundsMax{ 0.f }
 {
-    createVertexBuffers(builder.vertices);
-    createIndexBuffers(builder.indices);
+    assert((builder.vertices.empty() || builder.streams.size() == 0) &&
+           "Builder vertices must be empty once deinterleaved!");
+
+    // builders filled by hand may not have deinterleaved their vertices
+    const VertexStreams* streams = &builder.streams;
+    VertexStreams deinterleaved{};
+    if (!builder.vertices.empty()) {
+        deinterleaved.deinterleave(builder.vertices);
+        streams = &deinterleaved;
+    }
+    streams->computeBounds(m_boundsMin, m_boundsMax);
+
+    std::vector<uint8_t> positions{};
+    std::vector<uint8_t> attributes{};
+    if (m_vertexFormat == VertexFormat::PACKED) {
+        streams->writePackedStreams(m_boundsMin, m_boundsMax, positions, attributes);
+        createVertexBuffers(
+            positions,
+            sizeof(PackedVertex::position),
+            attributes,
+            sizeof(PackedVertex) - sizeof(PackedVertex::position),
+            deferredUploads);
+        m_dequantizationMatrix = glm::scale(
+            glm::translate(glm::mat4{ 1.f }, m_boundsMin),
+            m_boundsMax - m_boundsMin);
+    }
+    else {
+        streams->writeFloatStreams(positions, attributes);
+        createVertexBuffers(
+            positions,
+            sizeof(Vertex::position),
+            attributes,
+            sizeof(Vertex) - sizeof(Vertex::position),
+            deferredUploads);
+    }
+    createIndexBuffers(builder.indices, deferredUploads);
+    createMeshletBuffer(builder.meshlets, deferredUploads);
+    if (m_lods.empty()) {
+        m_lods.push_back({ 0, m_hasIndexBuffer ? m_indexCount : m_vertexCount, 0.f });
+    }
 }
 
 /* Cleans up resources associated with the VgeModel.
@@ -82,63 +107,300 @@ bool VgeModel::Vertex::operator==(const Vertex& other) const
            uv == other.uv;
 }
 
+/* Encodes a unit vector as a point of the octahedron unfolded onto [-1, 1]^2.
+ *
+ * The vector is projected onto the octahedron |x| + |y| + |z| = 1, whose
+ * lower half is folded out over the diagonals of the square. Zero vectors
+ * encode as +z.
+ */
+static glm::vec2 encodeOctahedral(const glm::vec3& n)
+{
+    float l1Norm = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+    if (l1Norm == 0.f) {
+        return glm::vec2{ 0.f };
+    }
+    glm::vec2 p = glm::vec2{ n.x, n.y } / l1Norm;
+    if (n.z < 0.f) {
+        p = glm::vec2{
+            (1.f - glm::abs(p.y)) * (p.x >= 0.f ? 1.f : -1.f),
+            (1.f - glm::abs(p.x)) * (p.y >= 0.f ? 1.f : -1.f),
+        };
+    }
+    return p;
+}
+
+/* Copies the vertices into one array per component.
+ *
+ * Replaces any previous contents.
+ */
+void VgeModel::VertexStreams::deinterleave(const std::vector<Vertex>& vertices)
+{
+    size_t count = vertices.size();
+    std::vector<float>* streams[] = {
+        &positionX, &positionY, &positionZ, &colorR, &colorG, &colorB,
+        &normalX,   &normalY,   &normalZ,   &u,      &v,
+    };
+    for (std::vector<float>* stream : streams) {
+        stream->resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        positionX[i] = vertex.position.x;
+        positionY[i] = vertex.position.y;
+        positionZ[i] = vertex.position.z;
+        colorR[i] = vertex.color.r;
+        colorG[i] = vertex.color.g;
+        colorB[i] = vertex.color.b;
+        normalX[i] = vertex.normal.x;
+        normalY[i] = vertex.normal.y;
+        normalZ[i] = vertex.normal.z;
+        u[i] = vertex.uv.x;
+        v[i] = vertex.uv.y;
+    }
+}
+
+// Returns the number of vertices.
+size_t VgeModel::VertexStreams::size() const
+{
+    return positionX.size();
+}
+
+/* Finds the smallest and largest value of a component array.
+ *
+ * A branch-free reduction over contiguous floats, which the compiler can
+ * turn into packed min and max instructions.
+ */
+static void findRange(const std::vector<float>& values, float& minValue, float& maxValue)
+{
+    minValue = values[0];
+    maxValue = values[0];
+    for (size_t i = 1; i < values.size(); i++) {
+        minValue = values[i] < minValue ? values[i] : minValue;
+        maxValue = values[i] > maxValue ? values[i] : maxValue;
+    }
+}
+
+/* Computes the axis aligned bounding box of the positions.
+ *
+ * Each axis is reduced on its own array. Without vertices both corners
+ * are the origin.
+ */
+void VgeModel::VertexStreams::computeBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    boundsMin = glm::vec3{ 0.f };
+    boundsMax = glm::vec3{ 0.f };
+    if (size() == 0) {
+        return;
+    }
+    findRange(positionX, boundsMin.x, boundsMax.x);
+    findRange(positionY, boundsMin.y, boundsMax.y);
+    findRange(positionZ, boundsMin.z, boundsMax.z);
+}
+
+/* Writes a component array into every stride bytes of a stream.
+ *
+ * destination points at the component in the stream's first vertex.
+ */
+static void scatterComponent(const std::vector<float>& values, uint8_t* destination, size_t stride)
+{
+    for (size_t i = 0; i < values.size(); i++) {
+        std::memcpy(destination + i * stride, &values[i], sizeof(float));
+    }
+}
+
+/* Emits the position and attribute streams of the float vertex format.
+ *
+ * Each component array is written straight into its place in the streams,
+ * laid out like a Vertex split after its position, so the streams match
+ * the Vertex binding and attribute descriptions.
+ */
+void VgeModel::VertexStreams::writeFloatStreams(
+    std::vector<uint8_t>& positions,
+    std::vector<uint8_t>& attributes) const
+{
+    constexpr size_t positionSize = sizeof(Vertex::position);
+    constexpr size_t attributeSize = sizeof(Vertex) - positionSize;
+    positions.resize(size() * positionSize);
+    attributes.resize(size() * attributeSize);
+    if (size() == 0) {
+        return;
+    }
+
+    uint8_t* position = positions.data();
+    scatterComponent(positionX, position, positionSize);
+    scatterComponent(positionY, position + sizeof(float), positionSize);
+    scatterComponent(positionZ, position + 2 * sizeof(float), positionSize);
+
+    uint8_t* color = attributes.data() + offsetof(Vertex, color) - positionSize;
+    uint8_t* normal = attributes.data() + offsetof(Vertex, normal) - positionSize;
+    uint8_t* uv = attributes.data() + offsetof(Vertex, uv) - positionSize;
+    scatterComponent(colorR, color, attributeSize);
+    scatterComponent(colorG, color + sizeof(float), attributeSize);
+    scatterComponent(colorB, color + 2 * sizeof(float), attributeSize);
+    scatterComponent(normalX, normal, attributeSize);
+    scatterComponent(normalY, normal + sizeof(float), attributeSize);
+    scatterComponent(normalZ, normal + 2 * sizeof(float), attributeSize);
+    scatterComponent(u, uv, attributeSize);
+    scatterComponent(v, uv + sizeof(float), attributeSize);
+}
+
+/* Emits the position and attribute streams of the packed vertex format.
+ *
+ * Positions are first normalized across the bounding box one axis array
+ * at a time, then every vertex is packed into a PackedVertex: positions
+ * to 16 bits per axis, the normal to 16 bits per component of its
+ * octahedral encoding, the color to 8 bits per channel and the texture
+ * coordinates to half floats. It is split after its position like in
+ * writeFloatStreams.
+ */
+void VgeModel::VertexStreams::writePackedStreams(
+    const glm::vec3& boundsMin,
+    const glm::vec3& boundsMax,
+    std::vector<uint8_t>& positions,
+    std::vector<uint8_t>& attributes) const
+{
+    constexpr size_t positionSize = sizeof(PackedVertex::position);
+    constexpr size_t attributeSize = sizeof(PackedVertex) - positionSize;
+    positions.resize(size() * positionSize);
+    attributes.resize(size() * attributeSize);
+
+    // positions in [0, 1] across the bounding box, flat axes map to 0
+    glm::vec3 extent = boundsMax - boundsMin;
+    std::vector<float> normalized[3]{ positionX, positionY, positionZ };
+    for (int axis = 0; axis < 3; axis++) {
+        float offset = boundsMin[axis];
+        float scale = extent[axis] > 0.f ? 1.f / extent[axis] : 0.f;
+        for (float& value : normalized[axis]) {
+            value = (value - offset) * scale;
+        }
+    }
+
+    for (size_t i = 0; i < size(); i++) {
+        PackedVertex packed{};
+        for (int axis = 0; axis < 3; axis++) {
+            packed.position[axis] = glm::packUnorm1x16(normalized[axis][i]);
+        }
+
+        glm::vec2 octahedral = encodeOctahedral({ normalX[i], normalY[i], normalZ[i] });
+        packed.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.x));
+        packed.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.y));
+
+        packed.color[0] = glm::packUnorm1x8(colorR[i]);
+        packed.color[1] = glm::packUnorm1x8(colorG[i]);
+        packed.color[2] = glm::packUnorm1x8(colorB[i]);
+
+        packed.uv[0] = glm::packHalf1x16(u[i]);
+        packed.uv[1] = glm::packHalf1x16(v[i]);
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&packed);
+        std::memcpy(&positions[i * positionSize], bytes, positionSize);
+        std::memcpy(&attributes[i * attributeSize], bytes + positionSize, attributeSize);
+    }
+}
+
 /* Creates a VgeModel instance from a specified file.
  *
- * This static method loads a model from the given file path and returns
- * a unique pointer to the created VgeModel instance.
+ * This static method imports the model at the given file path, see
+ * Builder::importModel, and returns a unique pointer to the created
+ * VgeModel instance with its vertices stored in the given format.
  */
 std::unique_ptr<VgeModel> VgeModel::createModelFromFile(
     VgeDevice& device,
-    const std::string& filepath)
+    const std::string& filepath,
+    VertexFormat vertexFormat)
 {
     Builder builder{};
-    builder.loadModel(filepath);
+    builder.vertexFormat = vertexFormat;
+    builder.importModel(filepath);
 
     return std::make_unique<VgeModel>(device, builder);
 }
 
-/* Creates vertex buffers for the model from the provided vertices.
+/* Creates vertex buffers for the model from the provided vertex streams.
  *
- * This method allocates a staging buffer, maps it, and copies vertex data
- * into the GPU-usable vertex buffer.
+ * positions and attributes hold the model's vertices in its vertex format,
+ * positionSize and attributeSize bytes per vertex. Both streams are copied
+ * into GPU-usable vertex buffers.
  */
-void VgeModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+void VgeModel::createVertexBuffers(
+    const std::vector<uint8_t>& positions,
+    uint32_t positionSize,
+    const std::vector<uint8_t>& attributes,
+    uint32_t attributeSize,
+    std::vector<BufferUpload>* deferredUploads)
 {
-    m_vertexCount = static_cast<uint32_t>(vertices.size());
+    m_vertexCount = static_cast<uint32_t>(positions.size() / positionSize);
     assert(m_vertexCount >= 3 && "Vertex count must be at least 3");
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
-    uint32_t vertexSize = sizeof(vertices[0]);
+    assert(attributes.size() == static_cast<size_t>(attributeSize) * m_vertexCount &&
+           "Vertex streams must hold the same number of vertices");
 
-    VgeBuffer stagingBuffer{
-        m_vgeDevice,
-        vertexSize,
+    m_positionBuffer = createDeviceLocalBuffer(
+        positions.data(),
+        positionSize,
         m_vertexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    };
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        deferredUploads);
+    m_attributeBuffer = createDeviceLocalBuffer(
+        attributes.data(),
+        attributeSize,
+        m_vertexCount,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        deferredUploads);
+}
 
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void*)vertices.data());
+/* Creates a device local buffer holding the given elements.
+ *
+ * The data is written to a host visible staging buffer and copied over,
+ * so the buffer also gets the transfer destination usage. With
+ * deferredUploads the copy is not submitted but handed back there along
+ * with the staging buffer, the buffer's contents are undefined until the
+ * caller has executed it.
+ */
+std::unique_ptr<VgeBuffer> VgeModel::createDeviceLocalBuffer(
+    const void* data,
+    uint32_t elementSize,
+    uint32_t elementCount,
+    VkBufferUsageFlags usage,
+    std::vector<BufferUpload>* deferredUploads)
+{
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(elementSize) * elementCount;
 
-    m_vertexBuffer = std::make_unique<VgeBuffer>(
+    std::unique_ptr<VgeBuffer> stagingBuffer = std::make_unique<VgeBuffer>(
         m_vgeDevice,
-        vertexSize,
-        m_vertexCount,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        elementSize,
+        elementCount,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    stagingBuffer->map();
+    stagingBuffer->writeToBuffer((void*)data);
 
-    );
+    std::unique_ptr<VgeBuffer> buffer = std::make_unique<VgeBuffer>(
+        m_vgeDevice,
+        elementSize,
+        elementCount,
+        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    m_vgeDevice.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+    if (deferredUploads != nullptr) {
+        deferredUploads->push_back({ std::move(stagingBuffer), buffer->getBuffer(), bufferSize });
+    }
+    else {
+        m_vgeDevice.copyBuffer(stagingBuffer->getBuffer(), buffer->getBuffer(), bufferSize);
+    }
+    return buffer;
 }
 
 /* Creates index buffers for the model from the provided indices.
  *
- * This method allocates a staging buffer for index data, maps it, and
- * copies the indices into the GPU-usable index buffer, if any indices are
- * provided.
+ * This method copies the indices into the GPU-usable index buffer, if any
+ * indices are provided. When every vertex can be addressed with 16 bits
+ * the indices are narrowed, halving the buffer's memory and fetch
+ * bandwidth. Must be called after createVertexBuffers.
  */
-void VgeModel::createIndexBuffers(const std::vector<uint32_t>& indices)
+void VgeModel::createIndexBuffers(
+    const std::vector<uint32_t>& indices,
+    std::vector<BufferUpload>* deferredUploads)
 {
     m_indexCount = static_cast<uint32_t>(indices.size());
     m_hasIndexBuffer = m_indexCount > 0;
@@ -147,45 +409,156 @@ void VgeModel::createIndexBuffers(const std::vector<uint32_t>& indices)
         return;
     }
 
-    VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
+    std::vector<uint16_t> shortIndices{};
+    const void* indexData = indices.data();
     uint32_t indexSize = sizeof(indices[0]);
+    m_indexType = VK_INDEX_TYPE_UINT32;
+    if (m_vertexCount <= std::numeric_limits<uint16_t>::max()) {
+        shortIndices.assign(indices.begin(), indices.end());
+        indexData = shortIndices.data();
+        indexSize = sizeof(shortIndices[0]);
+        m_indexType = VK_INDEX_TYPE_UINT16;
+    }
 
-    VgeBuffer stagingBuffer{
-        m_vgeDevice,
+    m_indexBuffer = createDeviceLocalBuffer(
+        indexData,
         indexSize,
         m_indexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    };
-
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void*)indices.data());
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        deferredUploads);
+}
 
-    m_indexBuffer = std::make_unique<VgeBuffer>(
-        m_vgeDevice,
-        indexSize,
-        m_indexCount,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+/* Creates the storage buffer of the model's meshlets.
+ *
+ * Uploaded through a staging buffer like the vertex and index buffers.
+ * Models without meshlets get no buffer.
+ */
+void VgeModel::createMeshletBuffer(
+    const std::vector<Meshlet>& meshlets,
+    std::vector<BufferUpload>* deferredUploads)
+{
+    m_meshletCount = static_cast<uint32_t>(meshlets.size());
+    if (m_meshletCount == 0) {
+        return;
+    }
 
-    m_vgeDevice.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+    m_meshletBuffer = createDeviceLocalBuffer(
+        meshlets.data(),
+        sizeof(meshlets[0]),
+        m_meshletCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        deferredUploads);
 }
 
 /* Draws the model using the specified command buffer.
  *
- * This method issues a draw call, either indexed or non-indexed, depending
- * on the presence of an index buffer.
+ * This method issues a draw call of the given LOD, either indexed or
+ * non-indexed, depending on the presence of an index buffer. firstInstance
+ * is visible to shaders as gl_InstanceIndex, which bindless shaders use to
+ * find per-object data.
  */
-void VgeModel::draw(VkCommandBuffer commandBuffer)
+void VgeModel::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t lod)
 {
+    assert(lod < m_lods.size() && "LOD out of range");
+    const Lod& range = m_lods[lod];
     if (m_hasIndexBuffer) {
-        vkCmdDrawIndexed(commandBuffer, m_indexCount, 1, 0, 0, 0);
+        vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, 0, firstInstance);
     }
     else {
-        vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+        vkCmdDraw(commandBuffer, range.indexCount, 1, range.firstIndex, firstInstance);
     }
 }
 
+/* Picks the coarsest LOD whose error is invisible at a given distance.
+ *
+ * viewDepth is the view space depth of the model, scale its transform
+ * scale and projectionScale the vertical focal length, element [1][1] of
+ * the projection matrix. An error e then covers at most
+ * e * maxScale * projectionScale / (2 * viewDepth) of the screen height,
+ * which must stay within LOD_SCREEN_ERROR.
+ */
+uint32_t VgeModel::selectLod(float viewDepth, const glm::vec3& scale, float projectionScale)
+    const
+{
+    float maxScale = glm::max(glm::abs(scale.x), glm::max(glm::abs(scale.y), glm::abs(scale.z)));
+    if (viewDepth <= 0.f || maxScale == 0.f) {
+        return 0;
+    }
+    float maxError = LOD_SCREEN_ERROR * 2.f * viewDepth / (maxScale * projectionScale);
+    uint32_t lod = 0;
+    while (lod + 1 < m_lods.size() && m_lods[lod + 1].error <= maxError) {
+        lod++;
+    }
+    return lod;
+}
+
+// Returns the number of LODs, at least 1.
+uint32_t VgeModel::getLodCount() const
+{
+    return static_cast<uint32_t>(m_lods.size());
+}
+
+// Returns the number of meshlets of the full detail LOD, 0 if it was not split.
+uint32_t VgeModel::getMeshletCount() const
+{
+    return m_meshletCount;
+}
+
+/* Get the descriptor info of the meshlet storage buffer.
+ *
+ * Only valid when getMeshletCount() is not 0.
+ */
+VkDescriptorBufferInfo VgeModel::getMeshletBufferInfo() const
+{
+    assert(m_meshletBuffer != nullptr && "Model has no meshlets");
+    return m_meshletBuffer->descriptorInfo();
+}
+
+/* Get the device memory taken by the model's buffers.
+ *
+ * Staging buffers are not counted, they are freed once uploaded.
+ */
+VkDeviceSize VgeModel::getMemorySize() const
+{
+    VkDeviceSize size = m_positionBuffer->getBufferSize() + m_attributeBuffer->getBufferSize();
+    if (m_indexBuffer != nullptr) {
+        size += m_indexBuffer->getBufferSize();
+    }
+    if (m_meshletBuffer != nullptr) {
+        size += m_meshletBuffer->getBufferSize();
+    }
+    return size;
+}
+
+// Returns the minimum corner of the model space bounding box.
+const glm::vec3& VgeModel::getBoundsMin() const
+{
+    return m_boundsMin;
+}
+
+// Returns the maximum corner of the model space bounding box.
+const glm::vec3& VgeModel::getBoundsMax() const
+{
+    return m_boundsMax;
+}
+
+// Returns the layout of the model's vertex buffer.
+VgeModel::VertexFormat VgeModel::getVertexFormat() const
+{
+    return m_vertexFormat;
+}
+
+/* Get the matrix mapping vertex buffer positions to model space.
+ *
+ * Packed positions span [0, 1] across the bounding box. Multiplying the
+ * model matrix by this matrix lets shaders use the packed positions as is.
+ * The identity for the float vertex format.
+ */
+const glm::mat4& VgeModel::getDequantizationMatrix() const
+{
+    return m_dequantizationMatrix;
+}
+
 /* Binds the vertex and index buffers to the specified command buffer.
  *
  * This method sets up the buffers for rendering, ensuring they are bound
@@ -193,121 +566,309 @@ void VgeModel::draw(VkCommandBuffer commandBuffer)
  */
 void VgeModel::bind(VkCommandBuffer commandBuffer)
 {
-    VkBuffer buffers[] = { m_vertexBuffer->getBuffer() };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    VkBuffer buffers[] = { m_positionBuffer->getBuffer(), m_attributeBuffer->getBuffer() };
+    VkDeviceSize offsets[] = { 0, 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
 
     if (m_hasIndexBuffer) {
-        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, m_indexType);
     }
 }
 
 /* Retrieves the vertex input binding descriptions for the model.
  *
  * This method returns a vector of binding descriptions required for
- * configuring vertex input in the graphics pipeline.
+ * configuring vertex input in the graphics pipeline, one per stream.
  */
 std::vector<VkVertexInputBindingDescription> VgeModel::Vertex::getBindingDescriptions()
 {
-    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
     bindingDescriptions[0].binding = 0;
-    bindingDescriptions[0].stride = sizeof(Vertex);
+    bindingDescriptions[0].stride = sizeof(Vertex::position);
     bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(Vertex) - sizeof(Vertex::position);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     return bindingDescriptions;
 }
 
 /* Retrieves the vertex input attribute descriptions for the model.
  *
  * This method returns a vector of attribute descriptions that define the
- * layout of vertex data in the graphics pipeline.
+ * layout of vertex data in the graphics pipeline. Attribute stream offsets
+ * are relative to the end of the position.
  */
 std::vector<VkVertexInputAttributeDescription> VgeModel::Vertex::getAttributeDescriptions()
 {
+    constexpr uint32_t stream = sizeof(Vertex::position);
+
     // location, binding, format, offset
     std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
+    attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+    attributeDescriptions.push_back(
+        { 1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) - stream });
     attributeDescriptions.push_back(
-        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });
-    attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });
-    attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
-    attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
+        { 2, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) - stream });
+    attributeDescriptions.push_back(
+        { 3, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) - stream });
 
     return attributeDescriptions;
 }
 
+/* Retrieves the binding descriptions of a position-only vertex input.
+ *
+ * Used by depth-only pipelines, which then only fetch the position stream.
+ */
+std::vector<VkVertexInputBindingDescription> VgeModel::Vertex::getPositionBindingDescriptions()
+{
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions = getBindingDescriptions();
+    bindingDescriptions.resize(1);
+    return bindingDescriptions;
+}
+
+/* Retrieves the attribute descriptions of a position-only vertex input.
+ *
+ * Used by depth-only pipelines together with the position-only binding
+ * descriptions.
+ */
+std::vector<VkVertexInputAttributeDescription> VgeModel::Vertex::getPositionAttributeDescriptions()
+{
+    // location, binding, format, offset
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+    attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+
+    return attributeDescriptions;
+}
+
+/* Retrieves the vertex input binding descriptions of packed vertices.
+ *
+ * Same as for Vertex, with the strides of the PackedVertex streams.
+ */
+std::vector<VkVertexInputBindingDescription> VgeModel::PackedVertex::getBindingDescriptions()
+{
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(PackedVertex::position);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(PackedVertex) - sizeof(PackedVertex::position);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescriptions;
+}
+
+/* Retrieves the vertex input attribute descriptions of packed vertices.
+ *
+ * The locations match those of Vertex. The normalized formats are expanded
+ * to floats by the vertex fetch, so shaders declare the same inputs and
+ * only have to decode the octahedral normal.
+ */
+std::vector<VkVertexInputAttributeDescription> VgeModel::PackedVertex::getAttributeDescriptions()
+{
+    constexpr uint32_t stream = sizeof(PackedVertex::position);
+
+    // location, binding, format, offset
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+    attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R16G16B16A16_UNORM, 0 });
+    attributeDescriptions.push_back(
+        { 1, 1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color) - stream });
+    attributeDescriptions.push_back(
+        { 2, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal) - stream });
+    attributeDescriptions.push_back(
+        { 3, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv) - stream });
+
+    return attributeDescriptions;
+}
+
+/* Retrieves the binding descriptions of a position-only packed vertex input.
+ *
+ * The packed counterpart of Vertex::getPositionBindingDescriptions.
+ */
+std::vector<VkVertexInputBindingDescription> VgeModel::PackedVertex::
+    getPositionBindingDescriptions()
+{
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions = getBindingDescriptions();
+    bindingDescriptions.resize(1);
+    return bindingDescriptions;
+}
+
+/* Retrieves the attribute descriptions of a position-only packed vertex input.
+ *
+ * The packed counterpart of Vertex::getPositionAttributeDescriptions.
+ */
+std::vector<VkVertexInputAttributeDescription> VgeModel::PackedVertex::
+    getPositionAttributeDescriptions()
+{
+    // location, binding, format, offset
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+    attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R16G16B16A16_UNORM, 0 });
+
+    return attributeDescriptions;
+}
+
+// Returns the vertex input binding descriptions of the given vertex format.
+std::vector<VkVertexInputBindingDescription> VgeModel::getBindingDescriptions(
+    VertexFormat vertexFormat)
+{
+    return vertexFormat == VertexFormat::PACKED ? PackedVertex::getBindingDescriptions()
+                                                : Vertex::getBindingDescriptions();
+}
+
+// Returns the vertex input attribute descriptions of the given vertex format.
+std::vector<VkVertexInputAttributeDescription> VgeModel::getAttributeDescriptions(
+    VertexFormat vertexFormat)
+{
+    return vertexFormat == VertexFormat::PACKED ? PackedVertex::getAttributeDescriptions()
+                                                : Vertex::getAttributeDescriptions();
+}
+
+// Returns the position-only binding descriptions of the given vertex format.
+std::vector<VkVertexInputBindingDescription> VgeModel::getPositionBindingDescriptions(
+    VertexFormat vertexFormat)
+{
+    return vertexFormat == VertexFormat::PACKED ? PackedVertex::getPositionBindingDescriptions()
+                                                : Vertex::getPositionBindingDescriptions();
+}
+
+// Returns the position-only attribute descriptions of the given vertex format.
+std::vector<VkVertexInputAttributeDescription> VgeModel::getPositionAttributeDescriptions(
+    VertexFormat vertexFormat)
+{
+    return vertexFormat == VertexFormat::PACKED ? PackedVertex::getPositionAttributeDescriptions()
+                                                : Vertex::getPositionAttributeDescriptions();
+}
+
 /* Loads a model from the specified file into the builder.
  *
- * This method reads a Wavefront .obj file, extracts vertex and index data,
- * and stores it in the builder's vertices and indices vectors.
+ * This method streams a Wavefront .obj file through VgeObjReader, which
+ * welds vertices as it parses, and stores the result in the builder's
+ * vertices and indices vectors. Logs the reader's peak allocation
+ * afterwards, the read's memory high-water mark.
  */
 void VgeModel::Builder::loadModel(const std::string& filepath)
 {
-    // All of these values will be set by tinyobjloader and will store the
-    // results of reading a wavefront .obj file
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    // initialize above variables with data from .obj file
-    if (!tinyobj::LoadObj(
-            &attrib, // stores pos, color, normal, texture coord data
-            &shapes, // index values for each face element
-            &materials,
-            &warn,
-            &err,
-            filepath.c_str()))
-    {
-        throw std::runtime_error(warn + err);
-    }
-
-    vertices.clear();
-    indices.clear();
-
-    // map to store already added vertices to the Builder.vertices vector
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-    // loop through each face
-    for (const tinyobj::shape_t& shape : shapes) {
-        for (const tinyobj::index_t& index : shape.mesh.indices) {
-            Vertex vertex{};
-
-            if (index.vertex_index >= 0) {
-                vertex.position = {
-                    attrib.vertices[3 * index.vertex_index + 0], // x-pos
-                    attrib.vertices[3 * index.vertex_index + 1], // y-pos
-                    attrib.vertices[3 * index.vertex_index + 2], // z-pos
-                };
-
-                // if RGB values are present in .obj file
-                vertex.color = {
-                    attrib.colors[3 * index.vertex_index + 0],
-                    attrib.colors[3 * index.vertex_index + 1],
-                    attrib.colors[3 * index.vertex_index + 2],
-                };
-            }
-            if (index.normal_index >= 0) {
-                vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2],
-                };
-            }
-            if (index.texcoord_index >= 0) {
-                vertex.uv = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    attrib.texcoords[2 * index.texcoord_index + 1],
-                };
-            }
-
-            // if new, add to the map
-            if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-            // add pos of vertex to the Builders indices vector
-            indices.push_back(uniqueVertices[vertex]);
+    lods.clear();
+    meshlets.clear();
+    size_t peakSize = VgeObjReader::read(filepath, vertices, indices);
+
+    std::cout << filepath << ": " << vertices.size() << " vertices, " << indices.size() / 3
+              << " triangles, read peak " << peakSize / (1024.f * 1024.f) << " MiB"
+              << std::endl;
+}
+
+/* Appends simplified LODs of the mesh to the index buffer.
+ *
+ * Each LOD keeps LOD_REDUCTION of the previous one's triangles, simplified
+ * with quadric error metrics over the shared vertices. Stops at MAX_LODS,
+ * at MIN_LOD_TRIANGLES, or once simplification no longer makes progress
+ * without damaging the surface.
+ */
+void VgeModel::Builder::generateLods()
+{
+    lods.clear();
+    if (indices.empty()) {
+        return;
+    }
+    lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.f });
+
+    VgeMeshSimplifier simplifier{ vertices, indices };
+    size_t previousCount = indices.size();
+    while (lods.size() < MAX_LODS && previousCount / 3 > MIN_LOD_TRIANGLES) {
+        size_t targetCount = static_cast<size_t>(previousCount / 3 * LOD_REDUCTION) * 3;
+        float error = simplifier.simplify(std::max<size_t>(targetCount, MIN_LOD_TRIANGLES * 3));
+        const std::vector<uint32_t>& lodIndices = simplifier.getIndices();
+        if (lodIndices.size() * 10 > previousCount * 9) {
+            break; // too little saved to be worth a level
         }
+        lods.push_back({ static_cast<uint32_t>(indices.size()),
+                         static_cast<uint32_t>(lodIndices.size()),
+                         error });
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        previousCount = lodIndices.size();
+    }
+}
+
+/* Optimizes the index and vertex buffers for the GPU.
+ *
+ * Every LOD's triangles are reordered for the post-transform vertex cache,
+ * then in clusters against overdraw. Vertices are then reordered in the
+ * order the LODs, finest first, fetch them.
+ */
+void VgeModel::Builder::optimize()
+{
+    if (indices.empty()) {
+        return;
+    }
+    if (lods.empty()) {
+        lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.f });
+    }
+
+    for (const Lod& lod : lods) {
+        uint32_t* lodIndices = indices.data() + lod.firstIndex;
+        VgeMeshOptimizer::optimizeVertexCache(lodIndices, lod.indexCount, vertices.size());
+        VgeMeshOptimizer::optimizeOverdraw(lodIndices, lod.indexCount, vertices);
     }
+    VgeMeshOptimizer::optimizeVertexFetch(vertices, indices);
 }
+
+/* Splits the full detail LOD into meshlets.
+ *
+ * Run after optimize, meshlets are contiguous ranges of the final index
+ * order. Meshes too small to gain from culling below the object level are
+ * left whole.
+ */
+void VgeModel::Builder::buildMeshlets()
+{
+    meshlets.clear();
+    uint32_t indexCount = lods.empty() ? static_cast<uint32_t>(indices.size()) : lods[0].indexCount;
+    if (indexCount / 3 <= MESHLET_MAX_TRIANGLES) {
+        return;
+    }
+    meshlets = VgeMeshOptimizer::buildMeshlets(
+        vertices,
+        indices.data(),
+        indexCount,
+        0,
+        MESHLET_MAX_VERTICES,
+        MESHLET_MAX_TRIANGLES);
+}
+
+/* Moves the vertices into the builder's vertex streams.
+ *
+ * The last import step, run once the vertex order is settled. Afterwards
+ * the streams are the builder's only vertex data, vertices is released
+ * and the model's vertex buffers are emitted from the streams.
+ */
+void VgeModel::Builder::deinterleave()
+{
+    streams.deinterleave(vertices);
+    std::vector<Vertex>().swap(vertices);
+}
+
+/* Loads a model file and runs every import step on it.
+ *
+ * Loads the model, generates its LODs, optimizes its buffers, splits it
+ * into meshlets and deinterleaves its vertices. Only touches the builder,
+ * so imports may run on any thread.
+ */
+void VgeModel::Builder::importModel(const std::string& filepath)
+{
+    loadModel(filepath);
+    generateLods();
+
+    // vertex cache behaviour of the full detail mesh, as loaded and as optimized
+    const uint32_t* fullIndices = indices.data();
+    uint32_t fullIndexCount = lods.empty() ? 0 : lods[0].indexCount;
+    float acmrBefore = VgeMeshOptimizer::computeAcmr(fullIndices, fullIndexCount, vertices.size());
+    optimize();
+    fullIndices = indices.data();
+    float acmrAfter = VgeMeshOptimizer::computeAcmr(fullIndices, fullIndexCount, vertices.size());
+    std::cout << filepath << ": ACMR " << acmrBefore << " -> " << acmrAfter << std::endl;
+    buildMeshlets();
+    deinterleave();
+}
+
 } // namespace vge
@@ -2,6 +2,7 @@
 
 #include "vge_buffer.hpp"
 #include "vge_device.hpp"
+#include "vge_utils.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -14,11 +15,22 @@
 
 namespace vge {
 
-template <typename T, typename... Rest>
-void hashCombine(std::size_t& seed, const T& v, const Rest&... rest);
-
 class VgeModel {
 public:
+    // LODs are only drawn while their error covers at most this fraction of the screen height
+    static constexpr float LOD_SCREEN_ERROR = 0.001f;
+
+    // layout of the vertex buffer, pipelines need one variant per format
+    enum class VertexFormat : uint32_t
+    {
+        FLOAT,  // Vertex
+        PACKED, // PackedVertex
+    };
+    static constexpr uint32_t VERTEX_FORMAT_COUNT = 2;
+
+    // Vertex buffers hold two streams, binding 0 the positions and binding 1 the remaining
+    // attributes, so position-only passes fetch only what they read. Each vertex struct
+    // describes a vertex of both streams, position first, as VertexStreams emits them
     struct Vertex
     {
         glm::vec3 position{};
@@ -28,19 +40,116 @@ public:
 
         static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
         static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
 
         bool operator==(const Vertex& other) const;
     };
 
+    // 20 byte encoding of a Vertex. Shaders read the position in [0, 1] across the model's
+    // bounding box, undone by getDequantizationMatrix, and the normal octahedral encoded
+    struct PackedVertex
+    {
+        uint16_t position[4]{}; // unorm within the bounding box, w unused
+        int16_t normal[2]{};    // snorm octahedral
+        uint8_t color[4]{};     // unorm, a unused
+        uint16_t uv[2]{};       // half floats
+
+        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+    };
+
+    // structure of arrays form of vertices, one array per component, so per vertex kernels
+    // walk contiguous floats the compiler can vectorize. The GPU layouts are only emitted
+    // from here on upload
+    struct VertexStreams
+    {
+        std::vector<float> positionX{};
+        std::vector<float> positionY{};
+        std::vector<float> positionZ{};
+        std::vector<float> colorR{};
+        std::vector<float> colorG{};
+        std::vector<float> colorB{};
+        std::vector<float> normalX{};
+        std::vector<float> normalY{};
+        std::vector<float> normalZ{};
+        std::vector<float> u{};
+        std::vector<float> v{};
+
+        void deinterleave(const std::vector<Vertex>& vertices);
+        size_t size() const;
+        void computeBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+        void writeFloatStreams(std::vector<uint8_t>& positions, std::vector<uint8_t>& attributes)
+            const;
+        void writePackedStreams(
+            const glm::vec3& boundsMin,
+            const glm::vec3& boundsMax,
+            std::vector<uint8_t>& positions,
+            std::vector<uint8_t>& attributes) const;
+    };
+
+    // a level of detail, a range of the index buffer, or of the vertices without one
+    struct Lod
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float error = 0.f; // model space distance the simplified surface may be off by
+    };
+
+    // a cluster of the full detail mesh's triangles, culled as a unit by meshlet_cull.comp.
+    // Laid out for std430, the shader declares the same struct
+    struct Meshlet
+    {
+        glm::vec4 boundingSphere{}; // model space center, w is the radius
+        glm::vec4 cone{};           // average normal, w is the sine of the normals' spread
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        uint32_t padding[2]{};
+    };
+
+    // a copy from a filled staging buffer into one of a model's device local buffers, left to
+    // the caller to record when the model is constructed with deferred uploads
+    struct BufferUpload
+    {
+        std::unique_ptr<VgeBuffer> stagingBuffer{};
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+    };
+
     struct Builder
     {
+        // successive LODs keep this fraction of the previous level's triangles
+        static constexpr float LOD_REDUCTION = 0.5f;
+        static constexpr uint32_t MAX_LODS = 5;
+        // meshes are not simplified below this many triangles
+        static constexpr uint32_t MIN_LOD_TRIANGLES = 32;
+        // meshlet limits, the common sizes mesh shading hardware is tuned for
+        static constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+        static constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
         std::vector<Vertex> vertices{};
         std::vector<uint32_t> indices{};
-
+        std::vector<Lod> lods{}; // empty means a single LOD of all indices
+        std::vector<Meshlet> meshlets{};
+        VertexFormat vertexFormat = VertexFormat::FLOAT;
+        // the final vertices, moved here by deinterleave once their order is settled, after
+        // which vertices is empty
+        VertexStreams streams{};
+
+        void importModel(const std::string& filepath);
         void loadModel(const std::string& filepath);
+        void generateLods();
+        void optimize();
+        void buildMeshlets();
+        void deinterleave();
     };
 
-    VgeModel(VgeDevice& device, const VgeModel::Builder& builder);
+    VgeModel(
+        VgeDevice& device,
+        const VgeModel::Builder& builder,
+        std::vector<BufferUpload>* deferredUploads = nullptr);
     ~VgeModel();
 
     VgeModel(const VgeModel&) = delete;
@@ -48,23 +157,74 @@ public:
 
     static std::unique_ptr<VgeModel> createModelFromFile(
         VgeDevice& device,
-        const std::string& filepath);
+        const std::string& filepath,
+        VertexFormat vertexFormat = VertexFormat::FLOAT);
+
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(
+        VertexFormat vertexFormat);
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(
+        VertexFormat vertexFormat);
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions(
+        VertexFormat vertexFormat);
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions(
+        VertexFormat vertexFormat);
 
     void bind(VkCommandBuffer commandBuffer);
-    void draw(VkCommandBuffer commandBuffer);
+    void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance = 0, uint32_t lod = 0);
+
+    uint32_t selectLod(float viewDepth, const glm::vec3& scale, float projectionScale) const;
+    uint32_t getLodCount() const;
+    uint32_t getMeshletCount() const;
+    VkDescriptorBufferInfo getMeshletBufferInfo() const;
+    VkDeviceSize getMemorySize() const;
+
+    const glm::vec3& getBoundsMin() const;
+    const glm::vec3& getBoundsMax() const;
+    VertexFormat getVertexFormat() const;
+    const glm::mat4& getDequantizationMatrix() const;
 
 private:
-    void createVertexBuffers(const std::vector<Vertex>& vertices);
-    void createIndexBuffers(const std::vector<uint32_t>& indices);
+    void createVertexBuffers(
+        const std::vector<uint8_t>& positions,
+        uint32_t positionSize,
+        const std::vector<uint8_t>& attributes,
+        uint32_t attributeSize,
+        std::vector<BufferUpload>* deferredUploads);
+    std::unique_ptr<VgeBuffer> createDeviceLocalBuffer(
+        const void* data,
+        uint32_t elementSize,
+        uint32_t elementCount,
+        VkBufferUsageFlags usage,
+        std::vector<BufferUpload>* deferredUploads);
+    void createIndexBuffers(
+        const std::vector<uint32_t>& indices,
+        std::vector<BufferUpload>* deferredUploads);
+    void createMeshletBuffer(
+        const std::vector<Meshlet>& meshlets,
+        std::vector<BufferUpload>* deferredUploads);
 
     VgeDevice& m_vgeDevice;
 
-    std::unique_ptr<VgeBuffer> m_vertexBuffer;
+    std::unique_ptr<VgeBuffer> m_positionBuffer;  // vertex stream 0
+    std::unique_ptr<VgeBuffer> m_attributeBuffer; // vertex stream 1
     uint32_t m_vertexCount;
+    VertexFormat m_vertexFormat;
+    // maps the vertex buffer's positions to model space, identity for FLOAT
+    glm::mat4 m_dequantizationMatrix;
 
     bool m_hasIndexBuffer = false;
     std::unique_ptr<VgeBuffer> m_indexBuffer;
     uint32_t m_indexCount;
+    VkIndexType m_indexType; // UINT16 whenever the vertex count allows it
+    std::vector<Lod> m_lods; // finest first
+
+    // storage buffer of the full detail LOD's meshlets, null without meshlets
+    std::unique_ptr<VgeBuffer> m_meshletBuffer;
+    uint32_t m_meshletCount;
+
+    // model space axis aligned bounding box of the vertex positions
+    glm::vec3 m_boundsMin;
+    glm::vec3 m_boundsMax;
 };
 
 } // namespace vge
@@ -0,0 +1,389 @@
+#include "vge_obj_reader.hpp"
+#include "vge_utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+namespace vge {
+
+// Corner of a face as indices into the file's lists, -1 where the corner has none
+struct ObjCorner
+{
+    int32_t position = -1;
+    int32_t uv = -1;
+    int32_t normal = -1;
+
+    bool operator==(const ObjCorner& other) const = default;
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner& corner) const
+    {
+        size_t seed = 0;
+        hashCombine(seed, corner.position, corner.uv, corner.normal);
+        return seed;
+    }
+};
+
+// Everything read from the file so far besides the output
+struct ObjReadState
+{
+    ObjReadState(
+        const std::string& filepath,
+        std::vector<VgeModel::Vertex>& vertices,
+        std::vector<uint32_t>& indices)
+        : filepath{ filepath }
+        , lineNumber{ 0 }
+        , positions{}
+        , colors{}
+        , normals{}
+        , uvs{}
+        , corners{}
+        , faceIndices{}
+        , vertices{ vertices }
+        , indices{ indices }
+        , allocatedBytes{ 0 }
+        , peakBytes{ 0 }
+    {
+    }
+
+    const std::string& filepath;
+    size_t lineNumber;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors; // empty until a position comes with a color
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    // output vertex of every distinct corner
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> corners;
+    std::vector<uint32_t> faceIndices; // scratch, the corners of the current face
+    std::vector<VgeModel::Vertex>& vertices;
+    std::vector<uint32_t>& indices;
+    size_t allocatedBytes; // by the containers above, allocator overhead aside
+    size_t peakBytes;      // high-water mark of allocatedBytes
+};
+
+// a node per corner holds its key, value and next pointer, next to the bucket array
+static constexpr size_t CORNER_NODE_SIZE = sizeof(std::pair<const ObjCorner, uint32_t>) +
+                                           sizeof(void*);
+
+template <typename T> static size_t capacityBytes(const std::vector<T>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+/* Counts a container's allocation changing from previousBytes to bytes.
+ *
+ * A reallocation holds the old and the new allocation at once, so the
+ * peak is taken with both before the old one is released.
+ */
+static void trackAllocation(ObjReadState& state, size_t previousBytes, size_t bytes)
+{
+    state.allocatedBytes += bytes;
+    state.peakBytes = std::max(state.peakBytes, state.allocatedBytes);
+    state.allocatedBytes -= previousBytes;
+}
+
+/* Appends a value to one of the read's vectors.
+ *
+ * A growth of the vector is counted by trackAllocation.
+ */
+template <typename T>
+static void pushBack(ObjReadState& state, std::vector<T>& values, const T& value)
+{
+    size_t previousBytes = capacityBytes(values);
+    values.push_back(value);
+    if (capacityBytes(values) != previousBytes) {
+        trackAllocation(state, previousBytes, capacityBytes(values));
+    }
+}
+
+// Returns the error for a malformed line, naming the file and line number.
+static std::runtime_error parseError(const ObjReadState& state, const std::string& what)
+{
+    return std::runtime_error(
+        state.filepath + ":" + std::to_string(state.lineNumber) + ": " + what);
+}
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipSpaces(const char* it, const char* end)
+{
+    while (it != end && isSpace(*it)) {
+        it++;
+    }
+    return it;
+}
+
+/* Parses a number after optional spaces, advancing it past it.
+ *
+ * Returns false, leaving it where it was, when there is no number.
+ */
+template <typename T> static bool parseNumber(const char*& it, const char* end, T& value)
+{
+    const char* begin = skipSpaces(it, end);
+    std::from_chars_result result = std::from_chars(begin, end, value);
+    if (result.ec != std::errc{}) {
+        return false;
+    }
+    it = result.ptr;
+    return true;
+}
+
+/* Turns a 1-based .obj index into a 0-based one.
+ *
+ * Negative indices count back from the last element read so far. Throws
+ * for 0 and for elements that have not been read.
+ */
+static int32_t resolveIndex(const ObjReadState& state, int32_t index, size_t count)
+{
+    int64_t resolved = index > 0 ? static_cast<int64_t>(index) - 1
+                                 : static_cast<int64_t>(count) + index;
+    if (index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(count)) {
+        throw parseError(state, "face index " + std::to_string(index) + " out of range");
+    }
+    return static_cast<int32_t>(resolved);
+}
+
+/* Returns the output vertex of a face corner.
+ *
+ * Corners are welded by their position, texture coordinate and normal
+ * indices: the first use of a combination appends a vertex, later ones
+ * reuse it. Positions without a color are white.
+ */
+static uint32_t weldCorner(ObjReadState& state, const ObjCorner& corner)
+{
+    size_t previousBucketBytes = state.corners.bucket_count() * sizeof(void*);
+    std::pair<std::unordered_map<ObjCorner, uint32_t, ObjCornerHash>::iterator, bool> inserted =
+        state.corners.try_emplace(corner, static_cast<uint32_t>(state.vertices.size()));
+    if (inserted.second) {
+        trackAllocation(state, 0, CORNER_NODE_SIZE);
+        // a rehash holds the old and the new bucket array at once
+        size_t bucketBytes = state.corners.bucket_count() * sizeof(void*);
+        if (bucketBytes != previousBucketBytes) {
+            trackAllocation(state, previousBucketBytes, bucketBytes);
+        }
+
+        VgeModel::Vertex vertex{};
+        vertex.position = state.positions[corner.position];
+        vertex.color = state.colors.empty() ? glm::vec3{ 1.f } : state.colors[corner.position];
+        if (corner.normal >= 0) {
+            vertex.normal = state.normals[corner.normal];
+        }
+        if (corner.uv >= 0) {
+            vertex.uv = state.uvs[corner.uv];
+        }
+        pushBack(state, state.vertices, vertex);
+    }
+    return inserted.first->second;
+}
+
+/* Parses the corners of an "f" line and appends its triangles.
+ *
+ * Corners are v, v/vt, v//vn or v/vt/vn. Polygons are triangulated as a
+ * fan around their first corner.
+ */
+static void parseFace(ObjReadState& state, const char* it, const char* end)
+{
+    state.faceIndices.clear();
+    while ((it = skipSpaces(it, end)) != end) {
+        ObjCorner corner{};
+        int32_t index = 0;
+        if (!parseNumber(it, end, index)) {
+            throw parseError(state, "malformed face");
+        }
+        corner.position = resolveIndex(state, index, state.positions.size());
+
+        if (it != end && *it == '/') {
+            it++;
+            if (it != end && *it != '/') {
+                if (!parseNumber(it, end, index)) {
+                    throw parseError(state, "malformed face");
+                }
+                corner.uv = resolveIndex(state, index, state.uvs.size());
+            }
+            if (it != end && *it == '/') {
+                it++;
+                if (!parseNumber(it, end, index)) {
+                    throw parseError(state, "malformed face");
+                }
+                corner.normal = resolveIndex(state, index, state.normals.size());
+            }
+        }
+        pushBack(state, state.faceIndices, weldCorner(state, corner));
+    }
+
+    if (state.faceIndices.size() < 3) {
+        throw parseError(state, "face with fewer than 3 corners");
+    }
+    for (size_t i = 2; i < state.faceIndices.size(); i++) {
+        pushBack(state, state.indices, state.faceIndices[0]);
+        pushBack(state, state.indices, state.faceIndices[i - 1]);
+        pushBack(state, state.indices, state.faceIndices[i]);
+    }
+}
+
+/* Parses up to maxCount numbers, advancing it past them.
+ *
+ * Stops at the first thing that is not a number. Returns how many were
+ * read, maxCount + 1 when there are more.
+ */
+static size_t parseNumbers(const char*& it, const char* end, float* values, size_t maxCount)
+{
+    size_t count = 0;
+    while (count < maxCount && parseNumber(it, end, values[count])) {
+        count++;
+    }
+    float extra = 0.f;
+    if (count == maxCount && parseNumber(it, end, extra)) {
+        count++;
+    }
+    return count;
+}
+
+/* Parses one line of the file, without its newline.
+ *
+ * Reads positions with optional w and vertex colors, normals, texture
+ * coordinates and faces. Comments, groups, materials and everything else
+ * are skipped.
+ */
+static void parseLine(ObjReadState& state, const char* begin, const char* end)
+{
+    const char* it = skipSpaces(begin, end);
+    const char* keywordBegin = it;
+    while (it != end && !isSpace(*it)) {
+        it++;
+    }
+    std::string_view keyword{ keywordBegin, static_cast<size_t>(it - keywordBegin) };
+
+    if (keyword == "v") {
+        // x y z, x y z w, x y z r g b or x y z w r g b, w is ignored
+        float values[7]{};
+        size_t count = parseNumbers(it, end, values, 7);
+        if (count < 3 || count == 5 || count > 7) {
+            throw parseError(state, "malformed position");
+        }
+        glm::vec3 position{ values[0], values[1], values[2] };
+        bool hasColor = count >= 6;
+        glm::vec3 color{ 1.f };
+        if (hasColor) {
+            size_t first = count - 3;
+            color = glm::vec3{ values[first], values[first + 1], values[first + 2] };
+        }
+        if (hasColor || !state.colors.empty()) {
+            // positions read before the first color are white
+            size_t previousBytes = capacityBytes(state.colors);
+            state.colors.resize(state.positions.size(), glm::vec3{ 1.f });
+            if (capacityBytes(state.colors) != previousBytes) {
+                trackAllocation(state, previousBytes, capacityBytes(state.colors));
+            }
+            pushBack(state, state.colors, color);
+        }
+        pushBack(state, state.positions, position);
+    }
+    else if (keyword == "vn") {
+        glm::vec3 normal{};
+        if (!parseNumber(it, end, normal.x) || !parseNumber(it, end, normal.y) ||
+            !parseNumber(it, end, normal.z))
+        {
+            throw parseError(state, "malformed normal");
+        }
+        pushBack(state, state.normals, normal);
+    }
+    else if (keyword == "vt") {
+        // u, u v or u v w, v defaults to 0 and w is ignored
+        float values[3]{};
+        size_t count = parseNumbers(it, end, values, 3);
+        if (count < 1 || count > 3) {
+            throw parseError(state, "malformed texture coordinate");
+        }
+        pushBack(state, state.uvs, glm::vec2{ values[0], values[1] });
+    }
+    else if (keyword == "f") {
+        parseFace(state, it, end);
+    }
+}
+
+/* Reads a wavefront .obj file into welded vertices and triangle indices.
+ *
+ * The file is read CHUNK_SIZE bytes at a time and parsed line by line,
+ * an unfinished line at the end of a chunk being moved to the front of
+ * the next. The buffer only grows for a line that does not fit. Throws
+ * std::runtime_error naming the file and line for malformed input.
+ *
+ * Returns the bytes the read had allocated at its peak, output included.
+ * Every growth of a container is tracked while its old and new allocation
+ * both exist, so the figure is a true high-water mark, counted per read
+ * rather than for the whole process, which imports on several threads at
+ * once.
+ */
+size_t VgeObjReader::read(
+    const std::string& filepath,
+    std::vector<VgeModel::Vertex>& vertices,
+    std::vector<uint32_t>& indices)
+{
+    std::ifstream file{ filepath, std::ios::binary };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filepath);
+    }
+
+    vertices.clear();
+    indices.clear();
+    ObjReadState state{ filepath, vertices, indices };
+
+    std::vector<char> buffer(CHUNK_SIZE);
+    // the output keeps any capacity it came with
+    trackAllocation(
+        state,
+        0,
+        capacityBytes(buffer) + capacityBytes(vertices) + capacityBytes(indices));
+    size_t carried = 0; // bytes of an unfinished line kept from the previous chunk
+    while (true) {
+        if (carried == buffer.size()) {
+            size_t previousBytes = capacityBytes(buffer);
+            buffer.resize(buffer.size() * 2);
+            trackAllocation(state, previousBytes, capacityBytes(buffer));
+        }
+        file.read(buffer.data() + carried, static_cast<std::streamsize>(buffer.size() - carried));
+        const char* lineBegin = buffer.data();
+        const char* end = buffer.data() + carried + file.gcount();
+
+        while (true) {
+            const char* newline = static_cast<const char*>(
+                std::memchr(lineBegin, '\n', static_cast<size_t>(end - lineBegin)));
+            if (newline == nullptr) {
+                break;
+            }
+            state.lineNumber++;
+            parseLine(state, lineBegin, newline);
+            lineBegin = newline + 1;
+        }
+
+        carried = static_cast<size_t>(end - lineBegin);
+        if (!file) {
+            if (file.bad()) {
+                throw std::runtime_error("failed to read file: " + filepath);
+            }
+            if (carried > 0) { // last line without a newline
+                state.lineNumber++;
+                parseLine(state, lineBegin, end);
+            }
+            break;
+        }
+        std::memmove(buffer.data(), lineBegin, carried);
+    }
+
+    return state.peakBytes;
+}
+
+} // namespace vge
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vge_model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vge {
+
+// Streaming wavefront .obj reader. The file is read in fixed-size chunks and face corners are
+// welded into the output vertices as they are parsed, so besides the output only the file's
+// position, normal and texture coordinate lists are held, never the whole file or its faces
+class VgeObjReader {
+public:
+    // bytes read from the file at a time, grown only for a line longer than this
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    static size_t read(
+        const std::string& filepath,
+        std::vector<VgeModel::Vertex>& vertices,
+        std::vector<uint32_t>& indices);
+};
+
+} // namespace vge
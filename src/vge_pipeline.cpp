@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <bit>
 #include <cassert>
 #include <fstream>
 #include <iostream>
@@ -24,6 +25,8 @@ VgePipeline::VgePipeline(
     , m_graphicsPipeline{}
     , m_vertShaderModule{}
     , m_fragShaderModule{}
+    , m_variantKey{ configInfo.variantKey }
+    , m_variantState{ configInfo.variantState }
 {
     createGraphicsPipeline(vertFilepath, fragFilePath, configInfo);
 }
@@ -101,6 +104,16 @@ void VgePipeline::createGraphicsPipeline(
     createShaderModule(vertCode, &m_vertShaderModule);
     createShaderModule(fragCode, &m_fragShaderModule);
 
+    // Constants are shared by both stages; entries a stage doesn't declare are ignored
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount =
+        static_cast<uint32_t>(configInfo.specializationEntries.size());
+    specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+    specializationInfo.dataSize = configInfo.specializationData.size() * sizeof(uint32_t);
+    specializationInfo.pData = configInfo.specializationData.data();
+    const VkSpecializationInfo* pSpecializationInfo =
+        configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
+
     VkPipelineShaderStageCreateInfo shaderStages[2];
     // Vertex module shader stage[0] info
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -109,7 +122,7 @@ void VgePipeline::createGraphicsPipeline(
     shaderStages[0].pName = "main";
     shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 
     // Fragment module shader stage[1] info
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -118,7 +131,7 @@ void VgePipeline::createGraphicsPipeline(
     shaderStages[1].pName = "main";
     shaderStages[1].flags = 0;
     shaderStages[1].pNext = nullptr;
-    shaderStages[1].pSpecializationInfo = nullptr;
+    shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
     // Vertex data
     const std::vector<VkVertexInputBindingDescription>& bindingDescriptions =
@@ -199,6 +212,22 @@ void VgePipeline::bind(VkCommandBuffer commandBuffer)
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
 }
 
+/* Retrieves the variant key the pipeline was created with.
+ *
+ * The key identifies the set of specialization constants baked into the
+ * pipeline, allowing callers to cache one pipeline per shader variant.
+ */
+uint64_t VgePipeline::getVariantKey() const
+{
+    return m_variantKey;
+}
+
+// Returns the values folded into the variant key, in the order they were folded.
+const std::vector<uint64_t>& VgePipeline::getVariantState() const
+{
+    return m_variantState;
+}
+
 /* Configures the default pipeline settings for the specified PipelineConfigInfo
  * object.
  *
@@ -289,6 +318,60 @@ void VgePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
 
     configInfo.bindingDescriptions = VgeModel::Vertex::getBindingDescriptions();
     configInfo.attributeDescriptions = VgeModel::Vertex::getAttributeDescriptions();
+
+    configInfo.specializationEntries.clear();
+    configInfo.specializationData.clear();
+    configInfo.variantKey = 0;
+    configInfo.variantState.clear();
+}
+
+/* Adds an integer or boolean specialization constant to the configuration.
+ *
+ * The value is appended to the specialization data and mapped to the given
+ * constant_id. The constant is also folded into the variant key so pipelines
+ * compiled with different constants never share a cache slot. Booleans are
+ * passed as VK_TRUE or VK_FALSE.
+ */
+void VgePipeline::addSpecializationConstant(
+    PipelineConfigInfo& configInfo,
+    uint32_t constantId,
+    uint32_t value)
+{
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constantId;
+    entry.offset = static_cast<uint32_t>(configInfo.specializationData.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    configInfo.specializationEntries.push_back(entry);
+    configInfo.specializationData.push_back(value);
+
+    foldVariantKey(configInfo, (static_cast<uint64_t>(constantId) << 32) | value);
+}
+
+/* Folds a value into the variant key of the configuration.
+ *
+ * Callers that vary fixed function state between otherwise identical
+ * variants fold that state in here, so each combination gets its own
+ * cache slot. The value is also kept in variantState, which caches compare
+ * on a key hit since different states can fold to the same key.
+ */
+void VgePipeline::foldVariantKey(PipelineConfigInfo& configInfo, uint64_t value)
+{
+    // FNV-1a style fold into the variant key
+    configInfo.variantKey = (configInfo.variantKey ^ value) * 0x1'00'00'00'01'b3ULL;
+    configInfo.variantState.push_back(value);
+}
+
+/* Adds a floating point specialization constant to the configuration.
+ *
+ * The float is stored by its bit pattern so it occupies the same 4 bytes
+ * the shader expects for a float constant.
+ */
+void VgePipeline::addSpecializationConstant(
+    PipelineConfigInfo& configInfo,
+    uint32_t constantId,
+    float value)
+{
+    addSpecializationConstant(configInfo, constantId, std::bit_cast<uint32_t>(value));
 }
 
 } // namespace vge
@@ -29,6 +29,15 @@ struct PipelineConfigInfo
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass = nullptr;
     uint32_t subpass = 0;
+
+    // Specialization constants shared by every shader stage of the pipeline.
+    // variantKey identifies the combination, plus any fixed function state folded
+    // in with foldVariantKey, so specialized pipelines can be cached. variantState
+    // holds the folded values themselves, to tell apart variants whose keys collide
+    std::vector<VkSpecializationMapEntry> specializationEntries{};
+    std::vector<uint32_t> specializationData{};
+    uint64_t variantKey = 0;
+    std::vector<uint64_t> variantState{};
 };
 
 class VgePipeline {
@@ -45,11 +54,23 @@ public:
 
     void bind(VkCommandBuffer commandBuffer);
 
+    uint64_t getVariantKey() const;
+    const std::vector<uint64_t>& getVariantState() const;
+
     static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    static void addSpecializationConstant(
+        PipelineConfigInfo& configInfo,
+        uint32_t constantId,
+        uint32_t value);
+    static void addSpecializationConstant(
+        PipelineConfigInfo& configInfo,
+        uint32_t constantId,
+        float value);
+    static void foldVariantKey(PipelineConfigInfo& configInfo, uint64_t value);
 
-private:
     static std::vector<char> readFile(const std::string& filepath);
 
+private:
     void createGraphicsPipeline(
         const std::string& vertFilepath,
         const std::string& fragFilePath,
@@ -61,6 +82,8 @@ private:
     VkPipeline m_graphicsPipeline;
     VkShaderModule m_vertShaderModule;
     VkShaderModule m_fragShaderModule;
+    uint64_t m_variantKey;
+    std::vector<uint64_t> m_variantState;
 };
 
 } // namespace vge
@@ -0,0 +1,129 @@
+#include "vge_render_queue.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace vge {
+
+// Constructs an empty VgeRenderQueue object.
+VgeRenderQueue::VgeRenderQueue()
+    : m_items{}
+    , m_scratch{}
+    , m_meshIds{}
+{}
+
+/* Packs draw state and depth into a sort key.
+ *
+ * Each field is masked to its width. depth is the normalized view depth in
+ * [0, 1], clamped and quantized to DEPTH_BITS, so smaller keys are closer
+ * to the camera within the same pipeline, material and mesh.
+ */
+uint64_t VgeRenderQueue::makeSortKey(
+    uint32_t pipeline,
+    uint32_t material,
+    uint32_t mesh,
+    float depth)
+{
+    constexpr uint64_t depthMax = (1ULL << DEPTH_BITS) - 1;
+    uint64_t quantizedDepth =
+        static_cast<uint64_t>(std::clamp(depth, 0.f, 1.f) * static_cast<float>(depthMax));
+
+    uint64_t key = pipeline & ((1ULL << PIPELINE_BITS) - 1);
+    key = (key << MATERIAL_BITS) | (material & ((1ULL << MATERIAL_BITS) - 1));
+    key = (key << MESH_BITS) | (mesh & ((1ULL << MESH_BITS) - 1));
+    key = (key << DEPTH_BITS) | std::min(quantizedDepth, depthMax);
+    return key;
+}
+
+/* Get the small id of a model used in the mesh field of sort keys.
+ *
+ * Ids are handed out on first sight. Once MESH_BITS worth of ids are in
+ * use the table starts over, which only costs sort quality until models
+ * are seen again.
+ */
+uint32_t VgeRenderQueue::getMeshId(const VgeModel* model)
+{
+    if (m_meshIds.size() >= (1ULL << MESH_BITS)) {
+        m_meshIds.clear();
+    }
+    std::pair<std::unordered_map<const VgeModel*, uint32_t>::iterator, bool> inserted =
+        m_meshIds.emplace(model, static_cast<uint32_t>(m_meshIds.size()));
+    return inserted.first->second;
+}
+
+/* Empties the queue for a new frame.
+ *
+ * Capacity is kept, so a steady scene does not allocate per frame.
+ */
+void VgeRenderQueue::clear()
+{
+    m_items.clear();
+}
+
+// Adds a draw of the game object's model at the given LOD with the given sort key.
+void VgeRenderQueue::push(uint64_t sortKey, VgeGameObject& gameObject, uint32_t lod)
+{
+    m_items.push_back({ sortKey, &gameObject, lod });
+}
+
+/* Sorts the queued draws by ascending sort key.
+ *
+ * LSD radix sort over 8-bit digits. The histograms of all digits are built
+ * in a single pass over the keys, and passes whose digit is the same for
+ * every key are skipped, so unused key fields cost nothing. Stable, linear
+ * in the number of draws.
+ */
+void VgeRenderQueue::sort()
+{
+    constexpr size_t RADIX_BITS = 8;
+    constexpr size_t RADIX = 1 << RADIX_BITS;
+    constexpr size_t PASSES = 64 / RADIX_BITS;
+
+    size_t count = m_items.size();
+    if (count < 2) {
+        return;
+    }
+
+    std::array<std::array<uint32_t, RADIX>, PASSES> histograms{};
+    for (const DrawItem& item : m_items) {
+        for (size_t pass = 0; pass < PASSES; pass++) {
+            histograms[pass][(item.sortKey >> (pass * RADIX_BITS)) & (RADIX - 1)]++;
+        }
+    }
+
+    m_scratch.resize(count);
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        std::array<uint32_t, RADIX>& histogram = histograms[pass];
+        size_t digit = (m_items[0].sortKey >> (pass * RADIX_BITS)) & (RADIX - 1);
+        if (histogram[digit] == count) {
+            continue; // every key has the same digit, order is unchanged
+        }
+
+        // exclusive prefix sum turns counts into output offsets
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram) {
+            uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        for (const DrawItem& item : m_items) {
+            m_scratch[histogram[(item.sortKey >> (pass * RADIX_BITS)) & (RADIX - 1)]++] = item;
+        }
+        m_items.swap(m_scratch);
+    }
+}
+
+// Returns the queued draws, in sorted order after sort().
+const std::vector<VgeRenderQueue::DrawItem>& VgeRenderQueue::getItems() const
+{
+    return m_items;
+}
+
+// Returns the number of queued draws.
+size_t VgeRenderQueue::size() const
+{
+    return m_items.size();
+}
+
+} // namespace vge
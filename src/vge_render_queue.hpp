@@ -0,0 +1,51 @@
+#pragma once
+
+#include "vge_game_object.hpp"
+#include "vge_model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vge {
+
+// Per-frame list of draws ordered by a packed 64-bit sort key. From the most significant bits
+// down: pipeline, material, mesh, then quantized view depth, so draws sharing state end up
+// adjacent and each state bucket is drawn front to back
+class VgeRenderQueue {
+public:
+    static constexpr uint32_t PIPELINE_BITS = 8;
+    static constexpr uint32_t MATERIAL_BITS = 16;
+    static constexpr uint32_t MESH_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS = 24;
+
+    struct DrawItem
+    {
+        uint64_t sortKey = 0;
+        VgeGameObject* gameObject = nullptr;
+        uint32_t lod = 0; // LOD of the game object's model to draw
+    };
+
+    VgeRenderQueue();
+
+    VgeRenderQueue(const VgeRenderQueue&) = delete;
+    VgeRenderQueue& operator=(const VgeRenderQueue&) = delete;
+
+    static uint64_t makeSortKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+    uint32_t getMeshId(const VgeModel* model);
+    void clear();
+    void push(uint64_t sortKey, VgeGameObject& gameObject, uint32_t lod = 0);
+    void sort();
+
+    const std::vector<DrawItem>& getItems() const;
+    size_t size() const;
+
+private:
+    std::vector<DrawItem> m_items;
+    std::vector<DrawItem> m_scratch; // radix sort ping-pong buffer, kept to avoid reallocation
+    std::unordered_map<const VgeModel*, uint32_t> m_meshIds;
+};
+
+} // namespace vge
@@ -241,6 +241,27 @@ float VgeRenderer::getAspectRatio() const
     return m_vgeSwapChain->extentAspectRatio();
 }
 
+/* Retrieves the extent of the swap chain images.
+ *
+ * This method returns the size in pixels of the images currently being
+ * rendered to, which changes whenever the swap chain is recreated.
+ */
+VkExtent2D VgeRenderer::getSwapChainExtent() const
+{
+    return m_vgeSwapChain->getSwapChainExtent();
+}
+
+/* Retrieves the depth image view of the current frame's swap chain image.
+ *
+ * After the swap chain render pass has ended, the view holds the frame's
+ * depth in the depth read only layout.
+ */
+VkImageView VgeRenderer::getCurrentDepthImageView() const
+{
+    assert(m_isFrameStarted && "Cannot get depth image view when frame not in progress");
+    return m_vgeSwapChain->getDepthImageView(m_currentImageIndex);
+}
+
 /* Checks if a rendering frame is currently in progress.
  *
  * This method returns a boolean indicating whether the renderer is currently
@@ -23,6 +23,8 @@ public:
 
     VkRenderPass getSwapChainRenderPass() const;
     float getAspectRatio() const;
+    VkExtent2D getSwapChainExtent() const;
+    VkImageView getCurrentDepthImageView() const;
     bool isFrameInProgress() const;
     VkCommandBuffer getCurrentCommandBuffer() const;
     uint32_t getFrameIndex() const;
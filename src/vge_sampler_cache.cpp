@@ -0,0 +1,88 @@
+#include "vge_sampler_cache.hpp"
+#include "vge_utils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vge {
+
+size_t VgeSamplerCache::SamplerStateHash::operator()(const VgeSamplerState& state) const
+{
+    size_t seed = 0;
+    hashCombine(
+        seed,
+        state.magFilter,
+        state.minFilter,
+        state.mipmapMode,
+        state.addressMode,
+        state.maxAnisotropy,
+        state.maxLod);
+    return seed;
+}
+
+/* Constructs an empty VgeSamplerCache.
+ *
+ * Samplers are created on first request.
+ */
+VgeSamplerCache::VgeSamplerCache(VgeDevice& device)
+    : m_vgeDevice{ device }
+    , m_samplers{}
+{}
+
+/* Destroys the VgeSamplerCache object.
+ *
+ * Destroys every sampler it handed out, nothing may still sample with
+ * them.
+ */
+VgeSamplerCache::~VgeSamplerCache()
+{
+    for (std::pair<const VgeSamplerState, VkSampler>& kv : m_samplers) {
+        vkDestroySampler(m_vgeDevice.getDevice(), kv.second, nullptr);
+    }
+}
+
+/* Get the sampler for the given state, creating it on first use.
+ *
+ * Anisotropy is clamped to the device limit before the sampler is
+ * created, the cache is keyed by the requested state.
+ */
+VkSampler VgeSamplerCache::getSampler(const VgeSamplerState& state)
+{
+    std::unordered_map<VgeSamplerState, VkSampler, SamplerStateHash>::iterator it =
+        m_samplers.find(state);
+    if (it != m_samplers.end()) {
+        return it->second;
+    }
+
+    float maxAnisotropy =
+        std::min(state.maxAnisotropy, m_vgeDevice.m_properties.limits.maxSamplerAnisotropy);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = state.magFilter;
+    samplerInfo.minFilter = state.minFilter;
+    samplerInfo.mipmapMode = state.mipmapMode;
+    samplerInfo.addressModeU = state.addressMode;
+    samplerInfo.addressModeV = state.addressMode;
+    samplerInfo.addressModeW = state.addressMode;
+    samplerInfo.anisotropyEnable = maxAnisotropy > 1.f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = std::max(maxAnisotropy, 1.f);
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = state.maxLod;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    if (vkCreateSampler(m_vgeDevice.getDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create sampler!");
+    }
+    m_samplers.emplace(state, sampler);
+    return sampler;
+}
+
+// Returns the number of distinct samplers created so far.
+size_t VgeSamplerCache::size() const
+{
+    return m_samplers.size();
+}
+
+} // namespace vge
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vge_device.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace vge {
+
+// Sampler settings, the key VgeSamplerCache shares samplers by
+struct VgeSamplerState
+{
+    VkFilter magFilter = VK_FILTER_LINEAR;
+    VkFilter minFilter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT; // U, V and W
+    float maxAnisotropy = 16.f; // clamped to the device limit, <= 1 disables anisotropy
+    float maxLod = VK_LOD_CLAMP_NONE;
+
+    bool operator==(const VgeSamplerState& other) const = default;
+};
+
+// Owns one VkSampler per distinct VgeSamplerState, so textures sampled the same way share it
+class VgeSamplerCache {
+public:
+    VgeSamplerCache(VgeDevice& device);
+    ~VgeSamplerCache();
+
+    VgeSamplerCache(const VgeSamplerCache&) = delete;
+    VgeSamplerCache& operator=(const VgeSamplerCache&) = delete;
+
+    VkSampler getSampler(const VgeSamplerState& state = VgeSamplerState{});
+    size_t size() const;
+
+private:
+    struct SamplerStateHash
+    {
+        size_t operator()(const VgeSamplerState& state) const;
+    };
+
+    VgeDevice& m_vgeDevice;
+    std::unordered_map<VgeSamplerState, VkSampler, SamplerStateHash> m_samplers;
+};
+
+} // namespace vge
@@ -0,0 +1,308 @@
+#include "vge_scene.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bit>
+#include <fstream>
+#include <stdexcept>
+
+namespace vge {
+
+// the arrays are mapped as they are stored
+static_assert(std::endian::native == std::endian::little, "Scene files are little-endian");
+
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + VgeScene::ALIGNMENT - 1) & ~(VgeScene::ALIGNMENT - 1);
+}
+
+/* Checks that an array of the file lies within it and is aligned.
+ *
+ * Written so that corrupt counts and offsets can't overflow the check.
+ */
+static bool isArrayInFile(uint64_t offset, uint64_t count, uint64_t elementSize, size_t fileSize)
+{
+    return offset % VgeScene::ALIGNMENT == 0 && offset <= fileSize &&
+           count <= (fileSize - offset) / elementSize;
+}
+
+/* Writes an array at its offset in the file.
+ *
+ * written is the size of the file so far, the gap up to offset, less
+ * than ALIGNMENT, is filled with zeros.
+ */
+static void writeArray(
+    std::ofstream& file,
+    uint64_t& written,
+    uint64_t offset,
+    const void* data,
+    uint64_t size)
+{
+    const char zeros[VgeScene::ALIGNMENT]{};
+    file.write(zeros, static_cast<std::streamsize>(offset - written));
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    written = offset + size;
+}
+
+// Returns whether a string lies within a string table of the given size.
+static bool isStringInTable(uint32_t offset, uint32_t length, uint32_t tableSize)
+{
+    return offset <= tableSize && length <= tableSize - offset;
+}
+
+/* Adds a model file to the scene.
+ *
+ * Its path is appended to the string table. Returns the model's index for
+ * the entities drawing it.
+ */
+uint32_t VgeScene::Builder::addModel(const std::string& filepath, uint32_t vertexFormat)
+{
+    Model model{};
+    model.pathOffset = static_cast<uint32_t>(stringTable.size());
+    model.pathLength = static_cast<uint32_t>(filepath.size());
+    model.vertexFormat = vertexFormat;
+    stringTable.insert(stringTable.end(), filepath.begin(), filepath.end());
+    models.push_back(model);
+    return static_cast<uint32_t>(models.size() - 1);
+}
+
+/* Adds a texture file to the scene.
+ *
+ * Its path is appended to the string table. Returns the texture's index
+ * for the entities sampling it.
+ */
+uint32_t VgeScene::Builder::addTexture(const std::string& filepath)
+{
+    Texture texture{};
+    texture.pathOffset = static_cast<uint32_t>(stringTable.size());
+    texture.pathLength = static_cast<uint32_t>(filepath.size());
+    stringTable.insert(stringTable.end(), filepath.begin(), filepath.end());
+    textures.push_back(texture);
+    return static_cast<uint32_t>(textures.size() - 1);
+}
+
+/* Writes the scene to a file in the binary format.
+ *
+ * The header comes first, then the entity, model, texture, light and
+ * string arrays, each starting at the next multiple of ALIGNMENT with
+ * zeros in between.
+ */
+void VgeScene::Builder::write(const std::string& filepath) const
+{
+    Header header{};
+    header.entityCount = static_cast<uint32_t>(entities.size());
+    header.modelCount = static_cast<uint32_t>(models.size());
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.lightCount = static_cast<uint32_t>(lights.size());
+    header.stringTableSize = static_cast<uint32_t>(stringTable.size());
+    header.entityOffset = alignOffset(sizeof(Header));
+    header.modelOffset = alignOffset(header.entityOffset + entities.size() * sizeof(Entity));
+    header.textureOffset = alignOffset(header.modelOffset + models.size() * sizeof(Model));
+    header.lightOffset = alignOffset(header.textureOffset + textures.size() * sizeof(Texture));
+    header.stringTableOffset = alignOffset(header.lightOffset + lights.size() * sizeof(Light));
+
+    std::ofstream file{ filepath, std::ios::binary | std::ios::trunc };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filepath);
+    }
+
+    uint64_t written = 0;
+    writeArray(file, written, 0, &header, sizeof(Header));
+    writeArray(
+        file,
+        written,
+        header.entityOffset,
+        entities.data(),
+        entities.size() * sizeof(Entity));
+    writeArray(file, written, header.modelOffset, models.data(), models.size() * sizeof(Model));
+    writeArray(
+        file,
+        written,
+        header.textureOffset,
+        textures.data(),
+        textures.size() * sizeof(Texture));
+    writeArray(file, written, header.lightOffset, lights.data(), lights.size() * sizeof(Light));
+    writeArray(file, written, header.stringTableOffset, stringTable.data(), stringTable.size());
+
+    if (!file) {
+        throw std::runtime_error("failed to write file: " + filepath);
+    }
+}
+
+/* Constructs a VgeScene by memory-mapping a scene file.
+ *
+ * The file is mapped read-only and the kernel asked to read it ahead, then
+ * the header and the references between the arrays are validated. Nothing
+ * is copied, the getters point into the mapping.
+ */
+VgeScene::VgeScene(const std::string& filepath)
+    : m_filepath{ filepath }
+    , m_data{ nullptr }
+    , m_size{ 0 }
+    , m_header{ nullptr }
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file: " + filepath);
+    }
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        throw std::runtime_error(filepath + ": not a scene file, too small");
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Failed to map scene file: " + filepath + "!");
+    }
+    madvise(data, m_size, MADV_WILLNEED);
+    m_data = static_cast<const std::byte*>(data);
+    m_header = reinterpret_cast<const Header*>(m_data);
+
+    try {
+        validate();
+    }
+    catch (...) {
+        munmap(data, m_size);
+        throw;
+    }
+}
+
+/* Destroys the VgeScene object.
+ *
+ * Unmaps the file, invalidating every pointer the getters returned.
+ */
+VgeScene::~VgeScene()
+{
+    munmap(const_cast<std::byte*>(m_data), m_size);
+}
+
+/* Checks the file before its arrays are used in place.
+ *
+ * Every array must lie within the file, aligned, every path within the
+ * string table and every entity's model and texture index in range. Throws
+ * std::runtime_error naming the file otherwise.
+ */
+void VgeScene::validate() const
+{
+    if (m_header->magic != MAGIC) {
+        throw std::runtime_error(m_filepath + ": not a scene file");
+    }
+    if (m_header->version != VERSION) {
+        throw std::runtime_error(
+            m_filepath + ": unsupported scene version " + std::to_string(m_header->version));
+    }
+    if (!isArrayInFile(m_header->entityOffset, m_header->entityCount, sizeof(Entity), m_size) ||
+        !isArrayInFile(m_header->modelOffset, m_header->modelCount, sizeof(Model), m_size) ||
+        !isArrayInFile(m_header->textureOffset, m_header->textureCount, sizeof(Texture), m_size) ||
+        !isArrayInFile(m_header->lightOffset, m_header->lightCount, sizeof(Light), m_size) ||
+        !isArrayInFile(m_header->stringTableOffset, m_header->stringTableSize, 1, m_size))
+    {
+        throw std::runtime_error(m_filepath + ": scene array out of bounds");
+    }
+
+    const Model* models = getModels();
+    for (uint32_t i = 0; i < m_header->modelCount; i++) {
+        if (!isStringInTable(models[i].pathOffset, models[i].pathLength, m_header->stringTableSize))
+        {
+            throw std::runtime_error(m_filepath + ": model path out of bounds");
+        }
+    }
+    const Texture* textures = getTextures();
+    for (uint32_t i = 0; i < m_header->textureCount; i++) {
+        if (!isStringInTable(
+                textures[i].pathOffset,
+                textures[i].pathLength,
+                m_header->stringTableSize))
+        {
+            throw std::runtime_error(m_filepath + ": texture path out of bounds");
+        }
+    }
+
+    const Entity* entities = getEntities();
+    for (uint32_t i = 0; i < m_header->entityCount; i++) {
+        if (entities[i].modelIndex != NO_MODEL && entities[i].modelIndex >= m_header->modelCount)
+        {
+            throw std::runtime_error(m_filepath + ": entity model index out of range");
+        }
+        if (entities[i].textureIndex != NO_TEXTURE &&
+            entities[i].textureIndex >= m_header->textureCount)
+        {
+            throw std::runtime_error(m_filepath + ": entity texture index out of range");
+        }
+    }
+}
+
+// Returns the number of entities in the scene.
+uint32_t VgeScene::getEntityCount() const
+{
+    return m_header->entityCount;
+}
+
+// Returns the entity array, valid while the scene is alive.
+const VgeScene::Entity* VgeScene::getEntities() const
+{
+    return reinterpret_cast<const Entity*>(m_data + m_header->entityOffset);
+}
+
+// Returns the number of models in the scene.
+uint32_t VgeScene::getModelCount() const
+{
+    return m_header->modelCount;
+}
+
+// Returns the model array, valid while the scene is alive.
+const VgeScene::Model* VgeScene::getModels() const
+{
+    return reinterpret_cast<const Model*>(m_data + m_header->modelOffset);
+}
+
+// Returns the number of textures in the scene.
+uint32_t VgeScene::getTextureCount() const
+{
+    return m_header->textureCount;
+}
+
+// Returns the texture array, valid while the scene is alive.
+const VgeScene::Texture* VgeScene::getTextures() const
+{
+    return reinterpret_cast<const Texture*>(m_data + m_header->textureOffset);
+}
+
+// Returns the number of point lights in the scene.
+uint32_t VgeScene::getLightCount() const
+{
+    return m_header->lightCount;
+}
+
+// Returns the point light array, valid while the scene is alive.
+const VgeScene::Light* VgeScene::getLights() const
+{
+    return reinterpret_cast<const Light*>(m_data + m_header->lightOffset);
+}
+
+// Returns a model's file path, a view into the mapped string table.
+std::string_view VgeScene::getModelPath(const Model& model) const
+{
+    return getString(model.pathOffset, model.pathLength);
+}
+
+// Returns a texture's file path, a view into the mapped string table.
+std::string_view VgeScene::getTexturePath(const Texture& texture) const
+{
+    return getString(texture.pathOffset, texture.pathLength);
+}
+
+// Returns a view of a string in the mapped string table.
+std::string_view VgeScene::getString(uint32_t offset, uint32_t length) const
+{
+    const char* strings = reinterpret_cast<const char*>(m_data + m_header->stringTableOffset);
+    return std::string_view{ strings + offset, length };
+}
+
+} // namespace vge
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace vge {
+
+// Binary scene file, memory-mapped and read in place. The file is a header followed by flat
+// arrays of entities, models, textures, lights and a string table, little-endian and aligned
+// to ALIGNMENT from the start of the file, so the arrays are used straight from the mapping
+// and loading costs the page faults of touching them rather than any parsing
+class VgeScene {
+public:
+    static constexpr uint32_t MAGIC = 0x53'45'47'56; // "VGES" in file order
+    static constexpr uint32_t VERSION = 2; // 2 added textures
+    static constexpr uint64_t ALIGNMENT = 16;
+    static constexpr uint32_t NO_MODEL = UINT32_MAX;
+    static constexpr uint32_t NO_TEXTURE = UINT32_MAX;
+
+    struct Header
+    {
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t entityCount = 0;
+        uint32_t modelCount = 0;
+        uint32_t textureCount = 0;
+        uint32_t lightCount = 0;
+        uint32_t stringTableSize = 0; // bytes
+        uint32_t padding = 0;
+        uint64_t entityOffset = 0; // byte offsets from the start of the file
+        uint64_t modelOffset = 0;
+        uint64_t textureOffset = 0;
+        uint64_t lightOffset = 0;
+        uint64_t stringTableOffset = 0;
+        uint64_t reserved = 0;
+    };
+
+    // A game object, its transform as in TransformComponent
+    struct Entity
+    {
+        float translation[3]{};
+        float rotation[3]{};
+        float scale[3]{ 1.f, 1.f, 1.f };
+        uint32_t modelIndex = NO_MODEL;     // into the model array
+        uint32_t textureIndex = NO_TEXTURE; // into the texture array
+        uint32_t padding = 0;
+    };
+
+    // A model file, shared by every entity referencing its index
+    struct Model
+    {
+        uint32_t pathOffset = 0; // into the string table, not null terminated
+        uint32_t pathLength = 0;
+        uint32_t vertexFormat = 0; // VgeModel::VertexFormat
+        uint32_t padding = 0;
+    };
+
+    // A TGA or KTX2 image sampled by the entities referencing its index, as createTextureFromFile
+    struct Texture
+    {
+        uint32_t pathOffset = 0; // into the string table, not null terminated
+        uint32_t pathLength = 0;
+        uint32_t padding[2]{};
+    };
+
+    struct Light
+    {
+        float position[3]{};
+        float radius = 0.1f;
+        float color[3]{ 1.f, 1.f, 1.f };
+        float intensity = 10.f;
+    };
+
+    // Assembles a scene in memory and writes it in the binary format
+    struct Builder
+    {
+        std::vector<Entity> entities{};
+        std::vector<Model> models{};
+        std::vector<Texture> textures{};
+        std::vector<Light> lights{};
+        std::vector<char> stringTable{};
+
+        uint32_t addModel(const std::string& filepath, uint32_t vertexFormat);
+        uint32_t addTexture(const std::string& filepath);
+        void write(const std::string& filepath) const;
+    };
+
+    VgeScene(const std::string& filepath);
+    ~VgeScene();
+
+    VgeScene(const VgeScene&) = delete;
+    VgeScene& operator=(const VgeScene&) = delete;
+
+    uint32_t getEntityCount() const;
+    const Entity* getEntities() const;
+    uint32_t getModelCount() const;
+    const Model* getModels() const;
+    uint32_t getTextureCount() const;
+    const Texture* getTextures() const;
+    uint32_t getLightCount() const;
+    const Light* getLights() const;
+    std::string_view getModelPath(const Model& model) const;
+    std::string_view getTexturePath(const Texture& texture) const;
+
+private:
+    void validate() const;
+    std::string_view getString(uint32_t offset, uint32_t length) const;
+
+    std::string m_filepath;
+    const std::byte* m_data; // read-only mapping of the whole file
+    size_t m_size;
+    const Header* m_header;
+};
+
+// the arrays are used in place, so their layout is the file format
+static_assert(sizeof(VgeScene::Header) == 80 && std::is_trivially_copyable_v<VgeScene::Header>);
+static_assert(sizeof(VgeScene::Entity) == 48 && std::is_trivially_copyable_v<VgeScene::Entity>);
+static_assert(sizeof(VgeScene::Model) == 16 && std::is_trivially_copyable_v<VgeScene::Model>);
+static_assert(sizeof(VgeScene::Texture) == 16 && std::is_trivially_copyable_v<VgeScene::Texture>);
+static_assert(sizeof(VgeScene::Light) == 32 && std::is_trivially_copyable_v<VgeScene::Light>);
+
+} // namespace vge
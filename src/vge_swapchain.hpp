@@ -26,6 +26,7 @@ public:
     VkFramebuffer getFrameBuffer(size_t index);
     VkRenderPass getRenderPass();
     VkImageView getImageView(size_t index);
+    VkImageView getDepthImageView(size_t index);
     size_t imageCount();
     VkFormat getSwapChainImageFormat();
     VkExtent2D getSwapChainExtent();
@@ -0,0 +1,685 @@
+#include "vge_texture.hpp"
+#include "vge_buffer.hpp"
+#include "vge_texture_compressor.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace vge {
+
+/* Records a layout transition of a range of mip levels.
+ *
+ * Waits for srcAccess in srcStage before dstAccess in dstStage may touch
+ * the levels in their new layout.
+ */
+static void transitionMipLevels(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    uint32_t baseMipLevel,
+    uint32_t levelCount,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage,
+    VkPipelineStageFlags dstStage)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        srcStage,
+        dstStage,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &barrier);
+}
+
+/* Returns the bytes per 4x4 block of a BC format, 0 for other formats.
+ *
+ * BC1 and BC4 store 8 bytes per block, BC2, BC3, BC5, BC6H and BC7 16.
+ */
+static size_t getBlockSize(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        return 8;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+/* Constructs a VgeTexture from the given device and builder.
+ *
+ * Creates the image and uploads it through a staging buffer: the
+ * builder's encoded levels when it has any, all of them copied as they
+ * are, else its pixels to level 0, from which the rest of the mip chain
+ * is blitted unless disabled. The texture is left in getImageLayout for
+ * sampling.
+ */
+VgeTexture::VgeTexture(VgeDevice& device, const VgeTexture::Builder& builder)
+    : m_vgeDevice{ device }
+    , m_format{ builder.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM }
+    , m_extent{ builder.width, builder.height }
+    , m_mipLevels{ 1 }
+    , m_image{}
+    , m_imageMemory{}
+    , m_imageView{}
+{
+    assert(m_extent.width > 0 && m_extent.height > 0 && "Texture must not be empty");
+
+    if (!builder.levels.empty()) {
+        assert(builder.format != VK_FORMAT_UNDEFINED && "Texture levels need a format");
+        m_format = builder.format;
+        m_mipLevels = static_cast<uint32_t>(builder.levels.size());
+        // BC formats are optional, throws on devices without them
+        m_vgeDevice.findSupportedFormat(
+            { m_format },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+        createImage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+        uploadLevels(builder.levels);
+        createImageView();
+        return;
+    }
+
+    assert(builder.pixels.size() == static_cast<size_t>(m_extent.width) * m_extent.height * 4 &&
+           "Texture pixels must be RGBA8");
+
+    if (builder.generateMipmaps) {
+        // blitting needs linear filtering support on the format, required for RGBA8 by the spec
+        m_vgeDevice.findSupportedFormat(
+            { m_format },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                VK_FORMAT_FEATURE_BLIT_DST_BIT);
+        // down to 1x1, floor(log2(largest side)) + 1 levels
+        uint32_t largestSide = std::max(m_extent.width, m_extent.height);
+        m_mipLevels = static_cast<uint32_t>(std::bit_width(largestSide));
+    }
+
+    createImage(
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+        VK_IMAGE_USAGE_SAMPLED_BIT);
+    uploadPixels(builder.pixels);
+    createImageView();
+}
+
+/* Destroys the VgeTexture object.
+ *
+ * Cleans up the image view, image and its memory.
+ */
+VgeTexture::~VgeTexture()
+{
+    vkDestroyImageView(m_vgeDevice.getDevice(), m_imageView, nullptr);
+    vkDestroyImage(m_vgeDevice.getDevice(), m_image, nullptr);
+    vkFreeMemory(m_vgeDevice.getDevice(), m_imageMemory, nullptr);
+}
+
+/* Creates a texture from an image file.
+ *
+ * A .ktx2 file is loaded with Builder::loadKtx2 and uploaded in its
+ * format. Anything else is loaded with Builder::loadTga as sRGB color
+ * with mipmaps and block-compressed if the device samples BC formats.
+ * Returns a unique pointer to the created VgeTexture.
+ */
+std::unique_ptr<VgeTexture> VgeTexture::createTextureFromFile(
+    VgeDevice& device,
+    const std::string& filepath)
+{
+    Builder builder{};
+    if (std::filesystem::path{ filepath }.extension() == ".ktx2") {
+        builder.loadKtx2(filepath);
+    }
+    else {
+        builder.loadTga(filepath);
+        builder.compress(device);
+    }
+
+    size_t size = builder.pixels.size();
+    for (const std::vector<uint8_t>& level : builder.levels) {
+        size += level.size();
+    }
+    std::unique_ptr<VgeTexture> texture = std::make_unique<VgeTexture>(device, builder);
+    std::cout << filepath << ": " << builder.width << "x" << builder.height << ", "
+              << texture->getMipLevels() << " mip levels, "
+              << (builder.levels.empty() ? "RGBA8 " : "block-compressed ") << size / 1024.f
+              << " KiB uploaded" << std::endl;
+    return texture;
+}
+
+/* Creates the device-local image of all mip levels.
+ *
+ * Levels are transfer destinations while uploaded and, for generated
+ * mipmaps, transfer sources while the next level is blitted from them.
+ */
+void VgeTexture::createImage(VkImageUsageFlags usage)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = m_extent.width;
+    imageInfo.extent.height = m_extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = m_mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = m_format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    m_vgeDevice.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_image,
+        m_imageMemory);
+}
+
+/* Uploads level 0 and fills in the other levels.
+ *
+ * The copy, mip generation and final transitions are recorded into one
+ * single-time command buffer, so the staging buffer can be freed on
+ * return.
+ */
+void VgeTexture::uploadPixels(const std::vector<uint8_t>& pixels)
+{
+    VgeBuffer stagingBuffer{
+        m_vgeDevice,
+        4,
+        static_cast<uint32_t>(pixels.size() / 4),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    };
+    stagingBuffer.map();
+    stagingBuffer.writeToBuffer((void*)pixels.data());
+
+    VkCommandBuffer commandBuffer = m_vgeDevice.beginSingleTimeCommands();
+    transitionMipLevels(
+        commandBuffer,
+        m_image,
+        0,
+        m_mipLevels,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { m_extent.width, m_extent.height, 1 };
+    vkCmdCopyBufferToImage(
+        commandBuffer,
+        stagingBuffer.getBuffer(),
+        m_image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1,
+        &region);
+
+    generateMipmaps(commandBuffer);
+    m_vgeDevice.endSingleTimeCommands(commandBuffer);
+}
+
+/* Uploads every mip level as encoded.
+ *
+ * The levels are packed one after another into a single staging buffer,
+ * each at a multiple of its texel block size since every level is made
+ * of whole blocks, and copied with one region per level. Recorded with
+ * the transitions into one single-time command buffer.
+ */
+void VgeTexture::uploadLevels(const std::vector<std::vector<uint8_t>>& levels)
+{
+    std::vector<uint8_t> data{};
+    std::vector<VkBufferImageCopy> regions(levels.size());
+    for (uint32_t level = 0; level < levels.size(); level++) {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = data.size();
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { std::max(m_extent.width >> level, 1u),
+                               std::max(m_extent.height >> level, 1u),
+                               1 };
+        data.insert(data.end(), levels[level].begin(), levels[level].end());
+    }
+
+    VgeBuffer stagingBuffer{
+        m_vgeDevice,
+        1,
+        static_cast<uint32_t>(data.size()),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    };
+    stagingBuffer.map();
+    stagingBuffer.writeToBuffer((void*)data.data());
+
+    VkCommandBuffer commandBuffer = m_vgeDevice.beginSingleTimeCommands();
+    transitionMipLevels(
+        commandBuffer,
+        m_image,
+        0,
+        m_mipLevels,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyBufferToImage(
+        commandBuffer,
+        stagingBuffer.getBuffer(),
+        m_image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()),
+        regions.data());
+    transitionMipLevels(
+        commandBuffer,
+        m_image,
+        0,
+        m_mipLevels,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    m_vgeDevice.endSingleTimeCommands(commandBuffer);
+}
+
+/* Records the blits filling in levels 1 and up, each from the one above.
+ *
+ * Expects every level in TRANSFER_DST_OPTIMAL with level 0 written. Each
+ * source level becomes a transfer source for its blit, then is handed to
+ * fragment shaders, as is the last level once written. Without mipmaps
+ * only level 0's transition is recorded.
+ */
+void VgeTexture::generateMipmaps(VkCommandBuffer commandBuffer)
+{
+    int32_t width = static_cast<int32_t>(m_extent.width);
+    int32_t height = static_cast<int32_t>(m_extent.height);
+    for (uint32_t level = 1; level < m_mipLevels; level++) {
+        transitionMipLevels(
+            commandBuffer,
+            m_image,
+            level - 1,
+            1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        int32_t nextWidth = std::max(width / 2, 1);
+        int32_t nextHeight = std::max(height / 2, 1);
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1] = { width, height, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+        blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+        vkCmdBlitImage(
+            commandBuffer,
+            m_image,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            m_image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &blit,
+            VK_FILTER_LINEAR);
+
+        transitionMipLevels(
+            commandBuffer,
+            m_image,
+            level - 1,
+            1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    transitionMipLevels(
+        commandBuffer,
+        m_image,
+        m_mipLevels - 1,
+        1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+// Creates the image view over all mip levels.
+void VgeTexture::createImageView()
+{
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = m_format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = m_mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(m_vgeDevice.getDevice(), &viewInfo, nullptr, &m_imageView) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create texture image view!");
+    }
+}
+
+// Returns the image view over all mip levels.
+VkImageView VgeTexture::getImageView() const
+{
+    return m_imageView;
+}
+
+// Returns the layout the texture is sampled in.
+VkImageLayout VgeTexture::getImageLayout() const
+{
+    return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+// Returns the texel format.
+VkFormat VgeTexture::getFormat() const
+{
+    return m_format;
+}
+
+// Returns the size of mip level 0.
+VkExtent2D VgeTexture::getExtent() const
+{
+    return m_extent;
+}
+
+// Returns the number of mip levels, 1 without mipmaps.
+uint32_t VgeTexture::getMipLevels() const
+{
+    return m_mipLevels;
+}
+
+/* Loads a Truevision TGA image into the builder as RGBA8.
+ *
+ * Reads uncompressed and run-length encoded true-color (24 or 32 bit) and
+ * grayscale (8 bit) images, the formats image tools write by default.
+ * Pixels are reordered to RGBA, rows to top to bottom. Throws
+ * std::runtime_error for anything else.
+ */
+void VgeTexture::Builder::loadTga(const std::string& filepath)
+{
+    std::ifstream file{ filepath, std::ios::binary };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filepath);
+    }
+    std::vector<uint8_t> data{ std::istreambuf_iterator<char>(file),
+                               std::istreambuf_iterator<char>() };
+
+    constexpr size_t HEADER_SIZE = 18;
+    if (data.size() < HEADER_SIZE) {
+        throw std::runtime_error(filepath + ": not a TGA file");
+    }
+    uint8_t idLength = data[0];
+    uint8_t colorMapType = data[1];
+    uint8_t imageType = data[2];
+    uint32_t imageWidth = data[12] | (data[13] << 8);
+    uint32_t imageHeight = data[14] | (data[15] << 8);
+    uint8_t pixelDepth = data[16];
+    bool topToBottom = (data[17] & 0x20) != 0;
+
+    // 2 and 10 true-color, 3 and 11 grayscale, + 8 when run-length encoded
+    bool runLengthEncoded = imageType == 10 || imageType == 11;
+    bool grayscale = imageType == 3 || imageType == 11;
+    uint32_t bytesPerPixel = pixelDepth / 8;
+    if (colorMapType != 0 || (imageType != 2 && imageType != 3 && !runLengthEncoded) ||
+        (grayscale ? pixelDepth != 8 : pixelDepth != 24 && pixelDepth != 32) || imageWidth == 0 ||
+        imageHeight == 0)
+    {
+        throw std::runtime_error(filepath + ": unsupported TGA format");
+    }
+
+    width = imageWidth;
+    height = imageHeight;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    pixels.assign(pixelCount * 4, 255);
+
+    size_t offset = HEADER_SIZE + idLength;
+    size_t pixel = 0; // in file order
+    // the current source pixel, stored BGR(A) or gray
+    std::vector<uint8_t> source(bytesPerPixel);
+    while (pixel < pixelCount) {
+        uint32_t runLength = 1;
+        bool repeat = false;
+        if (runLengthEncoded) {
+            if (offset >= data.size()) {
+                throw std::runtime_error(filepath + ": truncated TGA file");
+            }
+            uint8_t packetHeader = data[offset++];
+            runLength = (packetHeader & 0x7f) + 1u;
+            repeat = (packetHeader & 0x80) != 0; // else runLength raw pixels follow
+        }
+        if (runLength > pixelCount - pixel ||
+            data.size() - std::min(offset, data.size()) < (repeat ? 1 : runLength) * bytesPerPixel)
+        {
+            throw std::runtime_error(filepath + ": truncated TGA file");
+        }
+
+        for (uint32_t i = 0; i < runLength; i++, pixel++) {
+            if (i == 0 || !repeat) {
+                std::memcpy(source.data(), &data[offset], bytesPerPixel);
+                offset += bytesPerPixel;
+            }
+            size_t row = pixel / width;
+            size_t column = pixel % width;
+            size_t destinationRow = topToBottom ? row : height - 1 - row;
+            uint8_t* destination = &pixels[(destinationRow * width + column) * 4];
+            if (grayscale) {
+                destination[0] = destination[1] = destination[2] = source[0];
+            }
+            else {
+                destination[0] = source[2];
+                destination[1] = source[1];
+                destination[2] = source[0];
+                if (bytesPerPixel == 4) {
+                    destination[3] = source[3];
+                }
+            }
+        }
+    }
+}
+
+/* Loads a KTX2 file into the builder.
+ *
+ * Reads 2D images without supercompression in a BC format (BC1 to BC7),
+ * uploaded as stored with every mip level the file has, or in RGBA8,
+ * whose single level is loaded as pixels to have its mip chain generated.
+ * Throws std::runtime_error for anything else.
+ */
+void VgeTexture::Builder::loadKtx2(const std::string& filepath)
+{
+    // the header and level index are little-endian, read in place
+    static_assert(std::endian::native == std::endian::little);
+
+    std::ifstream file{ filepath, std::ios::binary };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filepath);
+    }
+    std::vector<uint8_t> data{ std::istreambuf_iterator<char>(file),
+                               std::istreambuf_iterator<char>() };
+
+    constexpr uint8_t IDENTIFIER[12] = { 0xab, 'K',  'T',  'X',  ' ',  '2',
+                                         '0',  0xbb, '\r', '\n', 0x1a, '\n' };
+    constexpr size_t HEADER_SIZE = 80;     // identifier, header and index, before the level index
+    constexpr size_t LEVEL_ENTRY_SIZE = 24; // byte offset, length and uncompressed length
+    if (data.size() < HEADER_SIZE ||
+        std::memcmp(data.data(), IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+    {
+        throw std::runtime_error(filepath + ": not a KTX2 file");
+    }
+
+    // vkFormat, typeSize, pixelWidth, pixelHeight, pixelDepth, layerCount, faceCount, levelCount,
+    // supercompressionScheme
+    uint32_t header[9];
+    std::memcpy(header, &data[sizeof(IDENTIFIER)], sizeof(header));
+    VkFormat fileFormat = static_cast<VkFormat>(header[0]);
+    uint32_t imageWidth = header[2];
+    uint32_t imageHeight = header[3];
+    uint32_t levelCount = std::max(header[7], 1u); // 0 asks for generated levels
+    size_t blockSize = getBlockSize(fileFormat);
+    bool rgba = fileFormat == VK_FORMAT_R8G8B8A8_UNORM || fileFormat == VK_FORMAT_R8G8B8A8_SRGB;
+    if ((blockSize == 0 && !rgba) || imageWidth == 0 || imageHeight == 0 || header[4] != 0 ||
+        header[5] > 1 || header[6] != 1 || header[8] != 0 ||
+        levelCount > static_cast<uint32_t>(std::bit_width(std::max(imageWidth, imageHeight))))
+    {
+        throw std::runtime_error(filepath + ": unsupported KTX2 format");
+    }
+    if (data.size() < HEADER_SIZE + levelCount * LEVEL_ENTRY_SIZE) {
+        throw std::runtime_error(filepath + ": truncated KTX2 file");
+    }
+
+    width = imageWidth;
+    height = imageHeight;
+    pixels.clear();
+    levels.clear();
+    for (uint32_t level = 0; level < levelCount; level++) {
+        // byteOffset, byteLength, uncompressedByteLength
+        uint64_t entry[3];
+        std::memcpy(entry, &data[HEADER_SIZE + level * LEVEL_ENTRY_SIZE], sizeof(entry));
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+        size_t expectedSize = static_cast<size_t>(levelWidth) * levelHeight * 4;
+        if (blockSize != 0) {
+            expectedSize = VgeTextureCompressor::getBlockCount(levelWidth, levelHeight) * blockSize;
+        }
+        if (entry[1] != expectedSize) {
+            throw std::runtime_error(filepath + ": bad KTX2 level size");
+        }
+        if (entry[0] > data.size() || entry[1] > data.size() - entry[0]) {
+            throw std::runtime_error(filepath + ": truncated KTX2 file");
+        }
+        levels.emplace_back(data.begin() + entry[0], data.begin() + entry[0] + entry[1]);
+    }
+
+    if (rgba && levelCount == 1) {
+        pixels = std::move(levels[0]);
+        levels.clear();
+        srgb = fileFormat == VK_FORMAT_R8G8B8A8_SRGB;
+        format = VK_FORMAT_UNDEFINED;
+    }
+    else {
+        format = fileFormat;
+    }
+}
+
+/* Block-compresses the builder's pixels into levels.
+ *
+ * Encodes opaque images as BC1 and ones with alpha as BC3, whichever of
+ * the candidates the device first samples with linear filtering. Mip
+ * levels are box-filtered on the CPU, compressed formats are no blit
+ * destinations. Returns false, leaving the pixels to upload as RGBA8,
+ * when the device has no BC support.
+ */
+bool VgeTexture::Builder::compress(VgeDevice& device)
+{
+    assert(levels.empty() && "Texture is already compressed");
+
+    std::vector<VkFormat> candidates{};
+    if (!VgeTextureCompressor::hasAlpha(pixels)) {
+        candidates.push_back(srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+    }
+    candidates.push_back(srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK);
+    try {
+        format = device.findSupportedFormat(
+            candidates,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    }
+    catch (const std::runtime_error&) {
+        return false; // BC formats are a desktop feature, mobile GPUs lack them
+    }
+    bool bc1 = format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+
+    uint32_t levelCount =
+        generateMipmaps ? static_cast<uint32_t>(std::bit_width(std::max(width, height))) : 1;
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    std::vector<uint8_t> level = std::move(pixels);
+    pixels.clear();
+    for (uint32_t i = 0; i < levelCount; i++) {
+        if (i > 0) {
+            level = VgeTextureCompressor::downsample(level, levelWidth, levelHeight, srgb);
+            levelWidth = std::max(levelWidth / 2, 1u);
+            levelHeight = std::max(levelHeight / 2, 1u);
+        }
+        levels.push_back(
+            bc1 ? VgeTextureCompressor::encodeBc1(level, levelWidth, levelHeight)
+                : VgeTextureCompressor::encodeBc3(level, levelWidth, levelHeight));
+    }
+    return true;
+}
+
+} // namespace vge
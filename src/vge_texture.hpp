@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vge_device.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vge {
+
+// A sampled 2D image with its full mip chain. Block-compressed textures are uploaded level by
+// level as encoded, RGBA8 ones have their mip chain generated on the GPU from level 0
+class VgeTexture {
+public:
+    struct Builder
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> pixels{}; // RGBA8, rows top to bottom
+        bool srgb = true;              // color data, false for data such as normal maps
+        bool generateMipmaps = true;
+        // encoded mip levels, largest first, uploaded as they are in place of pixels if any
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::vector<std::vector<uint8_t>> levels{};
+
+        void loadTga(const std::string& filepath);
+        void loadKtx2(const std::string& filepath);
+        bool compress(VgeDevice& device);
+    };
+
+    VgeTexture(VgeDevice& device, const VgeTexture::Builder& builder);
+    ~VgeTexture();
+
+    VgeTexture(const VgeTexture&) = delete;
+    VgeTexture& operator=(const VgeTexture&) = delete;
+
+    static std::unique_ptr<VgeTexture> createTextureFromFile(
+        VgeDevice& device,
+        const std::string& filepath);
+
+    VkImageView getImageView() const;
+    VkImageLayout getImageLayout() const;
+    VkFormat getFormat() const;
+    VkExtent2D getExtent() const;
+    uint32_t getMipLevels() const;
+
+private:
+    void createImage(VkImageUsageFlags usage);
+    void uploadPixels(const std::vector<uint8_t>& pixels);
+    void uploadLevels(const std::vector<std::vector<uint8_t>>& levels);
+    void generateMipmaps(VkCommandBuffer commandBuffer);
+    void createImageView();
+
+    VgeDevice& m_vgeDevice;
+    VkFormat m_format;
+    VkExtent2D m_extent;
+    uint32_t m_mipLevels; // 1 without mipmaps
+
+    VkImage m_image;
+    VkDeviceMemory m_imageMemory;
+    VkImageView m_imageView;
+};
+
+} // namespace vge
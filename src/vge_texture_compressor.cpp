@@ -0,0 +1,384 @@
+#include "vge_texture_compressor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace vge {
+
+/* Builds the table decoding 8 bit sRGB values to linear intensities.
+ *
+ * Uses the exact sRGB transfer function, the GPU's decode when sampling.
+ */
+static std::array<float, 256> makeSrgbToLinearTable()
+{
+    std::array<float, 256> table{};
+    for (size_t i = 0; i < table.size(); i++) {
+        float value = static_cast<float>(i) / 255.f;
+        table[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+}
+
+// Encodes a linear intensity to the nearest 8 bit sRGB value.
+static uint8_t linearToSrgb(float value)
+{
+    value = std::clamp(value, 0.f, 1.f);
+    float encoded =
+        value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(encoded * 255.f + 0.5f);
+}
+
+// Packs an RGB color to 5:6:5 bits, rounding to nearest.
+static uint16_t packRgb565(const float* color)
+{
+    uint32_t r = static_cast<uint32_t>(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    uint32_t g = static_cast<uint32_t>(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+    uint32_t b = static_cast<uint32_t>(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// Expands a 5:6:5 color to 8 bits per channel by bit replication, as the GPU decodes it.
+static void unpackRgb565(uint16_t packed, int32_t* color)
+{
+    int32_t r = (packed >> 11) & 0x1f;
+    int32_t g = (packed >> 5) & 0x3f;
+    int32_t b = packed & 0x1f;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/* Gathers the 4x4 texels of block (blockX, blockY) into block as RGBA8.
+ *
+ * Texels past the right or bottom edge repeat the last column or row, so
+ * they do not pull the fitted endpoints away from the visible texels.
+ */
+static void loadBlock(
+    const std::vector<uint8_t>& pixels,
+    uint32_t width,
+    uint32_t height,
+    uint32_t blockX,
+    uint32_t blockY,
+    uint8_t* block)
+{
+    for (uint32_t y = 0; y < VgeTextureCompressor::BLOCK_DIMENSION; y++) {
+        uint32_t row = std::min(blockY * VgeTextureCompressor::BLOCK_DIMENSION + y, height - 1);
+        for (uint32_t x = 0; x < VgeTextureCompressor::BLOCK_DIMENSION; x++) {
+            uint32_t column =
+                std::min(blockX * VgeTextureCompressor::BLOCK_DIMENSION + x, width - 1);
+            const uint8_t* source = &pixels[(static_cast<size_t>(row) * width + column) * 4];
+            uint8_t* destination = &block[(y * VgeTextureCompressor::BLOCK_DIMENSION + x) * 4];
+            std::copy(source, source + 4, destination);
+        }
+    }
+}
+
+/* Encodes the RGB of 16 RGBA8 texels as a BC1 color block.
+ *
+ * The endpoints are the extremes of the texels along their principal
+ * axis, found by power iteration on the color covariance. The iteration
+ * starts from the diagonal of the texels' bounding box, oriented by the
+ * covariance, which unlike a fixed start can't be orthogonal to the axis
+ * of blocks varying only in chroma. When it still collapses the diagonal
+ * is used as is. A flat block encodes its mean. color0 is kept
+ * greater than color1, which selects the 4 color mode BC1 needs for
+ * opaque texels and BC3 always uses. Each texel gets the index of the
+ * nearest of the 4 decoded palette colors.
+ */
+static void encodeColorBlock(const uint8_t* block, uint8_t* output)
+{
+    constexpr uint32_t TEXEL_COUNT = 16;
+
+    float mean[3]{};
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            mean[c] += block[i * 4 + c];
+        }
+    }
+    for (uint32_t c = 0; c < 3; c++) {
+        mean[c] /= TEXEL_COUNT;
+    }
+
+    float covariance[3][3]{};
+    float minColor[3] = { 255.f, 255.f, 255.f };
+    float maxColor[3] = { 0.f, 0.f, 0.f };
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            minColor[c] = std::min(minColor[c], static_cast<float>(block[i * 4 + c]));
+            maxColor[c] = std::max(maxColor[c], static_cast<float>(block[i * 4 + c]));
+        }
+        float offset[3] = { block[i * 4] - mean[0],
+                            block[i * 4 + 1] - mean[1],
+                            block[i * 4 + 2] - mean[2] };
+        for (uint32_t row = 0; row < 3; row++) {
+            for (uint32_t column = 0; column < 3; column++) {
+                covariance[row][column] += offset[row] * offset[column];
+            }
+        }
+    }
+
+    // the bounding box diagonal, each channel's extent signed by its covariance with the
+    // channel of the largest extent
+    uint32_t widest = 0;
+    for (uint32_t c = 1; c < 3; c++) {
+        if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest]) {
+            widest = c;
+        }
+    }
+    float axis[3];
+    for (uint32_t c = 0; c < 3; c++) {
+        axis[c] = maxColor[c] - minColor[c];
+        if (covariance[widest][c] < 0.f) {
+            axis[c] = -axis[c];
+        }
+    }
+
+    // the dominant eigenvector
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[3]{};
+        for (uint32_t row = 0; row < 3; row++) {
+            next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] +
+                        covariance[row][2] * axis[2];
+        }
+        float largest = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (largest < 1e-6f) {
+            break; // keeps the diagonal, or a zero axis for a flat block
+        }
+        for (uint32_t c = 0; c < 3; c++) {
+            axis[c] = next[c] / largest;
+        }
+    }
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (uint32_t c = 0; c < 3; c++) {
+        axis[c] = length > 0.f ? axis[c] / length : 0.f;
+    }
+
+    float minProjection = 0.f;
+    float maxProjection = 0.f;
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++) {
+        float projection = (block[i * 4] - mean[0]) * axis[0] +
+                           (block[i * 4 + 1] - mean[1]) * axis[1] +
+                           (block[i * 4 + 2] - mean[2]) * axis[2];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float endpoint0[3];
+    float endpoint1[3];
+    for (uint32_t c = 0; c < 3; c++) {
+        endpoint0[c] = mean[c] + axis[c] * maxProjection;
+        endpoint1[c] = mean[c] + axis[c] * minProjection;
+    }
+
+    uint16_t color0 = packRgb565(endpoint0);
+    uint16_t color1 = packRgb565(endpoint1);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int32_t palette[4][3];
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+        for (uint32_t c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (uint32_t i = 0; i < TEXEL_COUNT; i++) {
+            uint32_t nearest = 0;
+            int32_t nearestDistance = INT32_MAX;
+            for (uint32_t entry = 0; entry < 4; entry++) {
+                int32_t distance = 0;
+                for (uint32_t c = 0; c < 3; c++) {
+                    int32_t difference = block[i * 4 + c] - palette[entry][c];
+                    distance += difference * difference;
+                }
+                if (distance < nearestDistance) {
+                    nearest = entry;
+                    nearestDistance = distance;
+                }
+            }
+            indices |= nearest << (i * 2);
+        }
+    }
+
+    output[0] = static_cast<uint8_t>(color0);
+    output[1] = static_cast<uint8_t>(color0 >> 8);
+    output[2] = static_cast<uint8_t>(color1);
+    output[3] = static_cast<uint8_t>(color1 >> 8);
+    for (uint32_t i = 0; i < 4; i++) {
+        output[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+}
+
+/* Encodes the alpha of 16 RGBA8 texels as a BC3 alpha block.
+ *
+ * The endpoints are the largest and smallest alpha, in the order that
+ * selects 6 interpolated values between them, and each texel gets the
+ * 3 bit index of the nearest of the 8.
+ */
+static void encodeAlphaBlock(const uint8_t* block, uint8_t* output)
+{
+    constexpr uint32_t TEXEL_COUNT = 16;
+
+    int32_t alpha0 = 0;
+    int32_t alpha1 = 255;
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++) {
+        alpha0 = std::max<int32_t>(alpha0, block[i * 4 + 3]);
+        alpha1 = std::min<int32_t>(alpha1, block[i * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+    if (alpha0 != alpha1) {
+        int32_t palette[8] = { alpha0, alpha1 };
+        for (int32_t i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+        }
+
+        for (uint32_t i = 0; i < TEXEL_COUNT; i++) {
+            uint64_t nearest = 0;
+            int32_t nearestDistance = INT32_MAX;
+            for (uint32_t entry = 0; entry < 8; entry++) {
+                int32_t distance = std::abs(block[i * 4 + 3] - palette[entry]);
+                if (distance < nearestDistance) {
+                    nearest = entry;
+                    nearestDistance = distance;
+                }
+            }
+            indices |= nearest << (i * 3);
+        }
+    }
+
+    output[0] = static_cast<uint8_t>(alpha0);
+    output[1] = static_cast<uint8_t>(alpha1);
+    for (uint32_t i = 0; i < 6; i++) {
+        output[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+}
+
+/* Computes the next mip level of an RGBA8 image.
+ *
+ * Halves each side down to 1, averaging 2x2 texels (the last row or
+ * column of an odd side is dropped, as by a linear blit). sRGB color is
+ * averaged as linear intensity so levels do not darken, alpha is always
+ * linear.
+ */
+std::vector<uint8_t> VgeTextureCompressor::downsample(
+    const std::vector<uint8_t>& pixels,
+    uint32_t width,
+    uint32_t height,
+    bool srgb)
+{
+    assert(pixels.size() == static_cast<size_t>(width) * height * 4 && "Pixels must be RGBA8");
+
+    static const std::array<float, 256> srgbToLinear = makeSrgbToLinearTable();
+
+    uint32_t nextWidth = std::max(width / 2, 1u);
+    uint32_t nextHeight = std::max(height / 2, 1u);
+    std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+    for (uint32_t y = 0; y < nextHeight; y++) {
+        uint32_t rows[2] = { y * 2, std::min(y * 2 + 1, height - 1) };
+        for (uint32_t x = 0; x < nextWidth; x++) {
+            uint32_t columns[2] = { x * 2, std::min(x * 2 + 1, width - 1) };
+            float sum[4]{};
+            for (uint32_t row : rows) {
+                for (uint32_t column : columns) {
+                    const uint8_t* source =
+                        &pixels[(static_cast<size_t>(row) * width + column) * 4];
+                    for (uint32_t c = 0; c < 3; c++) {
+                        sum[c] += srgb ? srgbToLinear[source[c]] : source[c] / 255.f;
+                    }
+                    sum[3] += source[3] / 255.f;
+                }
+            }
+
+            uint8_t* destination = &next[(static_cast<size_t>(y) * nextWidth + x) * 4];
+            for (uint32_t c = 0; c < 4; c++) {
+                float average = sum[c] / 4.f;
+                destination[c] = srgb && c < 3
+                                     ? linearToSrgb(average)
+                                     : static_cast<uint8_t>(average * 255.f + 0.5f);
+            }
+        }
+    }
+    return next;
+}
+
+/* Encodes an RGBA8 image as BC1 blocks, ignoring alpha.
+ *
+ * Blocks are in row-major order, BC1_BLOCK_SIZE bytes each, the layout
+ * vkCmdCopyBufferToImage expects for a BC1 level.
+ */
+std::vector<uint8_t> VgeTextureCompressor::encodeBc1(
+    const std::vector<uint8_t>& pixels,
+    uint32_t width,
+    uint32_t height)
+{
+    assert(pixels.size() == static_cast<size_t>(width) * height * 4 && "Pixels must be RGBA8");
+
+    uint32_t blocksWide = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    uint32_t blocksHigh = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    std::vector<uint8_t> blocks(getBlockCount(width, height) * BC1_BLOCK_SIZE);
+    uint8_t block[BLOCK_DIMENSION * BLOCK_DIMENSION * 4];
+    uint8_t* output = blocks.data();
+    for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+            loadBlock(pixels, width, height, blockX, blockY, block);
+            encodeColorBlock(block, output);
+            output += BC1_BLOCK_SIZE;
+        }
+    }
+    return blocks;
+}
+
+/* Encodes an RGBA8 image as BC3 blocks.
+ *
+ * Blocks are in row-major order, BC3_BLOCK_SIZE bytes each: the alpha
+ * block followed by the color block.
+ */
+std::vector<uint8_t> VgeTextureCompressor::encodeBc3(
+    const std::vector<uint8_t>& pixels,
+    uint32_t width,
+    uint32_t height)
+{
+    assert(pixels.size() == static_cast<size_t>(width) * height * 4 && "Pixels must be RGBA8");
+
+    uint32_t blocksWide = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    uint32_t blocksHigh = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    std::vector<uint8_t> blocks(getBlockCount(width, height) * BC3_BLOCK_SIZE);
+    uint8_t block[BLOCK_DIMENSION * BLOCK_DIMENSION * 4];
+    uint8_t* output = blocks.data();
+    for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+            loadBlock(pixels, width, height, blockX, blockY, block);
+            encodeAlphaBlock(block, output);
+            encodeColorBlock(block, output + 8);
+            output += BC3_BLOCK_SIZE;
+        }
+    }
+    return blocks;
+}
+
+// Returns whether any RGBA8 texel is not fully opaque.
+bool VgeTextureCompressor::hasAlpha(const std::vector<uint8_t>& pixels)
+{
+    for (size_t i = 3; i < pixels.size(); i += 4) {
+        if (pixels[i] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the number of 4x4 blocks covering a width x height level.
+size_t VgeTextureCompressor::getBlockCount(uint32_t width, uint32_t height)
+{
+    return static_cast<size_t>((width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION) *
+           ((height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION);
+}
+
+} // namespace vge
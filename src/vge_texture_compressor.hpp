@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vge {
+
+// CPU side of block-compressed texture import: box-filtered mip levels and BC1/BC3 encoding of
+// RGBA8 images. Blocks cover 4x4 texels, edge blocks repeat the last row and column. Colors are
+// fitted in the stored values, the space GPUs interpolate BC endpoints in
+class VgeTextureCompressor {
+public:
+    static constexpr uint32_t BLOCK_DIMENSION = 4; // texels per block side
+    static constexpr size_t BC1_BLOCK_SIZE = 8;    // bytes, RGB endpoints and 2 bit indices
+    static constexpr size_t BC3_BLOCK_SIZE = 16;   // bytes, an alpha block then a BC1 block
+
+    static std::vector<uint8_t> downsample(
+        const std::vector<uint8_t>& pixels,
+        uint32_t width,
+        uint32_t height,
+        bool srgb);
+    static std::vector<uint8_t> encodeBc1(
+        const std::vector<uint8_t>& pixels,
+        uint32_t width,
+        uint32_t height);
+    static std::vector<uint8_t> encodeBc3(
+        const std::vector<uint8_t>& pixels,
+        uint32_t width,
+        uint32_t height);
+    static bool hasAlpha(const std::vector<uint8_t>& pixels);
+    static size_t getBlockCount(uint32_t width, uint32_t height);
+};
+
+} // namespace vge
@@ -0,0 +1,159 @@
+#include "vge_thread_pool.hpp"
+
+#include <algorithm>
+
+namespace vge {
+
+/* Constructs a VgeThreadPool object.
+ *
+ * Starts workerCount persistent worker threads that sleep until work is
+ * handed to parallelFor. The calling thread also works on every
+ * parallelFor, so a pool without workers runs everything inline.
+ */
+VgeThreadPool::VgeThreadPool(unsigned int workerCount)
+    : m_workers{}
+    , m_mutex{}
+    , m_workAvailable{}
+    , m_workDone{}
+    , m_task{ nullptr }
+    , m_count{ 0 }
+    , m_batchSize{ 0 }
+    , m_nextBegin{ 0 }
+    , m_busyWorkers{ 0 }
+    , m_generation{ 0 }
+    , m_stopping{ false }
+{
+    m_workers.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&VgeThreadPool::workerLoop, this);
+    }
+}
+
+/* Destroys the VgeThreadPool object.
+ *
+ * Wakes every worker with the stop flag set and joins them.
+ */
+VgeThreadPool::~VgeThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+/* Get the number of worker threads a pool uses by default.
+ *
+ * One less than the hardware threads, leaving one for the calling thread.
+ */
+unsigned int VgeThreadPool::defaultWorkerCount()
+{
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+/* Get the number of worker threads.
+ *
+ * Returns the worker count, not counting the thread calling parallelFor.
+ */
+unsigned int VgeThreadPool::getWorkerCount() const
+{
+    return static_cast<unsigned int>(m_workers.size());
+}
+
+/* Runs task over [0, count) split into contiguous ranges.
+ *
+ * Ranges are at least minBatchSize long, so small counts run inline on the
+ * calling thread without waking any worker. Otherwise the range is split
+ * into one batch per participating thread and the call blocks until every
+ * batch has completed. Not reentrant: only one thread may call it at a time.
+ */
+void VgeThreadPool::parallelFor(size_t count, size_t minBatchSize, const RangeTask& task)
+{
+    if (count == 0) {
+        return;
+    }
+    size_t maxBatches = (count + std::max<size_t>(minBatchSize, 1) - 1) /
+                        std::max<size_t>(minBatchSize, 1);
+    size_t batchCount = std::min<size_t>(maxBatches, m_workers.size() + 1);
+    if (batchCount <= 1) {
+        task(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_task = &task;
+        m_count = count;
+        m_batchSize = (count + batchCount - 1) / batchCount;
+        m_nextBegin.store(0);
+        m_busyWorkers = static_cast<unsigned int>(m_workers.size());
+        m_generation += 1;
+    }
+    m_workAvailable.notify_all();
+
+    runBatches();
+
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_workDone.wait(
+        lock,
+        [this]()
+        {
+            return m_busyWorkers == 0;
+        });
+    m_task = nullptr;
+}
+
+/* Claims and runs batches of the current parallelFor until none are left.
+ *
+ * Batches are claimed with an atomic counter, so threads that wake late
+ * simply find nothing left to do.
+ */
+void VgeThreadPool::runBatches()
+{
+    while (true) {
+        size_t begin = m_nextBegin.fetch_add(m_batchSize);
+        if (begin >= m_count) {
+            return;
+        }
+        (*m_task)(begin, std::min(begin + m_batchSize, m_count));
+    }
+}
+
+/* Main loop of a worker thread.
+ *
+ * Sleeps until a new parallelFor generation is published or the pool stops,
+ * helps with the batches, then reports back to the calling thread.
+ */
+void VgeThreadPool::workerLoop()
+{
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_workAvailable.wait(
+                lock,
+                [this, seenGeneration]()
+                {
+                    return m_stopping || m_generation != seenGeneration;
+                });
+            if (m_stopping) {
+                return;
+            }
+            seenGeneration = m_generation;
+        }
+
+        runBatches();
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_busyWorkers -= 1;
+        if (m_busyWorkers == 0) {
+            m_workDone.notify_one();
+        }
+    }
+}
+
+} // namespace vge
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vge {
+
+class VgeThreadPool {
+public:
+    using RangeTask = std::function<void(size_t begin, size_t end)>;
+
+    VgeThreadPool(unsigned int workerCount = defaultWorkerCount());
+    ~VgeThreadPool();
+
+    VgeThreadPool(const VgeThreadPool&) = delete;
+    VgeThreadPool& operator=(const VgeThreadPool&) = delete;
+
+    void parallelFor(size_t count, size_t minBatchSize, const RangeTask& task);
+    unsigned int getWorkerCount() const;
+
+    static unsigned int defaultWorkerCount();
+
+private:
+    void workerLoop();
+    void runBatches();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workDone;
+
+    // current parallelFor call, published under m_mutex by bumping m_generation
+    const RangeTask* m_task;
+    size_t m_count;
+    size_t m_batchSize;
+    std::atomic<size_t> m_nextBegin;
+    unsigned int m_busyWorkers;
+    uint64_t m_generation;
+    bool m_stopping;
+};
+
+} // namespace vge
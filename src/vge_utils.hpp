@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace vge {
+
+/* Combines multiple hash values into a single hash seed.
+ *
+ * This function updates the provided seed with the hash of the given values,
+ * allowing for the efficient hashing of multiple components by using a
+ * combination algorithm.
+ */
+template <typename T, typename... Rest>
+void hashCombine(std::size_t& seed, const T& v, const Rest&... rest)
+{
+    seed ^= std::hash<T>{}(v) + 0x9e'37'79'b9 + (seed << 6) + (seed >> 2);
+    // C++17 fold expression (f(), ...) to hash remaining element in rest...
+    (hashCombine(seed, rest), ...);
+}
+
+} // namespace vge
@@ -0,0 +1,178 @@
+#include "vge_scene.hpp"
+
+#include <cstdlib>   // EXIT_FAILURE & EXIT_SUCCESS macros
+#include <exception> // std::exception e.what()
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+// Compiles a text scene description into the binary format read by VgeScene. Each line is a
+// statement, blank lines and lines starting with # are skipped:
+//
+//   model <name> <path> <float|packed>
+//   texture <name> <path>
+//   entity <model name|-> <texture name|-> <translation xyz> <rotation xyz> <scale xyz>
+//   light <position xyz> <radius> <color rgb> <intensity>
+//
+// Models and textures are declared before the entities referencing them by name, - for none.
+
+using vge::VgeScene;
+
+// names of the declared models and textures, mapped to their index in the scene
+struct SceneNames
+{
+    std::unordered_map<std::string, uint32_t> models{};
+    std::unordered_map<std::string, uint32_t> textures{};
+};
+
+/* Reads count floats of a statement into values.
+ *
+ * Throws if the statement runs out of numbers.
+ */
+static void readFloats(std::istringstream& statement, float* values, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (!(statement >> values[i])) {
+            throw std::runtime_error("expected a number");
+        }
+    }
+}
+
+/* Looks up the index of a declared model or texture.
+ *
+ * - stands for none and returns noIndex.
+ */
+static uint32_t findIndex(
+    const std::unordered_map<std::string, uint32_t>& indices,
+    const std::string& name,
+    uint32_t noIndex)
+{
+    if (name == "-") {
+        return noIndex;
+    }
+    std::unordered_map<std::string, uint32_t>::const_iterator it = indices.find(name);
+    if (it == indices.end()) {
+        throw std::runtime_error("undeclared name " + name);
+    }
+    return it->second;
+}
+
+/* Adds the statement of one line to the scene.
+ *
+ * Throws on unknown keywords, missing or trailing arguments and names that
+ * are undeclared or declared twice.
+ */
+static void compileStatement(
+    const std::string& line,
+    VgeScene::Builder& builder,
+    SceneNames& names)
+{
+    std::istringstream statement{ line };
+    std::string keyword{};
+    if (!(statement >> keyword) || keyword[0] == '#') {
+        return;
+    }
+
+    if (keyword == "model") {
+        std::string name{};
+        std::string path{};
+        std::string format{};
+        if (!(statement >> name >> path >> format)) {
+            throw std::runtime_error("expected model <name> <path> <float|packed>");
+        }
+        // VgeModel::VertexFormat
+        uint32_t vertexFormat = 0;
+        if (format == "packed") {
+            vertexFormat = 1;
+        }
+        else if (format != "float") {
+            throw std::runtime_error("unknown vertex format " + format);
+        }
+        if (!names.models.emplace(name, builder.addModel(path, vertexFormat)).second) {
+            throw std::runtime_error("model " + name + " declared twice");
+        }
+    }
+    else if (keyword == "texture") {
+        std::string name{};
+        std::string path{};
+        if (!(statement >> name >> path)) {
+            throw std::runtime_error("expected texture <name> <path>");
+        }
+        if (!names.textures.emplace(name, builder.addTexture(path)).second) {
+            throw std::runtime_error("texture " + name + " declared twice");
+        }
+    }
+    else if (keyword == "entity") {
+        std::string modelName{};
+        std::string textureName{};
+        if (!(statement >> modelName >> textureName)) {
+            throw std::runtime_error("expected entity <model|-> <texture|-> and 9 numbers");
+        }
+        VgeScene::Entity entity{};
+        entity.modelIndex = findIndex(names.models, modelName, VgeScene::NO_MODEL);
+        entity.textureIndex = findIndex(names.textures, textureName, VgeScene::NO_TEXTURE);
+        readFloats(statement, entity.translation, 3);
+        readFloats(statement, entity.rotation, 3);
+        readFloats(statement, entity.scale, 3);
+        builder.entities.push_back(entity);
+    }
+    else if (keyword == "light") {
+        VgeScene::Light light{};
+        readFloats(statement, light.position, 3);
+        readFloats(statement, &light.radius, 1);
+        readFloats(statement, light.color, 3);
+        readFloats(statement, &light.intensity, 1);
+        builder.lights.push_back(light);
+    }
+    else {
+        throw std::runtime_error("unknown statement " + keyword);
+    }
+
+    std::string trailing{};
+    if (statement >> trailing) {
+        throw std::runtime_error("unexpected " + trailing);
+    }
+}
+
+/* Compiles a text scene description into a binary scene file.
+ *
+ * Usage: vgeSceneCompiler <input> <output>. Errors name the input line and
+ * leave the output untouched.
+ */
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <input> <output>" << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream input{ argv[1] };
+    if (!input.is_open()) {
+        std::cerr << "failed to open file: " << argv[1] << '\n';
+        return EXIT_FAILURE;
+    }
+
+    VgeScene::Builder builder{};
+    SceneNames names{};
+    std::string line{};
+    int lineNumber = 0;
+    try {
+        while (std::getline(input, line)) {
+            lineNumber++;
+            compileStatement(line, builder, names);
+        }
+        builder.write(argv[2]);
+    }
+    catch (const std::exception& e) {
+        std::cerr << argv[1] << ":" << lineNumber << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::cout << argv[2] << ": " << builder.entities.size() << " entities, "
+              << builder.models.size() << " models, " << builder.textures.size() << " textures, "
+              << builder.lights.size() << " lights" << std::endl;
+    return EXIT_SUCCESS;
+}